@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <eosio/chain/action.hpp>
+#include <eosio/chain/asset.hpp>
+#include <eosio/chain/types.hpp>
+#include <fc/io/raw.hpp>
+
+namespace eosio { namespace bench { namespace types {
+
+// the action structs of eosio.system and token contracts, only what the benchmarks pack
+struct transfer {
+    chain::name   from;
+    chain::name   to;
+    chain::asset  quantity;
+    std::string   memo;
+};
+
+struct delegatebw {
+    chain::name   from;
+    chain::name   receiver;
+    chain::asset  stake_net_quantity;
+    chain::asset  stake_cpu_quantity;
+    bool          transfer = false;
+};
+
+struct undelegatebw {
+    chain::name   from;
+    chain::name   receiver;
+    chain::asset  unstake_net_quantity;
+    chain::asset  unstake_cpu_quantity;
+};
+
+struct buyram {
+    chain::name   payer;
+    chain::name   receiver;
+    chain::asset  quant;
+};
+
+struct sellram {
+    chain::name   account;
+    int64_t       bytes = 0;
+};
+
+struct voteproducer {
+    chain::name               voter;
+    chain::name               proxy;
+    std::vector<chain::name>  producers;
+};
+
+struct regproducer {
+    chain::name             producer;
+    chain::public_key_type  producer_key;
+    std::string             url;
+    uint16_t                location = 0;
+};
+
+struct record {
+    uint64_t      id = 0;
+    chain::name   owner;
+    std::string   payload;
+};
+
+template<typename T>
+chain::action make_action( const chain::name& account, const chain::name& name, const chain::name& actor, const T& data ) {
+    chain::action act;
+    act.account = account;
+    act.name = name;
+    act.authorization.emplace_back( chain::permission_level{actor, N(active)} );
+    act.data = fc::raw::pack(data);
+    return act;
+}
+
+} } } // namespace
+
+FC_REFLECT( eosio::bench::types::transfer, (from)(to)(quantity)(memo) )
+FC_REFLECT( eosio::bench::types::delegatebw, (from)(receiver)(stake_net_quantity)(stake_cpu_quantity)(transfer) )
+FC_REFLECT( eosio::bench::types::undelegatebw, (from)(receiver)(unstake_net_quantity)(unstake_cpu_quantity) )
+FC_REFLECT( eosio::bench::types::buyram, (payer)(receiver)(quant) )
+FC_REFLECT( eosio::bench::types::sellram, (account)(bytes) )
+FC_REFLECT( eosio::bench::types::voteproducer, (voter)(proxy)(producers) )
+FC_REFLECT( eosio::bench::types::regproducer, (producer)(producer_key)(url)(location) )
+FC_REFLECT( eosio::bench::types::record, (id)(owner)(payload) )
@@ -0,0 +1,43 @@
+#pragma once
+
+// counts heap allocations of the whole process by replacing the global operator new.
+// include from exactly one translation unit of an executable.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace eosio { namespace bench {
+
+struct alloc_counter {
+    static std::atomic<uint64_t>& count(){ static std::atomic<uint64_t> c{0}; return c; }
+    static std::atomic<uint64_t>& bytes(){ static std::atomic<uint64_t> b{0}; return b; }
+
+    // allocations made between construction and the call
+    struct scope {
+        uint64_t start_count = count().load();
+        uint64_t start_bytes = bytes().load();
+
+        uint64_t allocations() const { return count().load() - start_count; }
+        uint64_t allocated_bytes() const { return bytes().load() - start_bytes; }
+    };
+};
+
+} } // namespace
+
+void* operator new( std::size_t n ) {
+    eosio::bench::alloc_counter::count().fetch_add(1, std::memory_order_relaxed);
+    eosio::bench::alloc_counter::bytes().fetch_add(n, std::memory_order_relaxed);
+    if( void* p = std::malloc(n ? n : 1) ) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new( std::size_t n, const std::nothrow_t& ) noexcept {
+    eosio::bench::alloc_counter::count().fetch_add(1, std::memory_order_relaxed);
+    eosio::bench::alloc_counter::bytes().fetch_add(n, std::memory_order_relaxed);
+    return std::malloc(n ? n : 1);
+}
+
+void operator delete( void* p ) noexcept { std::free(p); }
+void operator delete( void* p, std::size_t ) noexcept { std::free(p); }
+void operator delete( void* p, const std::nothrow_t& ) noexcept { std::free(p); }
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <eosio/chain/block.hpp>
+#include <eosio/chain/block_state.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/io/raw.hpp>
+
+namespace eosio { namespace bench {
+
+// a fixture file is a sequence of fc::raw packed signed blocks, each prefixed by its size
+class block_fixture {
+    public:
+        static std::vector<chain::signed_block_ptr> read( const std::string& path ) {
+            std::ifstream in(path, std::ios::binary);
+            FC_ASSERT( in, "unable to open fixture ${p}", ("p",path) );
+
+            std::vector<chain::signed_block_ptr> blocks;
+            uint32_t size = 0;
+            std::vector<char> buffer;
+            while( in.read(reinterpret_cast<char*>(&size), sizeof(size)) ) {
+                buffer.resize(size);
+                FC_ASSERT( in.read(buffer.data(), size), "truncated fixture ${p}", ("p",path) );
+                auto block = std::make_shared<chain::signed_block>();
+                fc::raw::unpack( buffer.data(), buffer.size(), *block );
+                blocks.emplace_back(std::move(block));
+            }
+            return blocks;
+        }
+
+        static void write( const std::string& path, const std::vector<chain::signed_block_ptr>& blocks ) {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            FC_ASSERT( out, "unable to create fixture ${p}", ("p",path) );
+
+            for(const auto& block : blocks){
+                auto packed = fc::raw::pack(*block);
+                uint32_t size = packed.size();
+                out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+                out.write(packed.data(), packed.size());
+            }
+        }
+
+        // the fields consume_block_state reads, no validation
+        static chain::block_state_ptr to_block_state( const chain::signed_block_ptr& block ) {
+            auto bs = std::make_shared<chain::block_state>();
+            bs->id        = block->id();
+            bs->block_num = block->block_num();
+            bs->header    = *block;
+            bs->block     = block;
+            return bs;
+        }
+};
+
+} } // namespace
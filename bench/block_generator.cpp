@@ -0,0 +1,317 @@
+#include "block_generator.hpp"
+#include "action_types.hpp"
+
+#include <algorithm>
+
+#include <eosio/chain/contract_types.hpp>
+#include <eosio/chain/eosio_contract.hpp>
+#include <eosio/chain/transaction.hpp>
+#include <fc/crypto/private_key.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/io/raw.hpp>
+
+#include <boost/algorithm/string.hpp>
+
+namespace eosio { namespace bench {
+
+    namespace {
+
+        const uint32_t producer_count = 50;
+        // 2018-06-15, slots are half seconds since 2000
+        const uint32_t first_slot = 1164672000;
+
+        using types::make_action;
+
+        // deriving a key is slow, newaccount picks from a few fixed ones
+        const chain::public_key_type& key_for( uint64_t index ) {
+            static const std::vector<chain::public_key_type> keys = []{
+                std::vector<chain::public_key_type> result;
+                for(int i = 0; i < 16; i++){
+                    auto secret = fc::sha256::hash( std::string("sql_db bench key ") + std::to_string(i) );
+                    result.emplace_back( fc::crypto::private_key::regenerate<fc::ecc::private_key_shim>(secret).get_public_key() );
+                }
+                return result;
+            }();
+            return keys[index % keys.size()];
+        }
+
+    }
+
+    void add_generator_options( boost::program_options::options_description& desc ) {
+        namespace bpo = boost::program_options;
+        generator_options defaults;
+        desc.add_options()
+            ("seed", bpo::value<uint64_t>()->default_value(defaults.seed), "generator seed, runs with the same seed see the same blocks")
+            ("first-block", bpo::value<uint32_t>()->default_value(defaults.first_block), "number of the first generated block")
+            ("trx-per-block", bpo::value<uint32_t>()->default_value(defaults.transactions_per_block), "transactions per block, 5000 for 10k TPS")
+            ("actions-per-trx", bpo::value<uint32_t>()->default_value(defaults.actions_per_transaction), "actions per transaction")
+            ("accounts", bpo::value<uint32_t>()->default_value(defaults.accounts), "number of distinct accounts acting")
+            ("contracts", bpo::value<uint32_t>()->default_value(defaults.custom_contracts), "number of custom contracts")
+            ("mix", bpo::value<std::string>(), "action weights, e.g. transfer=60,delegatebw=8,buyram=8,voteproducer=8,newaccount=5,setabi=1,custom=10")
+            ("abi-structs", bpo::value<uint32_t>()->default_value(defaults.abi_structs), "structs of the ABIs set by setabi actions")
+            ("inline-depth", bpo::value<uint32_t>()->default_value(defaults.inline_depth), "inline actions below each custom action")
+            ;
+    }
+
+    generator_options generator_options_from( const boost::program_options::variables_map& options ) {
+        generator_options result;
+        result.seed                    = options.at("seed").as<uint64_t>();
+        result.first_block             = std::max<uint32_t>(2, options.at("first-block").as<uint32_t>());
+        result.transactions_per_block  = options.at("trx-per-block").as<uint32_t>();
+        result.actions_per_transaction = std::max<uint32_t>(1, options.at("actions-per-trx").as<uint32_t>());
+        result.accounts                = std::max<uint32_t>(producer_count, options.at("accounts").as<uint32_t>());
+        result.custom_contracts        = std::max<uint32_t>(1, options.at("contracts").as<uint32_t>());
+        result.abi_structs             = options.at("abi-structs").as<uint32_t>();
+        result.inline_depth            = options.at("inline-depth").as<uint32_t>();
+
+        if( options.count("mix") ) {
+            std::vector<std::string> entries;
+            boost::split( entries, options.at("mix").as<std::string>(), boost::is_any_of(",") );
+            for(const auto& entry : entries){
+                auto pos = entry.find('=');
+                FC_ASSERT( pos != std::string::npos, "mix entry ${e} is not kind=weight", ("e",entry) );
+                auto kind = entry.substr(0, pos);
+                FC_ASSERT( result.mix.count(kind), "unknown action kind ${k}", ("k",kind) );
+                result.mix[kind] = std::stoul( entry.substr(pos + 1) );
+            }
+        }
+        return result;
+    }
+
+    block_generator::block_generator( const generator_options& options ):
+        options(options),
+        rng(options.seed),
+        block_num(options.first_block),
+        next_new_account(options.accounts)
+    {
+        std::vector<uint32_t> weights;
+        for(const auto& m : options.mix){
+            kinds.emplace_back(m.first);
+            weights.emplace_back(m.second);
+        }
+        kind_dist = std::discrete_distribution<size_t>( weights.begin(), weights.end() );
+
+        // the id of the block before the first one only carries its number
+        previous._hash[0] = fc::endian_reverse_u32( block_num - 1 );
+    }
+
+    chain::name block_generator::account_name( uint64_t index ) {
+        static const char* charset = "12345abcdefghijklmnopqrstuvwxyz";
+        std::string name = "g";
+        for(int i = 0; i < 11; i++){
+            name += charset[index % 31];
+            index /= 31;
+        }
+        return chain::name(name);
+    }
+
+    chain::abi_def block_generator::system_abi() {
+        chain::abi_def abi;
+        abi.version = "eosio::abi/1.0";
+        abi.structs.emplace_back( chain::struct_def{ "delegatebw", "", {
+            {"from", "name"}, {"receiver", "name"}, {"stake_net_quantity", "asset"}, {"stake_cpu_quantity", "asset"}, {"transfer", "bool"} } } );
+        abi.structs.emplace_back( chain::struct_def{ "undelegatebw", "", {
+            {"from", "name"}, {"receiver", "name"}, {"unstake_net_quantity", "asset"}, {"unstake_cpu_quantity", "asset"} } } );
+        abi.structs.emplace_back( chain::struct_def{ "buyram", "", {
+            {"payer", "name"}, {"receiver", "name"}, {"quant", "asset"} } } );
+        abi.structs.emplace_back( chain::struct_def{ "sellram", "", {
+            {"account", "name"}, {"bytes", "int64"} } } );
+        abi.structs.emplace_back( chain::struct_def{ "voteproducer", "", {
+            {"voter", "name"}, {"proxy", "name"}, {"producers", "name[]"} } } );
+        abi.structs.emplace_back( chain::struct_def{ "regproducer", "", {
+            {"producer", "name"}, {"producer_key", "public_key"}, {"url", "string"}, {"location", "uint16"} } } );
+        for(const auto& s : abi.structs){
+            abi.actions.emplace_back( chain::action_def{ chain::name(s.name), s.name, "" } );
+        }
+        // newaccount, setabi and the other native actions
+        return chain::eosio_contract_abi(abi);
+    }
+
+    chain::abi_def block_generator::token_abi() {
+        chain::abi_def abi;
+        abi.version = "eosio::abi/1.0";
+        abi.structs.emplace_back( chain::struct_def{ "transfer", "", {
+            {"from", "name"}, {"to", "name"}, {"quantity", "asset"}, {"memo", "string"} } } );
+        abi.actions.emplace_back( chain::action_def{ N(transfer), "transfer", "" } );
+        return abi;
+    }
+
+    chain::abi_def block_generator::custom_contract_abi() {
+        auto abi = token_abi();
+        abi.structs.emplace_back( chain::struct_def{ "record", "", {
+            {"id", "uint64"}, {"owner", "name"}, {"payload", "string"} } } );
+        abi.actions.emplace_back( chain::action_def{ N(record), "record", "" } );
+        return abi;
+    }
+
+    chain::abi_def block_generator::large_abi( uint32_t structs ) {
+        auto abi = custom_contract_abi();
+        for(uint32_t i = 0; i < structs; i++){
+            chain::struct_def s{ "filler" + std::to_string(i), "", {} };
+            for(int f = 0; f < 8; f++){
+                s.fields.emplace_back( chain::field_def{ "field" + std::to_string(f), f % 2 ? "string" : "uint64" } );
+            }
+            abi.actions.emplace_back( chain::action_def{ account_name(i), s.name, "" } );
+            abi.structs.emplace_back( std::move(s) );
+        }
+        return abi;
+    }
+
+    chain::name block_generator::random_account() {
+        return account_name( rng() % options.accounts );
+    }
+
+    chain::name block_generator::random_contract() {
+        return account_name( uint64_t(1) << 40 | (rng() % options.custom_contracts) );
+    }
+
+    chain::asset block_generator::random_asset( int64_t max_amount ) {
+        return chain::asset( 1 + int64_t(rng() % uint64_t(max_amount)), chain::symbol(4, "EOS") );
+    }
+
+    chain::action block_generator::random_action( const std::string& kind ) {
+        const auto system = chain::config::system_account_name;
+
+        if( kind == "transfer" ) {
+            auto from = random_account();
+            return make_action( N(eosio.token), N(transfer), from,
+                         types::transfer{ from, random_account(), random_asset(100000000), "bench " + std::to_string(sequence) } );
+        } else if( kind == "delegatebw" ) {
+            auto from = random_account();
+            return make_action( system, N(delegatebw), from,
+                         types::delegatebw{ from, random_account(), random_asset(1000000), random_asset(1000000), false } );
+        } else if( kind == "buyram" ) {
+            auto payer = random_account();
+            return make_action( system, N(buyram), payer, types::buyram{ payer, random_account(), random_asset(1000000) } );
+        } else if( kind == "voteproducer" ) {
+            auto voter = random_account();
+            std::vector<chain::name> producers;
+            auto count = 1 + rng() % 30;
+            for(uint64_t i = 0; i < count; i++){
+                producers.emplace_back( account_name(rng() % producer_count) );
+            }
+            std::sort( producers.begin(), producers.end() );
+            producers.erase( std::unique(producers.begin(), producers.end()), producers.end() );
+            return make_action( system, N(voteproducer), voter, types::voteproducer{ voter, chain::name(), producers } );
+        } else if( kind == "newaccount" ) {
+            auto creator = random_account();
+            chain::newaccount data;
+            data.creator = creator;
+            data.name    = account_name( next_new_account++ );
+            data.owner   = chain::authority( key_for(rng()) );
+            data.active  = chain::authority( key_for(rng()) );
+            return make_action( system, chain::newaccount::get_name(), creator, data );
+        } else if( kind == "setabi" ) {
+            auto contract = random_contract();
+            return make_action( system, chain::setabi::get_name(), contract,
+                         chain::setabi{ contract, fc::raw::pack(large_abi(options.abi_structs)) } );
+        }
+        return make_custom_action();
+    }
+
+    chain::action block_generator::make_custom_action() {
+        auto contract = random_contract();
+        auto actor = random_account();
+        if( rng() % 2 ) {
+            // airdropped tokens share the eosio.token interface
+            return make_action( contract, N(transfer), actor,
+                         types::transfer{ actor, random_account(), random_asset(100000000), "" } );
+        }
+        std::string payload( 32 + rng() % 224, 'x' );
+        return make_action( contract, N(record), actor, types::record{ sequence, actor, payload } );
+    }
+
+    chain::action_trace block_generator::make_trace( const chain::action& act, uint32_t depth ) {
+        chain::action_trace trace;
+        trace.receipt.receiver = act.account;
+        trace.act = act;
+
+        if( act.name == N(transfer) ) {
+            // notifications of both parties, skipped by the indexer
+            auto data = fc::raw::unpack<types::transfer>(act.data);
+            for(const auto& party : { data.from, data.to }){
+                chain::action_trace notify;
+                notify.receipt.receiver = party;
+                notify.act = act;
+                trace.inline_traces.emplace_back( std::move(notify) );
+            }
+        }
+
+        if( depth > 0 && act.account != N(eosio.token) && act.account != chain::config::system_account_name ) {
+            auto inline_act = make_action( N(eosio.token), N(transfer), act.account,
+                                    types::transfer{ act.account, random_account(), random_asset(10000), "inline" } );
+            trace.inline_traces.emplace_back( make_trace(inline_act, depth - 1) );
+        }
+        return trace;
+    }
+
+    generated_block block_generator::next() {
+        generated_block result;
+        auto block = std::make_shared<chain::signed_block>();
+        block->timestamp = chain::block_timestamp_type( first_slot + block_num );
+        block->producer  = account_name( block_num % producer_count );
+        block->previous  = previous;
+
+        std::vector<std::vector<chain::action>> transactions;
+        if( !contracts_deployed ) {
+            // actions only decode once the ABI of their contract was indexed
+            for(const auto& deploy : { std::make_pair(chain::name(chain::config::system_account_name), system_abi()),
+                                       std::make_pair(chain::name(N(eosio.token)), token_abi()) }){
+                transactions.push_back({ make_action( chain::config::system_account_name, chain::setabi::get_name(), deploy.first,
+                                                      chain::setabi{ deploy.first, fc::raw::pack(deploy.second) } ) });
+            }
+            for(uint32_t i = 0; i < options.custom_contracts; i++){
+                auto contract = account_name( uint64_t(1) << 40 | i );
+                transactions.push_back({ make_action( chain::config::system_account_name, chain::setabi::get_name(), contract,
+                                               chain::setabi{ contract, fc::raw::pack(custom_contract_abi()) } ) });
+            }
+            contracts_deployed = true;
+        }
+
+        for(uint32_t t = 0; t < options.transactions_per_block; t++){
+            std::vector<chain::action> actions;
+            for(uint32_t a = 0; a < options.actions_per_transaction; a++){
+                actions.emplace_back( random_action(kinds[kind_dist(rng)]) );
+                sequence++;
+            }
+            transactions.emplace_back( std::move(actions) );
+        }
+
+        for(auto& actions : transactions){
+            chain::signed_transaction trx;
+            trx.expiration       = fc::time_point_sec( block->timestamp.to_time_point() ) + 30;
+            trx.ref_block_num    = uint16_t(block_num - 1);
+            // keeps the ids of otherwise identical transactions apart
+            trx.ref_block_prefix = uint32_t(sequence++);
+            trx.actions          = std::move(actions);
+
+            chain::packed_transaction packed(trx);
+            block->transactions.emplace_back( packed );
+            auto& receipt = block->transactions.back();
+            receipt.cpu_usage_us    = 100 + rng() % 900;
+            receipt.net_usage_words = (fc::raw::pack_size(packed) + 7) / 8;
+
+            auto trace = std::make_shared<chain::transaction_trace>();
+            trace->id = trx.id();
+            for(const auto& act : trx.actions){
+                trace->action_traces.emplace_back( make_trace(act, options.inline_depth) );
+            }
+            result.traces.emplace_back( std::move(trace) );
+        }
+
+        previous = block->id();
+        block_num++;
+        result.block = std::move(block);
+        return result;
+    }
+
+    std::vector<generated_block> block_generator::generate( uint32_t count ) {
+        std::vector<generated_block> blocks;
+        blocks.reserve(count);
+        for(uint32_t i = 0; i < count; i++){
+            blocks.emplace_back( next() );
+        }
+        return blocks;
+    }
+
+} } // namespace
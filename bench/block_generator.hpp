@@ -0,0 +1,82 @@
+#pragma once
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <eosio/chain/abi_def.hpp>
+#include <eosio/chain/block.hpp>
+#include <eosio/chain/trace.hpp>
+
+#include <boost/program_options.hpp>
+
+namespace eosio { namespace bench {
+
+struct generator_options {
+    uint64_t seed = 1;
+    uint32_t first_block = 2;
+    uint32_t transactions_per_block = 100;
+    uint32_t actions_per_transaction = 1;
+    uint32_t accounts = 10000;
+    uint32_t custom_contracts = 10;
+
+    // relative weight of each action kind in the mix
+    std::map<std::string, uint32_t> mix = {
+        {"transfer", 60}, {"delegatebw", 8}, {"buyram", 8}, {"voteproducer", 8},
+        {"newaccount", 5}, {"setabi", 1}, {"custom", 10}
+    };
+
+    // structs of the ABIs set by setabi actions, large ABIs stress the abi cache
+    uint32_t abi_structs = 50;
+    // inline actions below every custom action in the generated traces
+    uint32_t inline_depth = 1;
+};
+
+// options shared by the generator and the replay harness
+void add_generator_options( boost::program_options::options_description& desc );
+generator_options generator_options_from( const boost::program_options::variables_map& options );
+
+struct generated_block {
+    chain::signed_block_ptr block;
+    // traces of the block's transactions with the inline actions nodeos would have run
+    std::vector<chain::transaction_trace_ptr> traces;
+};
+
+// deterministic stream of blocks shaped like mainnet traffic, the same seed and options
+// always give the same blocks
+class block_generator {
+    public:
+        explicit block_generator( const generator_options& options );
+
+        generated_block next();
+        std::vector<generated_block> generate( uint32_t count );
+
+        static chain::name account_name( uint64_t index );
+        // the eosio.system actions the indexer parses, with the native ones
+        static chain::abi_def system_abi();
+        static chain::abi_def token_abi();
+        static chain::abi_def custom_contract_abi();
+        static chain::abi_def large_abi( uint32_t structs );
+
+    private:
+        chain::action random_action( const std::string& kind );
+        chain::action make_custom_action();
+        chain::action_trace make_trace( const chain::action& act, uint32_t depth );
+        chain::name random_account();
+        chain::name random_contract();
+        chain::asset random_asset( int64_t max_amount );
+
+        generator_options options;
+        std::mt19937_64 rng;
+        std::discrete_distribution<size_t> kind_dist;
+        std::vector<std::string> kinds;
+
+        uint32_t block_num;
+        chain::block_id_type previous;
+        uint64_t sequence = 0;
+        uint64_t next_new_account;
+        bool contracts_deployed = false;
+};
+
+} } // namespace
@@ -0,0 +1,56 @@
+/**
+ *  writes a fixture of synthetic blocks for sql_db_replay_bench
+ *
+ *  sql_db_gen_blocks --count 1000 --trx-per-block 5000 --seed 7 --out tps10k.bin
+ */
+#include "block_fixture.hpp"
+#include "block_generator.hpp"
+
+#include <iostream>
+
+using namespace eosio;
+namespace bpo = boost::program_options;
+
+int main( int argc, char** argv ) {
+    bpo::options_description desc("sql_db synthetic block generator");
+    desc.add_options()
+        ("help,h", "print this help")
+        ("count", bpo::value<uint32_t>()->default_value(1000), "number of blocks")
+        ("out", bpo::value<std::string>(), "fixture file to write")
+        ;
+    bench::add_generator_options(desc);
+
+    bpo::variables_map options;
+    try{
+        bpo::store(bpo::parse_command_line(argc, argv, desc), options);
+        bpo::notify(options);
+    } catch(const std::exception& e) {
+        std::cerr << e.what() << "\n" << desc << std::endl;
+        return 1;
+    }
+
+    if( options.count("help") || !options.count("out") ) {
+        std::cout << desc << std::endl;
+        return options.count("help") ? 0 : 1;
+    }
+
+    try{
+        bench::block_generator generator( bench::generator_options_from(options) );
+        auto count = options["count"].as<uint32_t>();
+
+        std::vector<chain::signed_block_ptr> blocks;
+        blocks.reserve(count);
+        for(uint32_t i = 0; i < count; i++){
+            blocks.emplace_back( generator.next().block );
+        }
+        bench::block_fixture::write( options["out"].as<std::string>(), blocks );
+        std::cerr << "wrote " << blocks.size() << " blocks" << std::endl;
+    } catch(const fc::exception& e) {
+        std::cerr << e.to_detail_string() << std::endl;
+        return 1;
+    } catch(const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,332 @@
+/**
+ *  microbenchmarks of the per action work of actions_table
+ *
+ *  sql_db_micro_bench --filter parse_actions --min-time 0.5 --json results.json
+ */
+#include "microbench.hpp"
+#include "action_types.hpp"
+#include "block_generator.hpp"
+#include "session_stub.hpp"
+
+#include <eosio/sql_db_plugin/actions_table.hpp>
+#include <eosio/sql_db_plugin/resource_snapshot.hpp>
+#include <eosio/sql_db_plugin/name_format.hpp>
+#include <eosio/sql_db_plugin/json_writer.hpp>
+#include <eosio/chain/contract_types.hpp>
+
+#include <fc/io/json.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <fstream>
+#include <tuple>
+#include <iostream>
+
+using namespace eosio;
+using bench::types::make_action;
+namespace bpo = boost::program_options;
+
+namespace {
+
+    const fc::microseconds max_time = fc::microseconds(150*1000);
+    const chain::name alice = N(alice);
+    const chain::name bob = N(bob);
+
+    chain::asset eos( int64_t amount ) {
+        return chain::asset( amount, chain::symbol(4, "EOS") );
+    }
+
+    // the actions of every parse_actions branch
+    std::vector<std::pair<std::string, chain::action>> sample_actions() {
+        const auto system = chain::config::system_account_name;
+        auto key = chain::public_key_type();
+
+        chain::newaccount create;
+        create.creator = alice;
+        create.name    = bob;
+        create.owner   = chain::authority(key);
+        create.active  = chain::authority(key);
+
+        return {
+            {"transfer",     make_action( N(eosio.token), N(transfer), alice, bench::types::transfer{ alice, bob, eos(10000), "memo" } )},
+            {"newaccount",   make_action( system, chain::newaccount::get_name(), alice, create )},
+            {"voteproducer", make_action( system, N(voteproducer), alice, bench::types::voteproducer{ alice, chain::name(), { N(bp1), N(bp2), N(bp3) } } )},
+            {"buyram",       make_action( system, N(buyram), alice, bench::types::buyram{ alice, bob, eos(10000) } )},
+            {"sellram",      make_action( system, N(sellram), alice, bench::types::sellram{ alice, 4096 } )},
+            {"delegatebw",   make_action( system, N(delegatebw), alice, bench::types::delegatebw{ alice, bob, eos(10000), eos(10000), false } )},
+            {"undelegatebw", make_action( system, N(undelegatebw), alice, bench::types::undelegatebw{ alice, bob, eos(10000), eos(10000) } )},
+            {"regproducer",  make_action( system, N(regproducer), alice, bench::types::regproducer{ alice, key, "https://example.com", 0 } )},
+            {"custom",       make_action( N(custom), N(record), alice, bench::types::record{ 1, alice, std::string(128, 'x') } )},
+        };
+    }
+
+    // format_asset_amount before the formatting kernels, the baseline of asset_amount_to_string
+    std::string legacy_asset_amount( const chain::asset& a ) {
+        std::string sign = a.get_amount() < 0 ? "-" : "";
+        int64_t abs_amount = std::abs(a.get_amount());
+        std::string result = fc::to_string( static_cast<int64_t>(abs_amount) / a.precision());
+        if( a.decimals() )
+        {
+            auto fract = static_cast<int64_t>(abs_amount) % a.precision();
+            result += "." + fc::to_string(a.precision() + fract).erase(0,1);
+        }
+        return sign + result;
+    }
+
+    void register_formatting( bench::microbench& suite ) {
+        const std::vector<chain::name> names = { N(eosio.token), N(transfer), N(alice), N(b1), N(genesisblock), N(eosio) };
+        const std::vector<chain::asset> assets = { eos(123456789), eos(-5), chain::asset(1, chain::symbol(8, "BTC")), eos(0) };
+
+        // the kernels have to agree with the chain functions they replace
+        for(const auto& n : names) FC_ASSERT( name_string(n) == n.to_string() && interned_name(n) == n.to_string() );
+        for(const auto& a : assets) FC_ASSERT( asset_string(a) == a.to_string() && format_asset_amount(a) == legacy_asset_amount(a) );
+
+        suite.add( "name_to_string/chain", [names]( bench::state& state ){
+            while( state.keep_running() ) {
+                for(const auto& n : names){ auto s = n.to_string(); bench::do_not_optimize(s); }
+            }
+        });
+
+        suite.add( "name_to_string/format_name", [names]( bench::state& state ){
+            char buf[max_name_chars];
+            while( state.keep_running() ) {
+                for(const auto& n : names){ auto size = format_name(n.value, buf); bench::do_not_optimize(size); }
+            }
+        });
+
+        suite.add( "name_to_string/interned", [names]( bench::state& state ){
+            while( state.keep_running() ) {
+                for(const auto& n : names){ const auto& s = interned_name(n); bench::do_not_optimize(s); }
+            }
+        });
+
+        suite.add( "string_to_name/chain", [names]( bench::state& state ){
+            std::vector<std::string> strings;
+            for(const auto& n : names) strings.push_back(n.to_string());
+            while( state.keep_running() ) {
+                for(const auto& s : strings){ chain::name n(s); bench::do_not_optimize(n); }
+            }
+        });
+
+        suite.add( "string_to_name/parse_name", [names]( bench::state& state ){
+            std::vector<std::string> strings;
+            for(const auto& n : names) strings.push_back(n.to_string());
+            while( state.keep_running() ) {
+                for(const auto& s : strings){ uint64_t v = 0; parse_name(s.data(), s.size(), v); bench::do_not_optimize(v); }
+            }
+        });
+
+        suite.add( "asset_to_string/chain", [assets]( bench::state& state ){
+            while( state.keep_running() ) {
+                for(const auto& a : assets){ auto s = a.to_string(); bench::do_not_optimize(s); }
+            }
+        });
+
+        suite.add( "asset_to_string/format_asset", [assets]( bench::state& state ){
+            char buf[max_asset_chars];
+            while( state.keep_running() ) {
+                for(const auto& a : assets){ auto size = format_asset(a, buf); bench::do_not_optimize(size); }
+            }
+        });
+
+        suite.add( "asset_amount_to_string/legacy", [assets]( bench::state& state ){
+            while( state.keep_running() ) {
+                for(const auto& a : assets){ auto s = legacy_asset_amount(a); bench::do_not_optimize(s); }
+            }
+        });
+    }
+
+    void register_benchmarks( bench::microbench& suite ) {
+        register_formatting(suite);
+
+        auto system_abi = bench::block_generator::system_abi();
+        auto token_abi  = bench::block_generator::token_abi();
+        auto large_abi  = bench::block_generator::large_abi(500);
+
+        auto system_json = fc::json::to_string(system_abi);
+        auto large_json  = fc::json::to_string(large_abi);
+
+        for(const auto& abi : { std::make_pair(std::string("system"), system_json), std::make_pair(std::string("large"), large_json) }){
+            suite.add( "abi_json_parse/" + abi.first, [json = abi.second]( bench::state& state ){
+                while( state.keep_running() ) {
+                    auto parsed = fc::json::from_string(json).as<chain::abi_def>();
+                    bench::do_not_optimize(parsed);
+                }
+            });
+        }
+
+        for(const auto& abi : { std::make_pair(std::string("system"), system_abi), std::make_pair(std::string("large"), large_abi) }){
+            suite.add( "set_abi/" + abi.first, [def = abi.second]( bench::state& state ){
+                while( state.keep_running() ) {
+                    chain::abi_serializer abis;
+                    abis.set_abi(def, max_time);
+                    bench::do_not_optimize(abis);
+                }
+            });
+        }
+
+        auto actions = sample_actions();
+        auto transfer = actions[0].second;
+        auto vote = actions[2].second;
+
+        suite.add( "binary_to_variant/transfer", [=]( bench::state& state ){
+            chain::abi_serializer abis( token_abi, max_time );
+            auto type = abis.get_action_type(transfer.name);
+            while( state.keep_running() ) {
+                auto v = abis.binary_to_variant(type, transfer.data, max_time);
+                bench::do_not_optimize(v);
+            }
+        });
+
+        suite.add( "binary_to_variant/voteproducer", [=]( bench::state& state ){
+            chain::abi_serializer abis( system_abi, max_time );
+            auto type = abis.get_action_type(vote.name);
+            while( state.keep_running() ) {
+                auto v = abis.binary_to_variant(type, vote.data, max_time);
+                bench::do_not_optimize(v);
+            }
+        });
+
+        chain::abi_serializer token_serializer( token_abi, max_time );
+        auto transfer_variant = token_serializer.binary_to_variant(token_serializer.get_action_type(transfer.name), transfer.data, max_time);
+        auto transfer_json = fc::json::to_string(transfer_variant);
+
+        suite.add( "json_to_string/transfer", [=]( bench::state& state ){
+            while( state.keep_running() ) {
+                auto json = fc::json::to_string(transfer_variant);
+                bench::do_not_optimize(json);
+            }
+        });
+
+        // the writer has to agree with fc::json on the data it writes
+        chain::abi_serializer system_serializer( system_abi, max_time );
+        auto vote_variant = system_serializer.binary_to_variant(system_serializer.get_action_type(vote.name), vote.data, max_time);
+        {
+            json_writer out;
+            FC_ASSERT( json_abi(token_abi).write_action(transfer.name, transfer.data.data(), transfer.data.size(), out) && out.str() == transfer_json );
+            out.clear();
+            FC_ASSERT( json_abi(system_abi).write_action(vote.name, vote.data.data(), vote.data.size(), out) && out.str() == fc::json::to_string(vote_variant) );
+            out.clear();
+            FC_ASSERT( json_abi(system_abi).write_field(vote.name, vote.data.data(), vote.data.size(), "producers", out) && out.str() == fc::json::to_string(vote_variant["producers"]) );
+            out.clear();
+            out.variant(vote_variant);
+            FC_ASSERT( out.str() == fc::json::to_string(vote_variant) );
+        }
+
+        suite.add( "json_writer/variant/transfer", [=]( bench::state& state ){
+            json_writer out;
+            while( state.keep_running() ) {
+                out.clear();
+                out.variant(transfer_variant);
+                bench::do_not_optimize(out.str());
+            }
+        });
+
+        for(const auto& sample : { std::make_tuple(std::string("transfer"), token_abi, transfer), std::make_tuple(std::string("voteproducer"), system_abi, vote) }){
+            suite.add( "json_writer/abi/" + std::get<0>(sample), [abi = json_abi(std::get<1>(sample)), act = std::get<2>(sample)]( bench::state& state ){
+                json_writer out;
+                while( state.keep_running() ) {
+                    out.clear();
+                    abi.write_action(act.name, act.data.data(), act.data.size(), out);
+                    bench::do_not_optimize(out.str());
+                }
+            });
+        }
+
+        suite.add( "json_to_string/voteproducer_producers", [=]( bench::state& state ){
+            while( state.keep_running() ) {
+                auto json = fc::json::to_string(vote_variant["producers"]);
+                bench::do_not_optimize(json);
+            }
+        });
+
+        suite.add( "json_writer/abi/voteproducer_producers", [abi = json_abi(system_abi), vote]( bench::state& state ){
+            json_writer out;
+            while( state.keep_running() ) {
+                out.clear();
+                abi.write_field(vote.name, vote.data.data(), vote.data.size(), "producers", out);
+                bench::do_not_optimize(out.str());
+            }
+        });
+
+        suite.add( "system_contract_arg/transfer", [=]( bench::state& state ){
+            while( state.keep_running() ) {
+                auto arg = fc::json::from_string(transfer_json).as<system_contract_arg>();
+                bench::do_not_optimize(arg);
+            }
+        });
+
+        auto session = bench::make_session_stub({
+            { chain::config::system_account_name, system_abi },
+            { N(eosio.token), token_abi },
+            { N(custom), bench::block_generator::custom_contract_abi() } });
+
+        for(const auto& sample : actions){
+            suite.add( "parse_actions/" + sample.first, [session, act = sample.second]( bench::state& state ){
+                actions_table table;
+                table.m_sink = std::make_shared<sqlite_sink>();
+                while( state.keep_running() ) {
+                    auto parsed = table.parse_actions(session, act, "0000000000000000000000000000000000000000000000000000000000000000", 1529020800, 1);
+                    bench::do_not_optimize(parsed);
+                }
+            });
+        }
+
+        suite.add( "asset_amount_to_string", []( bench::state& state ){
+            auto amount = chain::asset( 123456789, chain::symbol(4, "EOS") );
+            while( state.keep_running() ) {
+                auto s = format_asset_amount(amount);
+                bench::do_not_optimize(s);
+            }
+        });
+    }
+
+}
+
+int main( int argc, char** argv ) {
+    bpo::options_description desc("sql_db action microbenchmarks");
+    desc.add_options()
+        ("help,h", "print this help")
+        ("filter", bpo::value<std::string>()->default_value(""), "only run the benchmarks whose name contains this")
+        ("min-time", bpo::value<double>()->default_value(0.2), "minimum seconds per benchmark")
+        ("json", bpo::value<std::string>(), "write the results to this file")
+        ;
+
+    bpo::variables_map options;
+    try{
+        bpo::store(bpo::parse_command_line(argc, argv, desc), options);
+        bpo::notify(options);
+    } catch(const std::exception& e) {
+        std::cerr << e.what() << "\n" << desc << std::endl;
+        return 1;
+    }
+    if( options.count("help") ) {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    try{
+        bench::microbench suite;
+        register_benchmarks(suite);
+        auto results = suite.run( options["filter"].as<std::string>(), options["min-time"].as<double>() );
+
+        for(const auto& r : results){
+            std::printf("%-36s %12.0f ns %10.1f allocs %12.0f bytes %12llu iterations\n",
+                        r.name.c_str(), r.ns_per_op, r.allocs_per_op, r.bytes_per_op, (unsigned long long)r.iterations);
+        }
+
+        if( options.count("json") ) {
+            std::ofstream out( options["json"].as<std::string>() );
+            out << fc::json::to_pretty_string( fc::mutable_variant_object()
+                ("benchmarks", results)
+                ("min_time", options["min-time"].as<double>()) ) << std::endl;
+        }
+    } catch(const fc::exception& e) {
+        std::cerr << e.to_detail_string() << std::endl;
+        return 1;
+    } catch(const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
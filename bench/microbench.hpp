@@ -0,0 +1,87 @@
+#pragma once
+
+// a small Google Benchmark style runner: every benchmark loops on state.keep_running(),
+// the runner grows the iteration count until a run lasts min_time and reports ns,
+// allocations and bytes allocated per iteration. needs alloc_counter.hpp in the executable.
+
+#include "alloc_counter.hpp"
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <fc/reflect/variant.hpp>
+
+namespace eosio { namespace bench {
+
+template<typename T>
+inline void do_not_optimize( const T& value ) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class state {
+    public:
+        explicit state( uint64_t iterations ):remaining(iterations),iterations(iterations){}
+
+        bool keep_running() { return remaining-- > 0; }
+        uint64_t max_iterations() const { return iterations; }
+
+    private:
+        uint64_t remaining;
+        uint64_t iterations;
+};
+
+struct result {
+    std::string name;
+    uint64_t iterations = 0;
+    double   ns_per_op = 0;
+    double   allocs_per_op = 0;
+    double   bytes_per_op = 0;
+};
+
+class microbench {
+    public:
+        typedef std::function<void(state&)> function;
+
+        void add( const std::string& name, function f ) { benchmarks.emplace_back(name, std::move(f)); }
+
+        // runs the benchmarks whose name contains filter
+        std::vector<result> run( const std::string& filter, double min_time ) const {
+            std::vector<result> results;
+            for(const auto& b : benchmarks){
+                if( !filter.empty() && b.first.find(filter) == std::string::npos ) continue;
+
+                uint64_t iterations = 1;
+                while( true ) {
+                    state s(iterations);
+                    alloc_counter::scope allocs;
+                    auto start = std::chrono::steady_clock::now();
+                    b.second(s);
+                    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                    if( seconds >= min_time || iterations >= (uint64_t(1) << 30) ) {
+                        result r;
+                        r.name          = b.first;
+                        r.iterations    = iterations;
+                        r.ns_per_op     = seconds * 1e9 / iterations;
+                        r.allocs_per_op = double(allocs.allocations()) / iterations;
+                        r.bytes_per_op  = double(allocs.allocated_bytes()) / iterations;
+                        results.emplace_back(r);
+                        break;
+                    }
+                    // aim past min_time on the next run, at most 10x more
+                    double factor = seconds > 0 ? min_time * 1.4 / seconds : 10;
+                    iterations = std::max<uint64_t>( iterations + 1, iterations * std::min(factor, 10.0) );
+                }
+            }
+            return results;
+        }
+
+    private:
+        std::vector<std::pair<std::string, function>> benchmarks;
+};
+
+} } // namespace
+
+FC_REFLECT( eosio::bench::result, (name)(iterations)(ns_per_op)(allocs_per_op)(bytes_per_op) )
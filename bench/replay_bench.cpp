@@ -0,0 +1,261 @@
+/**
+ *  replays recorded blocks through sql_database::consume and reports the
+ *  indexing throughput, allocations and the per stage time of the plugin metrics.
+ *
+ *  sql_db_replay_bench --fixture blocks.bin --sink null
+ *  sql_db_replay_bench --generate 500 --trx-per-block 5000 --traces --through-consumer
+ *  sql_db_replay_bench --blocks-dir ~/.local/share/eosio/nodeos/data/blocks --first 2000000 --count 5000 --sink mysql --uri mysql://db=eos
+ */
+#include "alloc_counter.hpp"
+#include "block_fixture.hpp"
+#include "block_generator.hpp"
+#include "../consumer.hpp"
+
+#include <eosio/sql_db_plugin/action_ordinal.hpp>
+#include <eosio/sql_db_plugin/database.hpp>
+#include <eosio/sql_db_plugin/metrics.hpp>
+#include <eosio/sql_db_plugin/sql_profiler.hpp>
+#include <eosio/chain/block_log.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace eosio;
+namespace bpo = boost::program_options;
+
+namespace {
+
+    std::vector<chain::signed_block_ptr> read_block_log( const std::string& dir, uint32_t first, uint32_t count ) {
+        chain::block_log log(dir);
+        std::vector<chain::signed_block_ptr> blocks;
+        for(uint32_t num = first; num < first + count; num++){
+            auto block = log.read_block_by_num(num);
+            if( !block ) break;
+            blocks.emplace_back(block);
+        }
+        return blocks;
+    }
+
+    std::string default_uri( const std::string& sink ) {
+        if( sink == "null" ) return "empty://";
+        if( sink == "sqlite" ) return "sqlite3://db=replay_bench.sqlite";
+        if( sink == "postgresql" ) return "postgresql://dbname=replay_bench";
+        return "";
+    }
+
+    uint64_t count_actions( const std::vector<chain::signed_block_ptr>& blocks ) {
+        uint64_t actions = 0;
+        for(const auto& block : blocks){
+            for(const auto& receipt : block->transactions){
+                if( !receipt.trx.contains<chain::packed_transaction>() ) continue;
+                actions += receipt.trx.get<chain::packed_transaction>().get_transaction().actions.size();
+            }
+        }
+        return actions;
+    }
+
+    std::vector<block_record_ptr> to_records( const std::vector<chain::block_state_ptr>& states ) {
+        std::vector<block_record_ptr> records;
+        records.reserve(states.size());
+        for(const auto& bs : states) records.emplace_back( std::make_shared<const block_record>(bs) );
+        return records;
+    }
+
+    // the per action path consume_block replaced: a lease, a copy of the action and an abi
+    // parsed for every action, replayed so the allocations of both are counted in one run
+    uint64_t replay_per_action( sql_database& db, const std::vector<block_record_ptr>& records ) {
+        uint64_t actions = 0;
+        const std::vector<std::string> no_filter;
+        for(const auto& record : records){
+            const auto& block = *record;
+            for(const auto& trx : block.transactions){
+                if( trx.action_count == 1 && block.actions[trx.first_action].name == N(onblock) ) continue;
+                for(uint32_t i = 0; i < trx.action_count; i++){
+                    auto act = block.action( block.actions[trx.first_action + i] );
+                    db.m_actions_table->invalidate_abi( act.account );
+                    db.m_actions_table->add( db.m_session_pool->get_session(), act, trx.id, block.timestamp, block.block_num, no_filter,
+                                             action_ordinal(block.block_num, trx.first_action + i), trx.index, i );
+                    actions++;
+                }
+            }
+        }
+        return actions;
+    }
+
+}
+
+int main( int argc, char** argv ) {
+    bpo::options_description desc("sql_db replay benchmark");
+    desc.add_options()
+        ("help,h", "print this help")
+        ("fixture", bpo::value<std::string>(), "fixture file of packed signed blocks")
+        ("blocks-dir", bpo::value<std::string>(), "directory of a blocks.log to read the blocks from")
+        ("generate", bpo::value<uint32_t>(), "number of synthetic blocks to generate instead")
+        ("traces", bpo::bool_switch()->default_value(false), "also index the inline actions of generated blocks")
+        ("through-consumer", bpo::bool_switch()->default_value(false), "push the blocks through the consumer queue and thread")
+        ("queue-size", bpo::value<uint32_t>()->default_value(5000), "consumer queue size")
+        ("first", bpo::value<uint32_t>()->default_value(1), "first block read from blocks.log")
+        ("count", bpo::value<uint32_t>()->default_value(1000), "number of blocks read from blocks.log")
+        ("write-fixture", bpo::value<std::string>(), "save the loaded blocks as a fixture file and exit")
+        ("sink", bpo::value<std::string>()->default_value("null"), "null, mysql, sqlite or postgresql")
+        ("uri", bpo::value<std::string>(), "soci connection string, defaults to an empty or a local sqlite database")
+        ("pool-size", bpo::value<uint32_t>()->default_value(5), "sessions in the pool")
+        ("repeat", bpo::value<uint32_t>()->default_value(1), "number of passes over the blocks")
+        ("history-dir", bpo::value<std::string>(), "also write the action history database to this directory")
+        ("max-allocs-per-action", bpo::value<double>(), "exit with status 2 when the replay allocates more per action")
+        ("max-alloc-ratio", bpo::value<double>(), "replay the blocks through the per action path first and exit with status 2 when the replay allocates more per action than this fraction of it")
+        ;
+    bench::add_generator_options(desc);
+
+    bpo::variables_map options;
+    try{
+        bpo::store(bpo::parse_command_line(argc, argv, desc), options);
+        bpo::notify(options);
+    } catch(const std::exception& e) {
+        std::cerr << e.what() << "\n" << desc << std::endl;
+        return 1;
+    }
+
+    if( options.count("help") || (!options.count("fixture") && !options.count("blocks-dir") && !options.count("generate")) ) {
+        std::cout << desc << std::endl;
+        return options.count("help") ? 0 : 1;
+    }
+
+    try{
+        std::vector<chain::signed_block_ptr> blocks;
+        std::vector<std::vector<chain::transaction_trace_ptr>> traces;
+        if( options.count("generate") ) {
+            bench::block_generator generator( bench::generator_options_from(options) );
+            for(auto& generated : generator.generate( options["generate"].as<uint32_t>() )){
+                blocks.emplace_back( std::move(generated.block) );
+                traces.emplace_back( std::move(generated.traces) );
+            }
+        } else if( options.count("fixture") ) {
+            blocks = bench::block_fixture::read( options["fixture"].as<std::string>() );
+        } else {
+            blocks = read_block_log( options["blocks-dir"].as<std::string>(), options["first"].as<uint32_t>(), options["count"].as<uint32_t>() );
+        }
+
+        if( options.count("write-fixture") ) {
+            bench::block_fixture::write( options["write-fixture"].as<std::string>(), blocks );
+            std::cerr << "wrote " << blocks.size() << " blocks" << std::endl;
+            return 0;
+        }
+
+        auto sink = options["sink"].as<std::string>();
+        auto uri = options.count("uri") ? options["uri"].as<std::string>() : default_uri(sink);
+        if( uri.empty() ) {
+            std::cerr << "--uri is required for the " << sink << " sink" << std::endl;
+            return 1;
+        }
+
+        auto db = std::make_unique<sql_database>( uri, 0, options["pool-size"].as<uint32_t>() );
+        if( sink != "null" && !db->is_started() ) db->wipe();
+        if( options.count("history-dir") ) db->enable_history( options["history-dir"].as<std::string>(), 4096 );
+
+        std::vector<chain::block_state_ptr> states;
+        states.reserve(blocks.size());
+        for(const auto& block : blocks) states.emplace_back( bench::block_fixture::to_block_state(block) );
+
+        uint64_t baseline_allocations = 0, baseline_actions = 0;
+        if( options.count("max-alloc-ratio") ) {
+            bench::alloc_counter::scope baseline;
+            baseline_actions = replay_per_action( *db, to_records(states) );
+            baseline_allocations = baseline.allocations();
+            profiler().reset();
+        }
+
+        // the consumer owns the database once started, the traces still go to it directly
+        sql_database* index = db.get();
+        std::unique_ptr<consumer> queue;
+        if( options["through-consumer"].as<bool>() ) {
+            account_monitor_options no_monitor;
+            no_monitor.threads = 0;
+            queue = std::make_unique<consumer>( std::move(db), options["queue-size"].as<uint32_t>(), no_monitor );
+        }
+        bool with_traces = options["traces"].as<bool>();
+
+        auto repeat = options["repeat"].as<uint32_t>();
+        uint64_t blocks_before = metrics().blocks.load();
+        bench::alloc_counter::scope allocs;
+        auto start = std::chrono::steady_clock::now();
+
+        for(uint32_t pass = 0; pass < repeat; pass++){
+            // the records are decoded from the block states in every pass, as the consumer does,
+            // and one consume() call per pass so the sink batches the blocks like the consumer does
+            if( !queue && !with_traces ) {
+                index->consume( to_records(states) );
+                continue;
+            }
+            for(size_t i = 0; i < states.size(); i++){
+                const auto& bs = states[i];
+                if( queue ) queue->push_block_state(bs);
+                else index->consume_block( block_record(bs) );
+
+                if( with_traces && i < traces.size() ) {
+                    for(const auto& trace : traces[i]){
+                        index->consume_transaction_trace( trace_and_block_time{ trace, bs->block->timestamp } );
+                    }
+                }
+            }
+        }
+
+        if( queue ) {
+            while( metrics().blocks.load() - blocks_before < uint64_t(states.size()) * repeat ) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            queue->shutdown();
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint64_t total_blocks = uint64_t(blocks.size()) * repeat;
+        uint64_t total_actions = count_actions(blocks) * repeat;
+        auto status = metrics().status();
+
+        auto report = fc::mutable_variant_object()
+            ("sink", sink)
+            ("blocks", total_blocks)
+            ("actions", total_actions)
+            ("seconds", seconds)
+            ("blocks_per_sec", seconds > 0 ? total_blocks / seconds : 0)
+            ("actions_per_sec", seconds > 0 ? total_actions / seconds : 0)
+            ("allocations", allocs.allocations())
+            ("allocated_bytes", allocs.allocated_bytes())
+            ("allocations_per_action", total_actions ? double(allocs.allocations()) / total_actions : 0)
+            ("per_action_path_allocations_per_action", baseline_actions ? double(baseline_allocations) / baseline_actions : 0)
+            ("stages", status["stages"])
+            ("tables", status["tables"])
+            ("statements", profiler().dump(20));
+
+        std::cout << fc::json::to_pretty_string(report) << std::endl;
+
+        // regression check of the per action allocations, see the sql_db_action_allocs test
+        if( options.count("max-allocs-per-action") && total_actions > 0 ) {
+            double per_action = double(allocs.allocations()) / total_actions;
+            if( per_action > options["max-allocs-per-action"].as<double>() ) {
+                std::cerr << per_action << " allocations per action, more than " << options["max-allocs-per-action"].as<double>() << std::endl;
+                return 2;
+            }
+        }
+        if( options.count("max-alloc-ratio") && total_actions > 0 && baseline_actions > 0 ) {
+            double ratio = (double(allocs.allocations()) / total_actions) / (double(baseline_allocations) / baseline_actions);
+            if( ratio > options["max-alloc-ratio"].as<double>() ) {
+                std::cerr << "allocations per action are " << ratio << " of the per action path, more than " << options["max-alloc-ratio"].as<double>() << std::endl;
+                return 2;
+            }
+        }
+    } catch(const fc::exception& e) {
+        std::cerr << e.to_detail_string() << std::endl;
+        return 1;
+    } catch(const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
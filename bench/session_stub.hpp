@@ -0,0 +1,34 @@
+#pragma once
+
+// an in-memory sqlite session standing in for MySQL, with the schema of the sqlite
+// sink and the ABIs the parsed actions need
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <soci/soci.h>
+#include <soci/sqlite3/soci-sqlite3.h>
+
+#include <eosio/chain/abi_def.hpp>
+#include <eosio/sql_db_plugin/sql_sink.hpp>
+#include <fc/io/json.hpp>
+
+namespace eosio { namespace bench {
+
+inline std::shared_ptr<soci::session> make_session_stub( const std::vector<std::pair<chain::name, chain::abi_def>>& abis ) {
+    auto session = std::make_shared<soci::session>(soci::sqlite3, ":memory:");
+
+    sqlite_sink sink;
+    sink.open(*session);
+    sink.create_schema(*session);
+
+    for(const auto& abi : abis){
+        std::string name = abi.first.to_string();
+        std::string json = fc::json::to_string(abi.second);
+        *session << "INSERT INTO accounts (name, abi) VALUES (:name, :abi)", soci::use(name), soci::use(json);
+    }
+    return session;
+}
+
+} } // namespace
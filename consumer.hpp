@@ -15,6 +15,7 @@
 #include <eosio/chain/transaction.hpp>
 #include <fc/log/logger.hpp>
 #include <eosio/sql_db_plugin/database.hpp>
+#include <eosio/sql_db_plugin/account_monitor.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
 // #include "database.hpp"
 
@@ -22,74 +23,78 @@ namespace eosio {
 
 class consumer final : public boost::noncopyable {
     public:
-        consumer(std::unique_ptr<sql_database> db, size_t queue_size);
+        // queue_bytes caps the bytes held by the queued block records, 0 for no cap
+        consumer(std::unique_ptr<sql_database> db, size_t queue_size, const account_monitor_options& monitor_options, size_t queue_bytes = 0);
         ~consumer();
         void shutdown();
 
         template<typename Queue, typename Entry>
-        void queue(boost::mutex&, boost::condition_variable&, Queue&, const Entry&, size_t );
+        void queue(boost::mutex&, boost::condition_variable&, Queue&, const Entry&, size_t, size_t entry_bytes = 0 );
 
         void push_transaction_metadata( const chain::transaction_metadata_ptr& );
         void push_block_state( const chain::block_state_ptr& );
+        void run_decode();
         void run_blocks();
-        void run_monitors();
 
-        std::deque<chain::block_state_ptr> block_state_queue;
-        std::deque<chain::block_state_ptr> block_state_process_queue;
+        // the block states waiting for the decode thread, a few at most
+        static const size_t decode_queue_size = 8;
+        std::deque<chain::block_state_ptr> decode_queue;
+        std::deque<block_record_ptr> block_queue;
+        std::deque<block_record_ptr> block_process_queue;
         std::deque<chain::transaction_metadata_ptr> transaction_metadata_queue;
         std::deque<chain::transaction_metadata_ptr> transaction_metadata_process_queue;
 
         std::unique_ptr<sql_database> db;
         size_t queue_size;
+        size_t queue_bytes;
+        size_t queued_bytes = 0;
+        boost::atomic<bool> stopped{false};
+        boost::atomic<bool> decode_exit{false};
         boost::atomic<bool> exit{false};
-        boost::thread consume_thread_run_blocks;
+        boost::mutex mtx_decode;
+        boost::condition_variable decode_condition;
         boost::mutex mtx_blocks;
-
-        boost::thread consume_thread_run_monitors;
-        boost::mutex mtx_monitors;
         boost::condition_variable condition;
 
-        int min_account_id;
-        int max_account_id;
-        int cur_account_id;
-        bool start_loop;
-        bool is_waiting;
-
+        std::unique_ptr<account_monitor> monitor;
 
+        // started last, once every member the threads touch is initialized
+        boost::thread decode_thread;
+        boost::thread consume_thread_run_blocks;
     };
 
-    consumer::consumer(std::unique_ptr<sql_database> db, size_t queue_size):
+    inline consumer::consumer(std::unique_ptr<sql_database> db, size_t queue_size, const account_monitor_options& monitor_options, size_t queue_bytes):
         db(std::move(db)),
         queue_size(queue_size),
+        queue_bytes(queue_bytes),
         exit(false),
-        min_account_id(0),
-        cur_account_id(0),
-        start_loop(false),
-        is_waiting(true),
-        consume_thread_run_blocks(boost::thread([&]{this->run_blocks();})),
-        consume_thread_run_monitors(boost::thread([&]{this->run_monitors();}))
+        monitor(monitor_options.threads > 0 ? std::make_unique<account_monitor>(*this->db, monitor_options) : nullptr),
+        decode_thread(boost::thread([&]{this->run_decode();})),
+        consume_thread_run_blocks(boost::thread([&]{this->run_blocks();}))
         { }
 
-    consumer::~consumer() {
-        exit = true;
-        condition.notify_all();
-        consume_thread_run_blocks.join();
-        consume_thread_run_monitors.join();
+    inline consumer::~consumer() {
+        shutdown();
     }
 
-    void consumer::shutdown() {
+    inline void consumer::shutdown() {
+        if( stopped.exchange(true) ) return;
+        // the decoded blocks are queued before the consumer thread drains the queue
+        decode_exit = true;
+        decode_condition.notify_all();
+        if( decode_thread.joinable() ) decode_thread.join();
         exit = true;
         condition.notify_all();
-        consume_thread_run_blocks.join();
-        consume_thread_run_monitors.join();
+        if( consume_thread_run_blocks.joinable() ) consume_thread_run_blocks.join();
+        if( monitor ) monitor->shutdown();
     }
 
     template<typename Queue, typename Entry>
-    void consumer::queue(boost::mutex& mtx, boost::condition_variable& condition, Queue& queue, const Entry& e, size_t queue_size) {
+    void consumer::queue(boost::mutex& mtx, boost::condition_variable& condition, Queue& queue, const Entry& e, size_t queue_size, size_t entry_bytes) {
         int sleep_time = 100;
         size_t last_queue_size = 0;
         boost::mutex::scoped_lock lock(mtx);
-        if (queue.size() > queue_size) {
+        if (queue.size() > queue_size || (queue_bytes > 0 && queued_bytes > queue_bytes)) {
             lock.unlock();
             condition.notify_one();
             if (last_queue_size < queue.size()) {
@@ -103,13 +108,23 @@ class consumer final : public boost::noncopyable {
             lock.lock();
         }
         queue.emplace_back(e);
+        queued_bytes += entry_bytes;
+        metrics().queue_depth = queue.size();
+        metrics().queue_bytes = queued_bytes;
         lock.unlock();
         condition.notify_all();
     }
 
-    void consumer::push_block_state( const chain::block_state_ptr& bs ){
+    inline void consumer::push_block_state( const chain::block_state_ptr& bs ){
         try {
-            queue(mtx_blocks, condition, block_state_queue, bs, queue_size);
+            // runs on the main thread, the decode thread unpacks the block into its record
+            boost::mutex::scoped_lock lock(mtx_decode);
+            while( decode_queue.size() >= decode_queue_size && !decode_exit ){
+                decode_condition.wait(lock);
+            }
+            decode_queue.push_back(bs);
+            lock.unlock();
+            decode_condition.notify_all();
         } catch (fc::exception& e) {
             elog("FC Exception while accepted_block ${e}", ("e", e.to_string()));
         } catch (std::exception& e) {
@@ -119,42 +134,64 @@ class consumer final : public boost::noncopyable {
         }
     }
 
-    void consumer::run_blocks() {
+    inline void consumer::run_decode() {
+        while( true ){
+            std::deque<chain::block_state_ptr> states;
+            {
+                boost::mutex::scoped_lock lock(mtx_decode);
+                while( decode_queue.empty() && !decode_exit ){
+                    decode_condition.wait(lock);
+                }
+                if( decode_queue.empty() ) break;
+                states.swap(decode_queue);
+            }
+            decode_condition.notify_all();
+
+            // only the indexed fields are queued, the block states are released here
+            for(auto& bs : states){
+                try {
+                    auto record = std::make_shared<const block_record>(bs);
+                    bs.reset();
+                    queue(mtx_blocks, condition, block_queue, record, queue_size, record->bytes());
+                } catch (fc::exception& e) {
+                    elog("FC Exception while unpacking block ${n} ${e}", ("n", bs ? bs->block_num : 0)("e", e.to_string()));
+                } catch (std::exception& e) {
+                    elog("STD Exception while unpacking block ${n} ${e}", ("n", bs ? bs->block_num : 0)("e", e.what()));
+                }
+            }
+        }
+    }
+
+    inline void consumer::run_blocks() {
         ilog("Consumer thread Start run_blocks");
-        while (!exit) { 
+        while (true) { 
             try{
                 boost::mutex::scoped_lock lock(mtx_blocks);
-                while(block_state_queue.empty() && !exit){
+                while(block_queue.empty() && !exit){
                     condition.wait(lock);
                 }
+                // the queue is drained before the thread ends
+                if( block_queue.empty() ) break;
 
-                size_t block_state_size = block_state_queue.size();
-                if( block_state_size > 0 ){
-                    block_state_process_queue = std::move(block_state_queue);
-                }
+                size_t block_size = block_queue.size();
+                block_process_queue = std::move(block_queue);
+                block_queue.clear();
+                queued_bytes = 0;
+                metrics().queue_depth = 0;
+                metrics().queue_bytes = 0;
 
                 lock.unlock();
 
-                if( block_state_size > (queue_size * 0.75)) {
-                    wlog("reversible queue size: ${q}", ("q", block_state_size));
+                if( block_size > (queue_size * 0.75)) {
+                    wlog("reversible queue size: ${q}", ("q", block_size));
                 } else if (exit) {
-                    ilog("reversible draining queue, size: ${q}", ("q", block_state_size));
+                    ilog("reversible draining queue, size: ${q}", ("q", block_size));
                 }          
 
                 // process blocks
-                while (!block_state_process_queue.empty()) {
-                    const auto& bs = block_state_process_queue.front();
-                    try{
-                        db->consume_block_state( bs );
-                    } catch (fc::exception& e) {
-                        elog("FC Exception while consuming block ${e}", ("e", e.to_string()));
-                    } catch (std::exception& e) {
-                        elog("STD Exception while consuming block ${e}", ("e", e.what()));
-                    } catch (...) {
-                        elog("Unknown exception while consuming block");
-                    } 
-                    block_state_process_queue.pop_front();
-                }
+                std::vector<block_record_ptr> blocks( block_process_queue.begin(), block_process_queue.end() );
+                block_process_queue.clear();
+                db->consume( blocks );
 
                 condition.notify_all();
             } catch (std::exception& e) {
@@ -168,49 +205,5 @@ class consumer final : public boost::noncopyable {
         ilog("Consumer thread End run_blocks");
     }
 
-    void consumer::run_monitors() {
-
-        ilog("Consumer thread Start run_monitors");
-        while (!exit) { 
-                           
-            if(is_waiting){
-                boost::this_thread::sleep(boost::posix_time::seconds(10));
-                is_waiting = false;
-            }
-            
-            /*
-            //开始求得第一条和最后一条记录的ID
-            if(!start_loop){
-            
-                min_account_id = db->get_min_account_id();
-                max_account_id = db->get_max_account_id();
-                cur_account_id = min_account_id;
-                start_loop = true;
-            
-            }
-
-            //开始循环从第一条记录
-            if(cur_account_id >= 0){
-
-                if(db->monitoraccount(cur_account_id))
-                {
-                    cur_account_id = cur_account_id + 1;
-
-                    if(cur_account_id > max_account_id){
-                        start_loop = false;
-                    }
-                }
-            }
-            */
-           
-            boost::this_thread::sleep(boost::posix_time::milliseconds(10));
-
-        }
-        
-        ilog("Consumer thread End run_monitors");
-    }
-
-
-
 } // namespace
 
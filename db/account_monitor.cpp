@@ -0,0 +1,103 @@
+#include <eosio/sql_db_plugin/account_monitor.hpp>
+
+#include <fc/log/logger.hpp>
+
+namespace eosio {
+
+    bool rate_limiter::acquire( size_t n, const boost::atomic<bool>& exit ) {
+        if( per_second == 0 ) return true;
+
+        while( !exit ) {
+            boost::mutex::scoped_lock lock(mtx);
+            auto now = boost::posix_time::microsec_clock::universal_time();
+            if( window_start.is_not_a_date_time() || now - window_start >= boost::posix_time::seconds(1) ) {
+                window_start = now;
+                used = 0;
+            }
+
+            // a batch larger than the whole budget still goes through on an empty window
+            if( used == 0 || used + n <= per_second ) {
+                used += n;
+                return true;
+            }
+
+            auto wait = window_start + boost::posix_time::seconds(1) - now;
+            lock.unlock();
+            boost::this_thread::sleep(std::min(wait, boost::posix_time::time_duration(boost::posix_time::milliseconds(100))));
+        }
+        return false;
+    }
+
+    account_monitor::account_monitor(sql_database& db, const account_monitor_options& options):
+        db(db),
+        options(options),
+        limiter(options.accounts_per_second)
+    {
+        for(uint32_t i = 0; i < options.threads; i++){
+            workers.create_thread([this]{ this->run(); });
+        }
+    }
+
+    account_monitor::~account_monitor() {
+        shutdown();
+    }
+
+    void account_monitor::shutdown() {
+        exit = true;
+        workers.join_all();
+    }
+
+    std::vector<chain::account_name> account_monitor::next_sweep_batch() {
+        std::vector<chain::account_name> accounts;
+        if( options.sweep_ms == 0 ) return accounts;
+
+        boost::mutex::scoped_lock lock(mtx_sweep);
+        auto now = boost::posix_time::microsec_clock::universal_time();
+        if( !last_sweep.is_not_a_date_time() && now - last_sweep < boost::posix_time::milliseconds(options.sweep_ms) ) {
+            return accounts;
+        }
+        last_sweep = now;
+
+        auto last_id = db.next_accounts(sweep_cursor, options.batch_size, accounts);
+        // start over once the end of the accounts table is reached
+        sweep_cursor = accounts.empty() ? 0 : last_id;
+        return accounts;
+    }
+
+    void account_monitor::run() {
+        ilog("account monitor thread start");
+
+        // give the chain time to come up before reading from it
+        for(int i = 0; i < 100 && !exit; i++){
+            boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+        }
+
+        while( !exit ) {
+            try{
+                // accounts touched by ingested actions come first
+                auto accounts = db.m_dirty_accounts->drain(options.batch_size);
+                const bool dirty = !accounts.empty();
+                if( !dirty ) {
+                    accounts = next_sweep_batch();
+                }
+
+                if( accounts.empty() ) {
+                    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+                    continue;
+                }
+
+                if( !limiter.acquire(accounts.size(), exit) ) break;
+                db.refresh_accounts(accounts, dirty);
+            } catch (fc::exception& e) {
+                elog("FC Exception while refreshing accounts ${e}", ("e", e.to_string()));
+            } catch (std::exception& e) {
+                elog("STD Exception while refreshing accounts ${e}", ("e", e.what()));
+            } catch (...) {
+                elog("Unknown exception while refreshing accounts");
+            }
+        }
+
+        ilog("account monitor thread end");
+    }
+
+} // namespace
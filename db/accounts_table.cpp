@@ -1,13 +1,16 @@
 // #include "accounts_table.hpp"
 #include <eosio/sql_db_plugin/accounts_table.hpp>
+#include <eosio/sql_db_plugin/sql_profiler.hpp>
 #include <fc/log/logger.hpp>
 
 namespace eosio {
 
 void accounts_table::add(std::shared_ptr<soci::session> m_session, string name) {
     try {
-        *m_session << "INSERT INTO accounts (name) VALUES (:name)",
+        statement_timer stmt(*m_session, "INSERT INTO accounts (name) VALUES (:name)");
+        *m_session << stmt.sql(),
             soci::use(name);
+        stmt.done();
     } catch(soci::mysql_soci_error e) {
         wlog("soci::error: ${e}",("e",e.what()) );
     } catch (std::exception const & e) {
@@ -20,8 +23,11 @@ void accounts_table::add(std::shared_ptr<soci::session> m_session, string name)
 
 void accounts_table::add_eosio(std::shared_ptr<soci::session> m_session, string name,string abi) {
     try {
-        *m_session << "INSERT INTO accounts (name,abi) VALUES (:name,:abi)",
-            soci::use(name),soci::use(abi);
+        const auto stored = m_codec->encode(abi);
+        statement_timer stmt(*m_session, "INSERT INTO accounts (name,abi) VALUES (:name,:abi)");
+        *m_session << stmt.sql(),
+            soci::use(name),soci::use(stored);
+        stmt.done();
     } catch(soci::mysql_soci_error e) {
         wlog("soci::error: ${e}",("e",e.what()) );
     } catch (std::exception const & e) {
@@ -35,7 +41,9 @@ bool accounts_table::exist(std::shared_ptr<soci::session> m_session, string name
 {
     int amount;
     try {
-        *m_session << "SELECT COUNT(*) FROM accounts WHERE name = :name", soci::into(amount), soci::use(name);
+        statement_timer stmt(*m_session, "SELECT COUNT(*) FROM accounts WHERE name = :name");
+        *m_session << stmt.sql(), soci::into(amount), soci::use(name);
+        stmt.done();
     } catch(soci::mysql_soci_error e) {
         wlog("soci::error: ${e}",("e",e.what()) );
     } catch (std::exception const & e) {
@@ -0,0 +1,305 @@
+#include <eosio/sql_db_plugin/action_history.hpp>
+#include <eosio/sql_db_plugin/name_format.hpp>
+
+#include <eosio/chain/eosio_contract.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace eosio {
+
+    namespace {
+        const fc::microseconds max_serialization_time = fc::microseconds(150*1000);
+    }
+
+    action_history::action_history( const boost::filesystem::path& dir, uint64_t size_mb )
+    :db(dir, chainbase::database::read_write, size_mb * 1024 * 1024) {
+        db.add_index<history::action_index>();
+        db.add_index<history::account_index>();
+        db.add_index<history::abi_index>();
+        db.add_index<history::decoded_index>();
+        ilog("action history in ${d}, ${n} actions", ("d", dir.string())("n", db.get_index<history::action_index>().indices().size()));
+    }
+
+    action_history::~action_history() {
+        {
+            boost::mutex::scoped_lock lock(materialize_mtx);
+            done = true;
+        }
+        materialize_cv.notify_all();
+        if( materializer.joinable() ) materializer.join();
+    }
+
+    std::vector<chain::name> action_history::touched_accounts( const chain::action& act, const fc::variant& abi_data ) {
+        std::vector<chain::name> accounts;
+        accounts.push_back(act.account);
+        for(const auto& auth : act.authorization){
+            accounts.push_back(auth.actor);
+        }
+
+        if( abi_data.is_object() ){
+            const auto& data = abi_data.get_object();
+            for(const char* field : { "from", "to", "receiver", "payer", "account", "voter", "owner", "creator", "name", "producer", "issuer", "proposer" }){
+                auto itr = data.find(field);
+                if( itr == data.end() || !itr->value().is_string() ) continue;
+                // memo like strings of custom contracts are not names
+                const auto& s = itr->value().get_string();
+                uint64_t value = 0;
+                if( parse_name(s.data(), s.size(), value) && value != 0 ) accounts.push_back(chain::name(value));
+            }
+        }
+
+        std::sort(accounts.begin(), accounts.end());
+        accounts.erase(std::unique(accounts.begin(), accounts.end()), accounts.end());
+        return accounts;
+    }
+
+    void action_history::add( const chain::action& act, const fc::variant& abi_data, uint32_t block_num, uint64_t ordinal,
+                              uint32_t block_time, const chain::transaction_id_type& trx_id ) {
+        if( ordinal == 0 ) return;
+
+        action_history_record record;
+        record.ordinal    = ordinal;
+        record.block_num  = block_num;
+        record.block_time = block_time;
+        record.trx_id     = trx_id;
+        record.act        = act;
+        auto packed = fc::raw::pack(record);
+        auto accounts = touched_accounts(act, abi_data);
+
+        boost::mutex::scoped_lock lock(mtx);
+        block_ordinals.insert(ordinal);
+        if( const auto* obj = db.find<history::action_object, history::by_ordinal>(ordinal) ){
+            // a replay stores the same action again, a fork block that lost stored another one
+            if( obj->packed.size() == packed.size() && std::equal(packed.begin(), packed.end(), obj->packed.begin()) ) return;
+            erase(ordinal);
+        }
+
+        db.create<history::action_object>([&]( auto& obj ){
+            obj.ordinal = ordinal;
+            obj.packed.assign(packed.data(), packed.size());
+        });
+        for(const auto& account : accounts){
+            db.create<history::account_object>([&]( auto& obj ){
+                obj.account = account;
+                obj.ordinal = ordinal;
+            });
+        }
+        lock.unlock();
+
+        if( abi_data.is_null() && hot_contracts.count(act.account) ){
+            {
+                boost::mutex::scoped_lock queue_lock(materialize_mtx);
+                materialize_queue.push_back(ordinal);
+            }
+            materialize_cv.notify_one();
+        }
+    }
+
+    void action_history::add_abi( chain::name account, uint64_t ordinal, const chain::bytes& packed_abi ) {
+        if( ordinal == 0 ) return;
+
+        boost::mutex::scoped_lock lock(mtx);
+        const auto& abis = db.get_index<history::abi_index, history::by_account_ordinal>();
+        auto itr = abis.find( boost::make_tuple(account, ordinal) );
+        if( itr != abis.end() ){
+            if( itr->packed.size() == packed_abi.size() && std::equal(packed_abi.begin(), packed_abi.end(), itr->packed.begin()) ) return;
+            db.modify(*itr, [&]( auto& obj ){
+                obj.packed.assign(packed_abi.data(), packed_abi.size());
+            });
+            lock.unlock();
+            boost::mutex::scoped_lock cache_lock(serializer_mtx);
+            serializers.erase( std::make_pair(account, ordinal) );
+            return;
+        }
+        db.create<history::abi_object>([&]( auto& obj ){
+            obj.account = account;
+            obj.ordinal = ordinal;
+            obj.packed.assign(packed_abi.data(), packed_abi.size());
+        });
+    }
+
+    void action_history::end_block( uint32_t block_num ) {
+        boost::mutex::scoped_lock lock(mtx);
+        // the actions a fork block that lost left past the ones of this block
+        const auto& actions = db.get_index<history::action_index, history::by_ordinal>();
+        std::vector<uint64_t> stale;
+        auto end = actions.lower_bound( action_ordinal(block_num + 1, 0) );
+        for(auto itr = actions.lower_bound( action_ordinal(block_num, 0) ); itr != end; ++itr){
+            if( !block_ordinals.count(itr->ordinal) ) stale.push_back(itr->ordinal);
+        }
+        for(auto ordinal : stale) erase(ordinal);
+        block_ordinals.clear();
+    }
+
+    void action_history::erase( uint64_t ordinal ) {
+        if( const auto* obj = db.find<history::action_object, history::by_ordinal>(ordinal) ) db.remove(*obj);
+        if( const auto* obj = db.find<history::decoded_object, history::by_ordinal>(ordinal) ) db.remove(*obj);
+        const auto& listed = db.get_index<history::account_index, history::by_ordinal_account>();
+        auto itr = listed.lower_bound( boost::make_tuple(ordinal) );
+        while( itr != listed.end() && itr->ordinal == ordinal ){
+            const auto& obj = *itr;
+            ++itr;
+            db.remove(obj);
+        }
+    }
+
+    uint64_t action_history::abi_version( chain::name account, uint64_t ordinal ) {
+        boost::mutex::scoped_lock lock(mtx);
+        const auto& abis = db.get_index<history::abi_index, history::by_account_ordinal>();
+        auto itr = abis.upper_bound( boost::make_tuple(account, ordinal) );
+        if( itr == abis.begin() ) return 0;
+        --itr;
+        return itr->account == account ? itr->ordinal : 0;
+    }
+
+    std::shared_ptr<const chain::abi_serializer> action_history::serializer_for( chain::name account, uint64_t version ) {
+        const auto key = std::make_pair(account, version);
+        {
+            boost::mutex::scoped_lock lock(serializer_mtx);
+            auto itr = serializers.find(key);
+            if( itr != serializers.end() ) return itr->second;
+        }
+
+        chain::abi_def abi;
+        std::shared_ptr<const chain::abi_serializer> abis;
+        if( version != 0 ){
+            chain::bytes packed;
+            {
+                boost::mutex::scoped_lock lock(mtx);
+                const auto& index = db.get_index<history::abi_index, history::by_account_ordinal>();
+                auto itr = index.find( boost::make_tuple(account, version) );
+                if( itr != index.end() ) packed.assign(itr->packed.begin(), itr->packed.end());
+            }
+            // an empty abi is a cleared one
+            if( !packed.empty() ){
+                abi = fc::raw::unpack<chain::abi_def>(packed);
+                abis = std::make_shared<chain::abi_serializer>(abi, max_serialization_time);
+            }
+        } else if( account == chain::config::system_account_name ){
+            // the system contract runs with its built in abi until a setabi of its own
+            abis = std::make_shared<chain::abi_serializer>(chain::eosio_contract_abi(abi), max_serialization_time);
+        }
+
+        boost::mutex::scoped_lock lock(serializer_mtx);
+        if( serializers.size() >= serializer_cache_size ) serializers.clear();
+        serializers[key] = abis;
+        return abis;
+    }
+
+    fc::variant action_history::decode_raw( const action_history_record& record ) {
+        try{
+            auto abis = serializer_for( record.act.account, abi_version(record.act.account, record.ordinal) );
+            if( !abis ) return fc::variant();
+            auto type = abis->get_action_type(record.act.name);
+            if( type.empty() ) return fc::variant();
+            return abis->binary_to_variant(type, record.act.data, max_serialization_time);
+        } catch(...) {
+            // data the abi of the time does not describe stays raw
+            return fc::variant();
+        }
+    }
+
+    fc::variant action_history::decode( const action_history_record& record ) {
+        std::string json;
+        {
+            boost::mutex::scoped_lock lock(mtx);
+            const auto& decoded = db.get_index<history::decoded_index, history::by_ordinal>();
+            auto itr = decoded.find(record.ordinal);
+            if( itr != decoded.end() ) json.assign(itr->json.begin(), itr->json.end());
+        }
+        if( !json.empty() ) return fc::json::from_string(json);
+        return decode_raw(record);
+    }
+
+    void action_history::set_hot_contracts( const std::set<chain::name>& contracts ) {
+        if( contracts.empty() || materializer.joinable() ) return;
+        hot_contracts = contracts;
+        materializer = boost::thread([this]{ materialize(); });
+    }
+
+    void action_history::materialize() {
+        while( true ){
+            uint64_t ordinal = 0;
+            {
+                boost::mutex::scoped_lock lock(materialize_mtx);
+                materialize_cv.wait(lock, [&]{ return done || !materialize_queue.empty(); });
+                if( done ) return;
+                ordinal = materialize_queue.front();
+                materialize_queue.pop_front();
+            }
+
+            action_history_record record;
+            std::string packed;
+            {
+                boost::mutex::scoped_lock lock(mtx);
+                const auto* obj = db.find<history::action_object, history::by_ordinal>(ordinal);
+                if( !obj || db.find<history::decoded_object, history::by_ordinal>(ordinal) ) continue;
+                record = unpack(*obj);
+                packed.assign(obj->packed.begin(), obj->packed.end());
+            }
+
+            auto data = decode_raw(record);
+            if( data.is_null() ) continue;
+            auto json = fc::json::to_string(data);
+            auto accounts = touched_accounts(record.act, data);
+
+            boost::mutex::scoped_lock lock(mtx);
+            if( db.find<history::decoded_object, history::by_ordinal>(ordinal) ) continue;
+            // replaced by the action of another fork while it was decoded
+            const auto* obj = db.find<history::action_object, history::by_ordinal>(ordinal);
+            if( !obj || obj->packed.size() != packed.size() || !std::equal(packed.begin(), packed.end(), obj->packed.begin()) ) continue;
+            db.create<history::decoded_object>([&]( auto& obj ){
+                obj.ordinal = ordinal;
+                obj.json.assign(json.data(), json.size());
+            });
+            // the accounts of the data the raw add could not see
+            const auto& listed = db.get_index<history::account_index, history::by_account_ordinal>();
+            for(const auto& account : accounts){
+                if( listed.find( boost::make_tuple(account, ordinal) ) != listed.end() ) continue;
+                db.create<history::account_object>([&]( auto& obj ){
+                    obj.account = account;
+                    obj.ordinal = ordinal;
+                });
+            }
+        }
+    }
+
+    action_history_record action_history::unpack( const history::action_object& obj ) const {
+        return fc::raw::unpack<action_history_record>( obj.packed.data(), obj.packed.size() );
+    }
+
+    std::vector<action_history_record> action_history::account_actions( chain::name account, size_t limit, uint64_t before_ordinal ) {
+        std::vector<action_history_record> records;
+        boost::mutex::scoped_lock lock(mtx);
+
+        const auto& accounts = db.get_index<history::account_index, history::by_account_ordinal>();
+        const auto& actions = db.get_index<history::action_index, history::by_ordinal>();
+
+        auto itr = accounts.lower_bound( boost::make_tuple(account, before_ordinal == 0 ? std::numeric_limits<uint64_t>::max() : before_ordinal) );
+        auto begin = accounts.lower_bound( boost::make_tuple(account, uint64_t(0)) );
+        while( itr != begin && records.size() < limit ){
+            --itr;
+            auto act = actions.find(itr->ordinal);
+            if( act != actions.end() ) records.emplace_back( unpack(*act) );
+        }
+        return records;
+    }
+
+    std::vector<action_history_record> action_history::block_actions( uint32_t first_block, uint32_t last_block, size_t limit ) {
+        std::vector<action_history_record> records;
+        boost::mutex::scoped_lock lock(mtx);
+
+        const auto& actions = db.get_index<history::action_index, history::by_ordinal>();
+        auto itr = actions.lower_bound( action_ordinal(first_block, 0) );
+        for(; itr != actions.end() && ordinal_block_num(itr->ordinal) <= last_block && records.size() < limit; ++itr){
+            records.emplace_back( unpack(*itr) );
+        }
+        return records;
+    }
+
+} // namespace
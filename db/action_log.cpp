@@ -0,0 +1,473 @@
+#include <eosio/sql_db_plugin/action_log.hpp>
+#include <eosio/sql_db_plugin/name_format.hpp>
+
+#include <eosio/chain/asset.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/variant_object.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace bfs = boost::filesystem;
+namespace bip = boost::interprocess;
+
+namespace eosio { namespace action_log {
+
+    void write_varint( std::string& out, uint64_t v ) {
+        while( v >= 0x80 ){
+            out.push_back(char(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(char(v));
+    }
+
+    uint64_t read_varint( const char*& pos, const char* end ) {
+        uint64_t v = 0;
+        for(int shift = 0; pos < end && shift < 64; shift += 7){
+            uint8_t b = uint8_t(*pos++);
+            v |= uint64_t(b & 0x7f) << shift;
+            if( !(b & 0x80) ) return v;
+        }
+        FC_THROW( "truncated varint in action log" );
+    }
+
+    namespace {
+
+        uint64_t zigzag( int64_t v ) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+        int64_t unzigzag( uint64_t v ) { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+
+        void write_tag( std::string& out, value_tag t ) { out.push_back(char(t)); }
+
+        void write_string( std::string& out, const std::string& s ) {
+            write_varint(out, s.size());
+            out += s;
+        }
+
+        std::string read_string( const char*& pos, const char* end ) {
+            auto n = read_varint(pos, end);
+            FC_ASSERT( uint64_t(end - pos) >= n, "truncated string in action log" );
+            std::string s(pos, n);
+            pos += n;
+            return s;
+        }
+
+        // names are lower case [a-z1-5.] up to 13 chars and survive a round trip
+        bool as_name( const std::string& s, chain::name& n ) {
+            if( s.empty() || s.size() > 12 ) return false;
+            return parse_name(s.data(), s.size(), n.value);
+        }
+
+        // "1.0000 EOS" like strings
+        bool as_asset( const std::string& s, chain::asset& a ) {
+            auto space = s.find(' ');
+            if( space == std::string::npos || space == 0 || space + 1 >= s.size() ) return false;
+            if( !(std::isdigit(uint8_t(s[0])) || s[0] == '-') ) return false;
+            try{
+                a = chain::asset::from_string(s);
+                return asset_string(a) == s;
+            } catch(...) {
+                return false;
+            }
+        }
+
+        void put( std::FILE* f, const void* data, size_t size ) {
+            FC_ASSERT( std::fwrite(data, 1, size, f) == size, "action log write failed" );
+        }
+    }
+
+    void encode_value( std::string& out, const fc::variant& v ) {
+        switch( v.get_type() ){
+            case fc::variant::null_type:
+                write_tag(out, value_tag::null);
+                break;
+            case fc::variant::bool_type:
+                write_tag(out, v.as_bool() ? value_tag::true_value : value_tag::false_value);
+                break;
+            case fc::variant::int64_type:
+                write_tag(out, value_tag::int64);
+                write_varint(out, zigzag(v.as_int64()));
+                break;
+            case fc::variant::uint64_type:
+                write_tag(out, value_tag::uint64);
+                write_varint(out, v.as_uint64());
+                break;
+            case fc::variant::double_type: {
+                write_tag(out, value_tag::float64);
+                double d = v.as_double();
+                out.append(reinterpret_cast<const char*>(&d), sizeof(d));
+                break;
+            }
+            case fc::variant::string_type: {
+                const auto& s = v.get_string();
+                chain::name n;
+                chain::asset a;
+                if( as_name(s, n) ){
+                    write_tag(out, value_tag::name);
+                    write_varint(out, n.value);
+                } else if( as_asset(s, a) ){
+                    write_tag(out, value_tag::asset);
+                    write_varint(out, zigzag(a.get_amount()));
+                    write_varint(out, a.get_symbol().value());
+                } else {
+                    write_tag(out, value_tag::string);
+                    write_string(out, s);
+                }
+                break;
+            }
+            case fc::variant::array_type: {
+                const auto& arr = v.get_array();
+                write_tag(out, value_tag::array);
+                write_varint(out, arr.size());
+                for(const auto& e : arr) encode_value(out, e);
+                break;
+            }
+            case fc::variant::object_type: {
+                const auto& obj = v.get_object();
+                write_tag(out, value_tag::object);
+                write_varint(out, obj.size());
+                for(const auto& e : obj){
+                    write_string(out, e.key());
+                    encode_value(out, e.value());
+                }
+                break;
+            }
+            case fc::variant::blob_type: {
+                const auto& blob = v.get_blob();
+                write_tag(out, value_tag::bytes);
+                write_varint(out, blob.data.size());
+                out.append(blob.data.data(), blob.data.size());
+                break;
+            }
+        }
+    }
+
+    fc::variant decode_value( const char*& pos, const char* end ) {
+        FC_ASSERT( pos < end, "truncated value in action log" );
+        auto tag = value_tag(*pos++);
+        switch( tag ){
+            case value_tag::null:        return fc::variant();
+            case value_tag::false_value: return fc::variant(false);
+            case value_tag::true_value:  return fc::variant(true);
+            case value_tag::int64:       return fc::variant(unzigzag(read_varint(pos, end)));
+            case value_tag::uint64:      return fc::variant(read_varint(pos, end));
+            case value_tag::float64: {
+                FC_ASSERT( size_t(end - pos) >= sizeof(double), "truncated double in action log" );
+                double d;
+                std::memcpy(&d, pos, sizeof(d));
+                pos += sizeof(d);
+                return fc::variant(d);
+            }
+            case value_tag::string:      return fc::variant(read_string(pos, end));
+            case value_tag::name:        return fc::variant(name_string(chain::name(read_varint(pos, end))));
+            case value_tag::asset: {
+                auto amount = unzigzag(read_varint(pos, end));
+                auto symbol = chain::symbol(read_varint(pos, end));
+                return fc::variant(asset_string(chain::asset(amount, symbol)));
+            }
+            case value_tag::array: {
+                auto n = read_varint(pos, end);
+                fc::variants arr;
+                arr.reserve(std::min<uint64_t>(n, uint64_t(end - pos)));
+                for(uint64_t i = 0; i < n; i++) arr.emplace_back(decode_value(pos, end));
+                return fc::variant(std::move(arr));
+            }
+            case value_tag::object: {
+                auto n = read_varint(pos, end);
+                fc::mutable_variant_object obj;
+                for(uint64_t i = 0; i < n; i++){
+                    auto key = read_string(pos, end);
+                    obj(std::move(key), decode_value(pos, end));
+                }
+                return fc::variant(std::move(obj));
+            }
+            case value_tag::bytes: {
+                auto n = read_varint(pos, end);
+                FC_ASSERT( uint64_t(end - pos) >= n, "truncated bytes in action log" );
+                fc::blob blob{ std::vector<char>(pos, pos + n) };
+                pos += n;
+                return fc::variant(blob);
+            }
+        }
+        FC_THROW( "unknown value tag ${t} in action log", ("t", int(tag)) );
+    }
+
+    std::string segment_name( uint32_t first_block ) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "actions-%010u", first_block);
+        return buf;
+    }
+
+    chain::transaction_id_type action_view::transaction_id() const {
+        chain::transaction_id_type id;
+        std::memcpy(id.data(), trx_id, 32);
+        return id;
+    }
+
+    fc::variant action_view::data() const {
+        const char* pos = data_begin;
+        return decode_value(pos, data_end);
+    }
+
+    bool block_view::parse_action( const char*& pos, const char* end, action_view& act ) {
+        try{
+            act.trx_index    = uint32_t(read_varint(pos, end));
+            act.action_index = uint32_t(read_varint(pos, end));
+            FC_ASSERT( end - pos >= 32 );
+            act.trx_id = pos;
+            pos += 32;
+            act.account = chain::name(read_varint(pos, end));
+            act.name    = chain::name(read_varint(pos, end));
+            auto auths = read_varint(pos, end);
+            act.authorization.clear();
+            for(uint64_t i = 0; i < auths; i++){
+                chain::permission_level level;
+                level.actor      = chain::name(read_varint(pos, end));
+                level.permission = chain::name(read_varint(pos, end));
+                act.authorization.emplace_back(level);
+            }
+            auto size = read_varint(pos, end);
+            FC_ASSERT( uint64_t(end - pos) >= size );
+            act.data_begin = pos;
+            act.data_end   = pos + size;
+            pos += size;
+            return true;
+        } catch(...) {
+            return false;
+        }
+    }
+
+    writer::writer( const bfs::path& dir, uint64_t segment_bytes ):m_dir(dir),m_segment_bytes(segment_bytes) {
+        bfs::create_directories(dir);
+        open_last_segment();
+    }
+
+    writer::~writer() {
+        if( m_log ) std::fclose(m_log);
+        if( m_index ) std::fclose(m_index);
+    }
+
+    void writer::open_last_segment() {
+        std::vector<uint32_t> firsts;
+        for(bfs::directory_iterator itr(m_dir), end; itr != end; ++itr){
+            auto name = itr->path().filename().string();
+            uint32_t first = 0;
+            if( itr->path().extension() == ".log" && std::sscanf(name.c_str(), "actions-%u.log", &first) == 1 ) firsts.push_back(first);
+        }
+        if( firsts.empty() ) return;
+        m_segment_first = *std::max_element(firsts.begin(), firsts.end());
+
+        auto log_path   = m_dir / (segment_name(m_segment_first) + ".log");
+        auto index_path = m_dir / (segment_name(m_segment_first) + ".index");
+        m_log   = std::fopen(log_path.string().c_str(), "r+b");
+        m_index = std::fopen(index_path.string().c_str(), bfs::exists(index_path) ? "r+b" : "w+b");
+        FC_ASSERT( m_log && m_index, "cannot open action log segment ${s}", ("s", log_path.string()) );
+
+        // keep the blocks written completely, a crash may leave a partial one behind
+        uint64_t log_size = bfs::file_size(log_path);
+        index_entry entry;
+        uint64_t valid_end = sizeof(segment_header);
+        while( std::fread(&entry, sizeof(entry), 1, m_index) == 1 ){
+            block_header header;
+            if( entry.offset + sizeof(header) > log_size ) break;
+            std::fseek(m_log, long(entry.offset), SEEK_SET);
+            if( std::fread(&header, sizeof(header), 1, m_log) != 1 || header.block_num != entry.block_num ) break;
+            if( entry.offset + sizeof(header) + header.size > log_size ) break;
+            m_entries.push_back(entry);
+            valid_end = entry.offset + sizeof(header) + header.size;
+            m_last_block = entry.block_num;
+        }
+
+        std::fflush(m_log);
+        std::fflush(m_index);
+        bfs::resize_file(log_path, valid_end);
+        bfs::resize_file(index_path, m_entries.size() * sizeof(index_entry));
+        m_log_size = valid_end;
+        std::fseek(m_log, long(m_log_size), SEEK_SET);
+        std::fseek(m_index, long(m_entries.size() * sizeof(index_entry)), SEEK_SET);
+
+        if( m_last_block == 0 && m_segment_first > 0 ) m_last_block = m_segment_first - 1;
+        ilog("action log ${s} opened at block ${b}", ("s", log_path.string())("b", m_last_block));
+    }
+
+    void writer::open_segment( uint32_t first_block ) {
+        if( m_log ) std::fclose(m_log);
+        if( m_index ) std::fclose(m_index);
+
+        m_segment_first = first_block;
+        auto base = m_dir / segment_name(first_block);
+        m_log   = std::fopen((base.string() + ".log").c_str(), "w+b");
+        m_index = std::fopen((base.string() + ".index").c_str(), "w+b");
+        FC_ASSERT( m_log && m_index, "cannot create action log segment ${s}", ("s", base.string()) );
+
+        segment_header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, segment_magic, sizeof(header.magic));
+        header.version     = format_version;
+        header.first_block = first_block;
+        put(m_log, &header, sizeof(header));
+        m_log_size = sizeof(header);
+        m_entries.clear();
+    }
+
+    void writer::truncate_to( uint32_t block_num ) {
+        auto itr = std::lower_bound(m_entries.begin(), m_entries.end(), block_num,
+                                    []( const index_entry& e, uint32_t n ){ return e.block_num < n; });
+        if( itr == m_entries.end() ) return;
+
+        uint64_t offset = itr->offset;
+        size_t kept = itr - m_entries.begin();
+        std::fflush(m_log);
+        std::fflush(m_index);
+        auto base = m_dir / segment_name(m_segment_first);
+        bfs::resize_file(base.string() + ".log", offset);
+        bfs::resize_file(base.string() + ".index", kept * sizeof(index_entry));
+        m_entries.resize(kept);
+        m_log_size = offset;
+        std::fseek(m_log, long(offset), SEEK_SET);
+        std::fseek(m_index, long(kept * sizeof(index_entry)), SEEK_SET);
+        m_last_block = kept > 0 ? m_entries.back().block_num : m_segment_first - 1;
+    }
+
+    void writer::begin_block( uint32_t block_num, uint32_t block_time ) {
+        m_in_block = true;
+        m_skip_block = false;
+        m_actions.clear();
+        m_block = block_header{ block_num, block_time, 0, 0 };
+
+        if( m_log && block_num <= m_last_block ){
+            if( block_num >= m_segment_first ){
+                truncate_to(block_num);
+            } else {
+                wlog("action log: block ${b} is in a closed segment, not rewritten", ("b", block_num));
+                m_skip_block = true;
+            }
+        }
+    }
+
+    void writer::add_action( uint32_t trx_index, uint32_t action_index, const chain::transaction_id_type& trx_id,
+                             const chain::action& act, const fc::variant* decoded ) {
+        if( !m_in_block || m_skip_block ) return;
+
+        write_varint(m_actions, trx_index);
+        write_varint(m_actions, action_index);
+        m_actions.append(trx_id.data(), 32);
+        write_varint(m_actions, act.account.value);
+        write_varint(m_actions, act.name.value);
+        write_varint(m_actions, act.authorization.size());
+        for(const auto& auth : act.authorization){
+            write_varint(m_actions, auth.actor.value);
+            write_varint(m_actions, auth.permission.value);
+        }
+
+        std::string value;
+        if( decoded ) {
+            encode_value(value, *decoded);
+        } else {
+            // no ABI, the raw bytes
+            write_tag(value, value_tag::bytes);
+            write_varint(value, act.data.size());
+            value.append(act.data.data(), act.data.size());
+        }
+        write_varint(m_actions, value.size());
+        m_actions += value;
+        m_block.action_count++;
+    }
+
+    void writer::end_block() {
+        if( !m_in_block ) return;
+        m_in_block = false;
+        if( m_skip_block ) return;
+
+        if( !m_log || m_log_size >= m_segment_bytes ) open_segment(m_block.block_num);
+
+        m_block.size = uint32_t(m_actions.size());
+        index_entry entry{ m_block.block_num, 0, m_log_size };
+        put(m_log, &m_block, sizeof(m_block));
+        put(m_log, m_actions.data(), m_actions.size());
+        put(m_index, &entry, sizeof(entry));
+
+        m_log_size += sizeof(m_block) + m_actions.size();
+        m_entries.push_back(entry);
+        m_last_block = m_block.block_num;
+    }
+
+    void writer::flush() {
+        // the log first, an index entry never points past the data on disk
+        if( m_log ) std::fflush(m_log);
+        if( m_index ) std::fflush(m_index);
+    }
+
+    reader::segment::segment( const bfs::path& log, const bfs::path& index )
+    :log_file(log.string().c_str(), bip::read_only)
+    ,log_region(log_file, bip::read_only)
+    ,index_file(index.string().c_str(), bip::read_only)
+    ,index_region(index_file, bip::read_only) {
+        FC_ASSERT( log_region.get_size() >= sizeof(segment_header) &&
+                   std::memcmp(log_region.get_address(), segment_magic, sizeof(segment_magic)) == 0,
+                   "${f} is not an action log segment", ("f", log.string()) );
+    }
+
+    bool reader::segment::block( const index_entry& entry, block_view& block ) const {
+        const char* base = static_cast<const char*>(log_region.get_address());
+        size_t size = log_region.get_size();
+        if( entry.offset + sizeof(block_header) > size ) return false;
+
+        block_header header;
+        std::memcpy(&header, base + entry.offset, sizeof(header));
+        if( header.block_num != entry.block_num || entry.offset + sizeof(header) + header.size > size ) return false;
+
+        block.block_num    = header.block_num;
+        block.block_time   = header.block_time;
+        block.action_count = header.action_count;
+        block.begin        = base + entry.offset + sizeof(header);
+        block.end          = block.begin + header.size;
+        return true;
+    }
+
+    reader::reader( const bfs::path& dir ) {
+        std::vector<uint32_t> firsts;
+        for(bfs::directory_iterator itr(dir), end; itr != end; ++itr){
+            auto name = itr->path().filename().string();
+            uint32_t first = 0;
+            if( itr->path().extension() == ".log" && std::sscanf(name.c_str(), "actions-%u.log", &first) == 1 ) firsts.push_back(first);
+        }
+        std::sort(firsts.begin(), firsts.end());
+
+        for(auto first : firsts){
+            auto base = dir / segment_name(first);
+            bfs::path log = base.string() + ".log", index = base.string() + ".index";
+            // an empty index can not be mapped, the segment has no complete block yet
+            if( !bfs::exists(index) || bfs::file_size(index) < sizeof(index_entry) ) continue;
+            m_segments.emplace_back( std::make_unique<segment>(log, index) );
+        }
+    }
+
+    uint32_t reader::first_block() const {
+        for(const auto& s : m_segments){
+            if( s->entry_count() > 0 ) return s->entries()[0].block_num;
+        }
+        return 0;
+    }
+
+    uint32_t reader::last_block() const {
+        for(auto itr = m_segments.rbegin(); itr != m_segments.rend(); ++itr){
+            if( (*itr)->entry_count() > 0 ) return (*itr)->entries()[(*itr)->entry_count() - 1].block_num;
+        }
+        return 0;
+    }
+
+    bool reader::find_block( uint32_t block_num, block_view& block ) const {
+        for(const auto& s : m_segments){
+            auto begin = s->entries(), end = s->entries() + s->entry_count();
+            auto itr = std::lower_bound(begin, end, block_num, []( const index_entry& e, uint32_t n ){ return e.block_num < n; });
+            if( itr != end && itr->block_num == block_num ) return s->block(*itr, block);
+        }
+        return false;
+    }
+
+} } // namespace
@@ -1,22 +1,31 @@
 // #include "actions_table.hpp"
 #include <eosio/sql_db_plugin/actions_table.hpp>
+#include <eosio/sql_db_plugin/metrics.hpp>
+#include <eosio/sql_db_plugin/name_format.hpp>
+#include <eosio/sql_db_plugin/sql_profiler.hpp>
 #include <cmath>
 #include <chrono>
 
 namespace eosio {
 
-    bool actions_table::add( std::shared_ptr<soci::session> m_session, chain::action action, chain::transaction_id_type transaction_id, chain::block_timestamp_type block_time, std::vector<std::string> filter_out ) {
+    bool actions_table::add( const std::shared_ptr<soci::session>& m_session, const chain::action& action, const chain::transaction_id_type& transaction_id, chain::block_timestamp_type block_time, uint32_t block_num, const std::vector<std::string>& filter_out, uint64_t ordinal, uint32_t trx_index, uint32_t action_index ) {
 
-        chain::abi_def abi;
-        std::string abi_def_account;
-        chain::abi_serializer abis;
-        soci::indicator ind;
         const auto transaction_id_str = transaction_id.str();
         const auto timestamp = std::chrono::seconds{block_time.operator fc::time_point().sec_since_epoch()}.count();
 
-        string json = add_data( m_session, action );
-        system_contract_arg dataJson = fc::json::from_string(json).as<system_contract_arg>();
-        string json_auth = fc::json::to_string(action.authorization);
+        metrics().count_action( action.account, action.name );
+
+        // the abi of a setabi is stored before the action is parsed, other actions only
+        // needed add_data for the actions insert below
+        if( action.account == chain::config::system_account_name && action.name == setabi ){
+            add_data( m_session, action );
+            try{
+                auto set = action.data_as<chain::setabi>();
+                invalidate_abi( set.account );
+                if( m_history ) m_history->add_abi( set.account, ordinal, set.abi );
+            } catch(...) {
+            }
+        }
 
         /*
         try{
@@ -42,7 +51,7 @@ namespace eosio {
         }*/
 
         try {
-            auto is_success = parse_actions( m_session, action , transaction_id_str,timestamp);
+            auto is_success = parse_actions( m_session, action , transaction_id_str,timestamp, block_num, ordinal, trx_index, action_index);
             return is_success;
         }  catch(fc::exception& e) {
             wlog("fc exception: ${e}",("e",e.what()));
@@ -57,65 +66,169 @@ namespace eosio {
         return false;
     }
 
-    bool actions_table::parse_actions( std::shared_ptr<soci::session> m_session, chain::action action,const std::string & transaction_id ,const long long timestamp) {
+    void actions_table::write_event( soci::session& sql, const event_row& row ) {
+        if( !m_strands ){
+            m_sink->write_event(sql, row);
+            if( m_changes ) m_changes->publish(row, row.block_num);
+            return;
+        }
+        // published once written, the strand logs a failed write
+        m_strands->post( row.table, [this,row]( soci::session& strand_sql ){
+            m_sink->write_event(strand_sql, row);
+            if( m_changes ) m_changes->publish(row, row.block_num);
+        });
+    }
 
-        chain::abi_def abi;
-        std::string abi_def_account;
-        chain::abi_serializer abis;
+    void actions_table::write( soci::session& sql, const std::string& table, const table_strands::task& f ) {
+        if( m_strands ) m_strands->post( table, f );
+        else f( sql );
+    }
+
+    void actions_table::remove_events( soci::session& sql, uint32_t block_num, uint64_t from_ordinal ) {
+        for(const char* table : event_tables){
+            write( sql, table, [this,table,block_num,from_ordinal]( soci::session& s ){
+                m_sink->remove_events( s, table, block_num, from_ordinal );
+            });
+        }
+    }
+
+    std::shared_ptr<const contract_abi> actions_table::abi_for( soci::session& sql, chain::name account ) {
+        {
+            boost::mutex::scoped_lock lock(m_abi_mtx);
+            auto itr = m_abi_cache.find(account);
+            if( itr != m_abi_cache.end() ) return itr->second;
+        }
+
+        // a setabi still queued on the accounts strand would be read as the old abi
+        if( m_strands ) m_strands->wait("accounts");
+
+        std::string abi_json;
         soci::indicator ind;
+        statement_timer stmt(sql, "SELECT abi FROM accounts WHERE name = :name");
+        sql << stmt.sql(), soci::into(abi_json, ind), soci::use(interned_name(account));
+        stmt.done();
+
+        chain::abi_def abi;
+        std::shared_ptr<const contract_abi> abis;
+        if( ind == soci::i_ok && !abi_json.empty() ){
+            abi = fc::json::from_string(m_codec->decode(abi_json)).as<chain::abi_def>();
+            abis = std::make_shared<contract_abi>(abi, max_serialization_time);
+        } else if( account == chain::config::system_account_name ){
+            abis = std::make_shared<contract_abi>(chain::eosio_contract_abi(abi), max_serialization_time);
+        }
+
+        // accounts without an abi are cached too, a setabi drops the entry
+        boost::mutex::scoped_lock lock(m_abi_mtx);
+        if( m_abi_cache.size() >= abi_cache_size ) m_abi_cache.clear();
+        m_abi_cache[account] = abis;
+        return abis;
+    }
+
+    const std::string& actions_table::json_field( const contract_abi& abis, const chain::action& action, const std::string& field, const fc::variant& abi_data ) {
+        // straight from the action data, the decoded variant only when the writer can not.
+        // the buffer is reused by every action of the thread
+        thread_local json_writer out;
+        out.clear();
+        if( !abis.json.write_field( action.name, action.data.data(), action.data.size(), field, out ) ){
+            out.clear();
+            out.variant( abi_data[field] );
+        }
+        return out.str();
+    }
+
+    void actions_table::invalidate_abi( chain::name account ) {
+        boost::mutex::scoped_lock lock(m_abi_mtx);
+        m_abi_cache.erase(account);
+    }
+
+    bool actions_table::parse_actions( const std::shared_ptr<soci::session>& m_session, const chain::action& action,const std::string & transaction_id ,const long long timestamp, uint32_t block_num, uint64_t ordinal, uint32_t trx_index, uint32_t action_index) {
+
+        // the actions no table needs are stored as they are, the history decodes them on read
+        if( m_raw_actions && !indexed(action) ){
+            if( m_history ) m_history->add( action, fc::variant(), block_num, ordinal, timestamp, chain::transaction_id_type(transaction_id) );
+            if( m_action_log && ordinal ) m_action_log->add_action( trx_index, action_index, chain::transaction_id_type(transaction_id), action, nullptr );
+            return true;
+        }
+
+        std::shared_ptr<const contract_abi> abis;
         fc::variant abi_data;
 
-        *m_session << "SELECT abi FROM accounts WHERE name = :name", soci::into(abi_def_account, ind), soci::use(action.account.to_string());
+        {
+            scoped_timer timer( metrics().stage(ingest_stage::abi_resolve) );
+            abis = abi_for( *m_session, action.account );
+            if( !abis ) {
+                if( m_history ) m_history->add( action, fc::variant(), block_num, ordinal, timestamp, chain::transaction_id_type(transaction_id) );
+                if( m_action_log && ordinal ) m_action_log->add_action( trx_index, action_index, chain::transaction_id_type(transaction_id), action, nullptr );
+                return false; // no ABI no party. Should we still store it?
+            }
+        }
 
-        if (!abi_def_account.empty()) {
-            abi = fc::json::from_string(abi_def_account).as<chain::abi_def>();
-        } else if (action.account == chain::config::system_account_name) {
-            abi = chain::eosio_contract_abi(abi);
-        } else {
-            return false; // no ABI no party. Should we still store it?
+        {
+            scoped_timer timer( metrics().stage(ingest_stage::decode) );
+            abi_data = abis->serializer.binary_to_variant(abis->serializer.get_action_type(action.name), action.data, max_serialization_time);
         }
+        mark_dirty( action, abi_data );
+        if( m_history ) m_history->add( action, abi_data, block_num, ordinal, timestamp, chain::transaction_id_type(transaction_id) );
+        if( m_action_log && ordinal ) m_action_log->add_action( trx_index, action_index, chain::transaction_id_type(transaction_id), action, &abi_data );
 
-        abis.set_abi(abi, max_serialization_time);
-        abi_data = abis.binary_to_variant(abis.get_action_type(action.name), action.data, max_serialization_time);
+        scoped_timer sql_timer( metrics().stage(ingest_stage::sql_execute) );
 
         if(action.account == chain::config::system_account_name) {
 
             if( action.name == newaccount ){
                 auto action_data = action.data_as<chain::newaccount>();
-                *m_session << "INSERT INTO accounts (name) VALUES (:name)",
-                        soci::use(action_data.name.to_string());
-
-                for (const auto& key_owner : action_data.owner.keys) {
-                    string permission_owner = "owner";
-                    string public_key_owner = static_cast<string>(key_owner.key);
-                    *m_session << "INSERT INTO accounts_keys(account, public_key, permission) VALUES (:ac, :ke, :pe) ",
-                            soci::use(action_data.name.to_string()),
-                            soci::use(public_key_owner),
-                            soci::use(permission_owner);
-                }
+                // the keys go with the account, both tables are on the accounts strand
+                // a replayed newaccount finds its rows there already
+                const std::string insert_account = "INSERT INTO accounts (name) VALUES (:name)" + m_sink->ignore_duplicate("name");
+                const std::string insert_key = "INSERT INTO accounts_keys(account, public_key, permission) VALUES (:ac, :ke, :pe)"
+                                             + m_sink->ignore_duplicate("account,permission,public_key");
+                write( *m_session, "accounts", [action_data,insert_account,insert_key]( soci::session& sql ){
+                    statement_timer stmt(sql, insert_account);
+                    sql << stmt.sql(),
+                            soci::use(name_string(action_data.name));
+                    stmt.done();
+                    metrics().count_table("accounts");
+
+                    for (const auto& key_owner : action_data.owner.keys) {
+                        string permission_owner = "owner";
+                        string public_key_owner = static_cast<string>(key_owner.key);
+                        statement_timer stmt(sql, insert_key);
+                        sql << stmt.sql(),
+                                soci::use(name_string(action_data.name)),
+                                soci::use(public_key_owner),
+                                soci::use(permission_owner);
+                        stmt.done();
+                        metrics().count_table("accounts_keys");
+                    }
 
-                for (const auto& key_active : action_data.active.keys) {
-                    string permission_active = "active";
-                    string public_key_active = static_cast<string>(key_active.key);
-                    *m_session << "INSERT INTO accounts_keys(account, public_key, permission) VALUES (:ac, :ke, :pe) ",
-                            soci::use(action_data.name.to_string()),
-                            soci::use(public_key_active),
-                            soci::use(permission_active);
-                }
+                    for (const auto& key_active : action_data.active.keys) {
+                        string permission_active = "active";
+                        string public_key_active = static_cast<string>(key_active.key);
+                        statement_timer stmt(sql, insert_key);
+                        sql << stmt.sql(),
+                                soci::use(name_string(action_data.name)),
+                                soci::use(public_key_active),
+                                soci::use(permission_active);
+                        stmt.done();
+                        metrics().count_table("accounts_keys");
+                    }
+                });
                 return true;
             }else if( action.name == N(voteproducer) ){
 
-                auto voter = abi_data["voter"].as<chain::name>().to_string();
-                auto proxy = abi_data["proxy"].as<chain::name>().to_string();
-                auto producers = fc::json::to_string( abi_data["producers"] );
+                auto voter = abi_data["voter"].as<chain::name>();
+                auto proxy = abi_data["proxy"].as<chain::name>();
+                const auto& producers = json_field( *abis, action, "producers", abi_data );
 
                 try{
-                    *m_session << "INSERT INTO votes ( voter, proxy, producers,tran_id,block_time)  VALUES( :vo, :pro, :pd,:tran_id,FROM_UNIXTIME(:bt)) ",
-                            soci::use(voter),
-                            soci::use(proxy),
-                            soci::use(producers),
-                            soci::use(transaction_id),
-                            soci::use(timestamp);
+                    write_event(*m_session, event_row("votes")
+                            .name("voter", voter)
+                            .name("proxy", proxy)
+                            .text("producers", m_codec->encode(producers))
+                            .checksum("tran_id", transaction_id)
+                            .time("block_time", timestamp)
+                            .key(block_num, ordinal));
+                    metrics().count_table("votes");
                 } catch(soci::mysql_soci_error e) {
                     wlog("soci::error: ${e}",("e",e.what()) );
                 } catch(std::exception e) {
@@ -127,17 +240,19 @@ namespace eosio {
                 return true;
             } else if( action.name == N(buyram) ){
 
-                auto payer = abi_data["payer"].as<chain::name>().to_string();
-                auto receiver = abi_data["receiver"].as<chain::name>().to_string();
+                auto payer = abi_data["payer"].as<chain::name>();
+                auto receiver = abi_data["receiver"].as<chain::name>();
                 auto quant = abi_data["quant"].as_string();
 
                 try{
-                    *m_session << "INSERT INTO buyram (payer,receiver,quant ,tran_id,block_time)  VALUES( :payer, :receiver, :quant,:tran_id ,FROM_UNIXTIME(:bt)) ",
-                            soci::use(payer),
-                            soci::use(receiver),
-                            soci::use(quant),
-                            soci::use(transaction_id),
-                            soci::use(timestamp);
+                    write_event(*m_session, event_row("buyram")
+                            .name("payer", payer)
+                            .name("receiver", receiver)
+                            .text("quant", quant)
+                            .checksum("tran_id", transaction_id)
+                            .time("block_time", timestamp)
+                            .key(block_num, ordinal));
+                    metrics().count_table("buyram");
 
                 } catch(soci::mysql_soci_error e) {
                     wlog("soci::error: ${e}",("e",e.what()) );
@@ -151,15 +266,17 @@ namespace eosio {
                 return true;
 
             } else if ( action.name == N(sellram) ){
-                auto account = abi_data["account"].as<chain::name>().to_string();
+                auto account = abi_data["account"].as<chain::name>();
                 auto bytes   = abi_data["bytes"].as_int64();
 
                 try{
-                    *m_session << "INSERT INTO sellram (account,bytes ,tran_id,block_time)  VALUES( :account, :bytes,:tran_id ,FROM_UNIXTIME(:bt) ) ",
-                            soci::use(account),
-                            soci::use(bytes),
-                            soci::use(transaction_id),
-                            soci::use(timestamp);
+                    write_event(*m_session, event_row("sellram")
+                            .name("account", account)
+                            .integer("bytes", bytes)
+                            .checksum("tran_id", transaction_id)
+                            .time("block_time", timestamp)
+                            .key(block_num, ordinal));
+                    metrics().count_table("sellram");
 
                 } catch(soci::mysql_soci_error e) {
                     wlog("soci::error: ${e}",("e",e.what()) );
@@ -172,19 +289,21 @@ namespace eosio {
                 return true;
             } else if (action.name == N(delegatebw) ){
             
-                auto from = abi_data["from"].as<chain::name>().to_string();
-                auto receiver = abi_data["receiver"].as<chain::name>().to_string();
+                auto from = abi_data["from"].as<chain::name>();
+                auto receiver = abi_data["receiver"].as<chain::name>();
                 auto stake_net_quantity = abi_data["stake_net_quantity"].as_string();
                 auto stake_cpu_quantity = abi_data["stake_cpu_quantity"].as_string();
 
                 try{
-                    *m_session << "INSERT INTO delegatebw (frm_acc,receiver ,stake_net_quantity,stake_cpu_quantity,tran_id,block_time)  VALUES( :from, :receiver , :stake_net_quantity , :stake_cpu_quantity , :tran_id ,FROM_UNIXTIME(:bt) ) ",
-                            soci::use(from),
-                            soci::use(receiver),
-                            soci::use(stake_net_quantity),
-                            soci::use(stake_cpu_quantity),
-                            soci::use(transaction_id),
-                            soci::use(timestamp);
+                    write_event(*m_session, event_row("delegatebw")
+                            .name("frm_acc", from)
+                            .name("receiver", receiver)
+                            .text("stake_net_quantity", stake_net_quantity)
+                            .text("stake_cpu_quantity", stake_cpu_quantity)
+                            .checksum("tran_id", transaction_id)
+                            .time("block_time", timestamp)
+                            .key(block_num, ordinal));
+                    metrics().count_table("delegatebw");
 
                 } catch(soci::mysql_soci_error e) {
                     wlog("soci::error: ${e}",("e",e.what()) );
@@ -197,19 +316,21 @@ namespace eosio {
                 return true;
             } else if (action.name == N(undelegatebw) ){
 
-                auto from = abi_data["from"].as<chain::name>().to_string();
-                auto receiver = abi_data["receiver"].as<chain::name>().to_string();
+                auto from = abi_data["from"].as<chain::name>();
+                auto receiver = abi_data["receiver"].as<chain::name>();
                 auto unstake_net_quantity = abi_data["unstake_net_quantity"].as_string();
                 auto unstake_cpu_quantity = abi_data["unstake_cpu_quantity"].as_string();
 
                 try{
-                    *m_session << "INSERT INTO undelegatebw (frm_acc,receiver ,unstake_net_quantity,unstake_cpu_quantity,tran_id,block_time)  VALUES( :from, :receiver, :unstake_net_quantity , :unstake_cpu_quantity , :tran_id ,FROM_UNIXTIME(:bt) ) ",
-                            soci::use(from),
-                            soci::use(receiver),
-                            soci::use(unstake_net_quantity),
-                            soci::use(unstake_cpu_quantity),
-                            soci::use(transaction_id),
-                            soci::use(timestamp);
+                    write_event(*m_session, event_row("undelegatebw")
+                            .name("frm_acc", from)
+                            .name("receiver", receiver)
+                            .text("unstake_net_quantity", unstake_net_quantity)
+                            .text("unstake_cpu_quantity", unstake_cpu_quantity)
+                            .checksum("tran_id", transaction_id)
+                            .time("block_time", timestamp)
+                            .key(block_num, ordinal));
+                    metrics().count_table("undelegatebw");
 
                 } catch(soci::mysql_soci_error e) {
                     wlog("soci::error: ${e}",("e",e.what()) );
@@ -221,17 +342,19 @@ namespace eosio {
                 }                  
                 return true;
             } else if (action.name == N(regproducer) ){
-                auto producer = abi_data["producer"].as<chain::name>().to_string();
+                auto producer = abi_data["producer"].as<chain::name>();
                 auto producer_key   = abi_data["producer_key"].as_string();
                 auto url  = abi_data["url"].as_string();
 
                 try{
-                    *m_session << "INSERT INTO regproducer (producer,producer_key ,url,tran_id,block_time)  VALUES( :producer, :producer_key, :url, :tran_id ,FROM_UNIXTIME(:bt)) ",
-                            soci::use(producer),
-                            soci::use(producer_key),
-                            soci::use(url),
-                            soci::use(transaction_id),
-                            soci::use(timestamp);
+                    write_event(*m_session, event_row("regproducer")
+                            .name("producer", producer)
+                            .text("producer_key", producer_key)
+                            .text("url", url)
+                            .checksum("tran_id", transaction_id)
+                            .time("block_time", timestamp)
+                            .key(block_num, ordinal));
+                    metrics().count_table("regproducer");
 
                 } catch(soci::mysql_soci_error e) {
                     wlog("soci::error: ${e}",("e",e.what()) );
@@ -246,19 +369,21 @@ namespace eosio {
         } else if( action.account == N(eosio.token) ){
             
             if (action.name == N(transfer) ){
-                auto from = abi_data["from"].as<chain::name>().to_string();
-                auto to = abi_data["to"].as<chain::name>().to_string();
+                auto from = abi_data["from"].as<chain::name>();
+                auto to = abi_data["to"].as<chain::name>();
                 auto quantity = abi_data["quantity"].as_string();
                 auto memo = abi_data["memo"].as_string();
 
                 try{
-                    *m_session << "INSERT INTO transfer (frm_acc,to_acc ,quantity,memo,tran_id,block_time)  VALUES( :from, :to,:quantity,:memo,:tran_id ,FROM_UNIXTIME(:bt)) ",
-                            soci::use(from),
-                            soci::use(to),
-                            soci::use(quantity),
-                            soci::use(memo),
-                            soci::use(transaction_id),
-                            soci::use(timestamp);
+                    write_event(*m_session, event_row("transfer")
+                            .name("frm_acc", from)
+                            .name("to_acc", to)
+                            .text("quantity", quantity)
+                            .text("memo", memo)
+                            .checksum("tran_id", transaction_id)
+                            .time("block_time", timestamp)
+                            .key(block_num, ordinal));
+                    metrics().count_table("transfer");
 
                 } catch(soci::mysql_soci_error e) {
                     wlog("soci::error: ${e}",("e",e.what()) );
@@ -274,44 +399,52 @@ namespace eosio {
         } else if( action.account == N(eosio.msig) ) {
             ilog("hi");
             if( action.name == N(propose) ){
-                auto proposer = abi_data["proposer"].as<chain::name>().to_string();
-                auto proposal_name = abi_data["proposal_name"].as<chain::name>().to_string();
-                auto requested = fc::json::to_string(abi_data["requested"]);//abi_data["requested"].as< vector<chain::permission_level> >();
+                auto proposer = name_string(abi_data["proposer"].as<chain::name>());
+                auto proposal_name = name_string(abi_data["proposal_name"].as<chain::name>());
+                const auto& requested = json_field( *abis, action, "requested", abi_data );
 
                 ilog("${pro} ${pro_name} ${request}",("pro",proposer)("pro_name",proposal_name)("request",requested));
-                try{
-                    *m_session << "INSERT INTO proposal ( proposer, proposal_name, requested_approvals )  VALUES( :pro, :proname, :req ) "
-                            "on  DUPLICATE key UPDATE proposer = :pro, proposal_name =  :proname, requested_approvals =  :req ",
-                            soci::use(proposer),
-                            soci::use(proposal_name),
-                            soci::use(requested),
-                            soci::use(proposer),
-                            soci::use(proposal_name),
-                            soci::use(requested);
-                } catch(soci::mysql_soci_error e) {
-                    wlog("soci::error: ${e}",("e",e.what()) );
-                } catch(std::exception e) {
-                    wlog( "${e}",("e",e.what()) );
-                } catch(...) {
-                    wlog("${pro} ${pro_name} ${request}",("pro",proposer)("pro_name",proposal_name)("request",requested));
-                }
+                write( *m_session, "proposal", [this,proposer,proposal_name,requested]( soci::session& sql ){
+                    try{
+                        const std::string insert = "INSERT INTO proposal ( proposer, proposal_name, requested_approvals )  VALUES( :pro, :proname, :req ) "
+                                + m_sink->upsert("proposer,proposal_name", {"requested_approvals"});
+                        statement_timer stmt(sql, insert);
+                        sql << stmt.sql(),
+                                soci::use(proposer),
+                                soci::use(proposal_name),
+                                soci::use(requested);
+                        stmt.done();
+                        metrics().count_table("proposal");
+                    } catch(soci::mysql_soci_error e) {
+                        wlog("soci::error: ${e}",("e",e.what()) );
+                    } catch(std::exception e) {
+                        wlog( "${e}",("e",e.what()) );
+                    } catch(...) {
+                        wlog("${pro} ${pro_name} ${request}",("pro",proposer)("pro_name",proposal_name)("request",requested));
+                    }
+                });
                 return true;
             } else if( action.name == N(cancel) || action.name == N(exec) ) {
-                auto proposer = abi_data["proposer"].as<chain::name>().to_string();
-                auto proposal_name = abi_data["proposal_name"].as<chain::name>().to_string();
+                auto proposer = name_string(abi_data["proposer"].as<chain::name>());
+                auto proposal_name = name_string(abi_data["proposal_name"].as<chain::name>());
 
                 ilog("${pro} ${pro_name}",("pro",proposer)("pro_name",proposal_name));
-                try{
-                    *m_session << "DELETE FROM proposal WHERE proposer = :pro and proposal_name = :proname ",
-                            soci::use(proposer),
-                            soci::use(proposal_name);
-                } catch(soci::mysql_soci_error e) {
-                    wlog("soci::error: ${e}",("e",e.what()) );
-                } catch(std::exception e) {
-                    wlog( "${e}",("e",e.what()) );
-                } catch(...) {
-                    wlog("${pro} ${pro_name}",("pro",proposer)("pro_name",proposal_name));
-                }
+                write( *m_session, "proposal", [proposer,proposal_name]( soci::session& sql ){
+                    try{
+                        statement_timer stmt(sql, "DELETE FROM proposal WHERE proposer = :pro and proposal_name = :proname ");
+                        sql << stmt.sql(),
+                                soci::use(proposer),
+                                soci::use(proposal_name);
+                        stmt.done();
+                        metrics().count_table("proposal");
+                    } catch(soci::mysql_soci_error e) {
+                        wlog("soci::error: ${e}",("e",e.what()) );
+                    } catch(std::exception e) {
+                        wlog( "${e}",("e",e.what()) );
+                    } catch(...) {
+                        wlog("${pro} ${pro_name}",("pro",proposer)("pro_name",proposal_name));
+                    }
+                });
                 return true;
 
             }
@@ -320,35 +453,39 @@ namespace eosio {
 
             if( action.name == N(create) ){
 
-                auto issuer = abi_data["issuer"].as<chain::name>().to_string();
+                auto issuer = name_string(abi_data["issuer"].as<chain::name>());
                 auto maximum_supply = abi_data["maximum_supply"].as<chain::asset>();
 
                 if(issuer.empty() || maximum_supply.get_amount() <= 0){
                     return false;
                 }
 
-                string insertassets;
-                try{
-                    insertassets = "INSERT INTO assets(supply, max_supply, symbol_precision, symbol,  issuer, contract_owner) VALUES( :am, :mam, :pre, :sym, :issuer, :owner) ON DUPLICATE KEY UPDATE supply=:am, max_supply=:mam,symbol_precision=:pre,issuer=:issuer";
-                    *m_session << insertassets,
-                            soci::use( 0 ),
-                            soci::use( maximum_supply.get_amount() ),
-                            soci::use( maximum_supply.decimals() ),
-                            soci::use( maximum_supply.get_symbol().name() ),
-                            soci::use( issuer ),
-                            soci::use( action.account.to_string() ),
-                            soci::use( 0 ),
-                            soci::use( maximum_supply.get_amount() ),
-                            soci::use( maximum_supply.decimals() ),
-                            soci::use( issuer );
-                } catch(soci::mysql_soci_error e) {
-                    wlog("soci::error: ${e}",("e",e.what()) );
-                } catch(std::exception e) {
-                    wlog("${e}",("e",e.what()));
-                } catch (...) {
-                    wlog("${sql}",("sql",insertassets) );
-                    wlog( "create asset failed. ${issuer} ${maximum_supply}",("issuer",issuer)("maximum_supply",maximum_supply) );
-                }
+                const auto contract_owner = interned_name(action.account);
+                write( *m_session, "assets", [this,issuer,maximum_supply,contract_owner]( soci::session& sql ){
+                    string insertassets;
+                    try{
+                        insertassets = "INSERT INTO assets(supply, max_supply, symbol_precision, symbol,  issuer, contract_owner) VALUES( :am, :mam, :pre, :sym, :issuer, :owner)"
+                                + m_sink->upsert("symbol,contract_owner", {"supply", "max_supply", "symbol_precision", "issuer"});
+                        statement_timer stmt(sql, insertassets);
+                        sql << stmt.sql(),
+                                soci::use( 0 ),
+                                soci::use( maximum_supply.get_amount() ),
+                                soci::use( maximum_supply.decimals() ),
+                                soci::use( maximum_supply.get_symbol().name() ),
+                                soci::use( issuer ),
+                                soci::use( contract_owner );
+                        stmt.done();
+                        metrics().count_table("assets");
+                        m_assets_changed = true;
+                    } catch(soci::mysql_soci_error e) {
+                        wlog("soci::error: ${e}",("e",e.what()) );
+                    } catch(std::exception e) {
+                        wlog("${e}",("e",e.what()));
+                    } catch (...) {
+                        wlog("${sql}",("sql",insertassets) );
+                        wlog( "create asset failed. ${issuer} ${maximum_supply}",("issuer",issuer)("maximum_supply",maximum_supply) );
+                    }
+                });
                 return true;
             }
         }
@@ -356,7 +493,7 @@ namespace eosio {
     }
 
 
-    string actions_table::add_data(std::shared_ptr<soci::session> m_session, chain::action action){
+    string actions_table::add_data(const std::shared_ptr<soci::session>& m_session, const chain::action& action){
         string json_str = "{}";
 
         if(action.data.size() ==0 ){
@@ -373,15 +510,22 @@ namespace eosio {
                         const chain::abi_def& abi_def = fc::raw::unpack<chain::abi_def>(setabi.abi);
                         json_str = fc::json::to_string( abi_def );
 
-                        try{
-                            *m_session << "INSERT INTO accounts ( name, abi )  VALUES( :name, :abi ) on  DUPLICATE key UPDATE abi = :abi, updated_at =  NOW() "
-                                ,soci::use(setabi.account.to_string()),soci::use(json_str),soci::use(json_str);
-                            // ilog("update abi ${n}",("n",action.account.to_string()));
-                        } catch(soci::mysql_soci_error e) {
-                            wlog("soci::error: ${e}",("e",e.what()) );
-                        }catch(...){
-                            wlog("insert account abi failed");
-                        }
+                        const auto account = setabi.account.to_string();
+                        const auto stored = m_codec->encode(json_str);
+                        write( *m_session, "accounts", [this,account,stored]( soci::session& sql ){
+                            try{
+                                const std::string insert = "INSERT INTO accounts ( name, abi )  VALUES( :name, :abi )" + m_sink->upsert("name", {"abi", "updated_at=NOW()"});
+                                statement_timer stmt(sql, insert);
+                                sql << stmt.sql(),soci::use(account),soci::use(stored);
+                                stmt.done();
+                                metrics().count_table("accounts");
+                                // ilog("update abi ${n}",("n",action.account.to_string()));
+                            } catch(soci::mysql_soci_error e) {
+                                wlog("soci::error: ${e}",("e",e.what()) );
+                            }catch(...){
+                                wlog("insert account abi failed");
+                            }
+                        });
 
                         return json_str;
                     }catch(fc::exception& e){
@@ -395,11 +539,13 @@ namespace eosio {
             chain::abi_serializer abis;
             soci::indicator ind;
             //get account abi
-            *m_session << "SELECT abi FROM accounts WHERE name = :name", soci::into(abi_def_account, ind), soci::use(action.account.to_string());
+            statement_timer stmt(*m_session, "SELECT abi FROM accounts WHERE name = :name");
+            *m_session << stmt.sql(), soci::into(abi_def_account, ind), soci::use(action.account.to_string());
+            stmt.done();
 
             if(!abi_def_account.empty()){
                 try {
-                    abi = fc::json::from_string(abi_def_account).as<chain::abi_def>();
+                    abi = fc::json::from_string(m_codec->decode(abi_def_account)).as<chain::abi_def>();
                     abis.set_abi( abi, max_serialization_time );
                     auto binary_data = abis.binary_to_variant( abis.get_action_type(action.name), action.data, max_serialization_time);
                     json_str = fc::json::to_string(binary_data);
@@ -424,9 +570,59 @@ namespace eosio {
         return json_str;
     }
 
+    bool actions_table::indexed( const chain::action& action ) {
+        if( action.account == chain::config::system_account_name || action.account == N(eosio.msig) ) return true;
+        // the token actions of any contract feed the assets and balances
+        return action.name == N(transfer) || action.name == N(issue) || action.name == N(retire)
+            || action.name == N(create) || action.name == N(close);
+    }
+
+    void actions_table::mark_dirty( const chain::action& action, const fc::variant& abi_data ){
+        if( !m_dirty_accounts || !abi_data.is_object() ) return;
+
+        auto mark = [&]( const char* field ){
+            try{
+                if( abi_data.get_object().contains(field) ){
+                    m_dirty_accounts->mark( abi_data[field].as<chain::name>() );
+                }
+            } catch(...) {
+                // custom contracts may use these field names for non account values
+            }
+        };
+
+        if( action.account == chain::config::system_account_name ){
+            if( action.name == newaccount ){
+                mark("creator");
+                mark("name");
+            } else if( action.name == N(delegatebw) || action.name == N(undelegatebw) ){
+                mark("from");
+                mark("receiver");
+            } else if( action.name == N(buyram) || action.name == N(buyrambytes) ){
+                mark("payer");
+                mark("receiver");
+            } else if( action.name == N(sellram) || action.name == N(refund) ){
+                mark( action.name == N(sellram) ? "account" : "owner" );
+            } else if( action.name == N(voteproducer) ){
+                mark("voter");
+            }
+        } else if( action.name == N(transfer) ){
+            // any token contract, the airdropped ones included
+            mark("from");
+            mark("to");
+        } else if( action.name == N(issue) ){
+            mark("to");
+        } else if( action.name == N(open) || action.name == N(close) ){
+            mark("owner");
+        } else if( action.name == N(retire) && !action.authorization.empty() ){
+            // the issuer retires its own balance, the action names no account
+            m_dirty_accounts->mark( action.authorization.front().actor );
+        }
+    }
+
     soci::rowset<soci::row> actions_table::get_assets(std::shared_ptr<soci::session> m_session, int startNum,int pageSize){
-        soci::rowset<soci::row> rs = ( m_session->prepare << "select contract_owner, issuer, symbol_precision, symbol from assets order by id limit :st,:pt ",
-            soci::use(startNum),soci::use(pageSize));
+        // LIMIT n OFFSET m, the LIMIT m,n form is MySQL only
+        soci::rowset<soci::row> rs = ( m_session->prepare << "select contract_owner, issuer, symbol_precision, symbol from assets order by id limit :pt offset :st ",
+            soci::use(pageSize),soci::use(startNum));
         return rs;
     }
 
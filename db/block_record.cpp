@@ -0,0 +1,84 @@
+#include <eosio/sql_db_plugin/block_record.hpp>
+#include <eosio/sql_db_plugin/metrics.hpp>
+
+namespace eosio {
+
+    block_record::block_record( const chain::block_state_ptr& bs ) {
+        const auto& block = *bs->block;
+        block_num         = bs->block_num;
+        irreversible_num  = bs->dpos_irreversible_blocknum;
+        id                = bs->id;
+        previous          = block.previous;
+        timestamp         = block.timestamp;
+        producer          = block.producer;
+        confirmed         = block.confirmed;
+        schedule_version  = block.schedule_version;
+        transaction_mroot = block.transaction_mroot;
+        action_mroot      = block.action_mroot;
+        new_producers     = block.new_producers;
+
+        scoped_timer timer( metrics().stage(ingest_stage::unpack) );
+        transactions.reserve(block.transactions.size());
+        uint32_t index = 0;
+        for(const auto& receipt : block.transactions){
+            const uint32_t this_trx = index++;
+            if( !receipt.trx.contains<chain::packed_transaction>() ) continue;
+
+            auto trx = fc::raw::unpack<chain::transaction>( receipt.trx.get<chain::packed_transaction>().get_raw_transaction() );
+
+            transaction_entry entry;
+            entry.id               = trx.id();
+            entry.index            = this_trx;
+            entry.expiration       = trx.expiration;
+            entry.ref_block_num    = trx.ref_block_num;
+            entry.ref_block_prefix = trx.ref_block_prefix;
+            entry.cpu_usage_us     = receipt.cpu_usage_us;
+            entry.net_usage_words  = receipt.net_usage_words;
+            entry.first_action     = uint32_t(actions.size());
+            entry.action_count     = uint32_t(trx.actions.size());
+            transactions.push_back(entry);
+
+            for(const auto& act : trx.actions){
+                action_entry a;
+                a.account     = act.account;
+                a.name        = act.name;
+                a.first_auth  = uint32_t(authorizations.size());
+                a.auth_count  = uint32_t(act.authorization.size());
+                a.data_offset = uint32_t(data.size());
+                a.data_size   = uint32_t(act.data.size());
+                actions.push_back(a);
+                authorizations.insert(authorizations.end(), act.authorization.begin(), act.authorization.end());
+                data.insert(data.end(), act.data.begin(), act.data.end());
+            }
+        }
+
+        // the arrays stay as they are until the record is dropped
+        transactions.shrink_to_fit();
+        actions.shrink_to_fit();
+        authorizations.shrink_to_fit();
+        data.shrink_to_fit();
+    }
+
+    size_t block_record::bytes() const {
+        return sizeof(*this)
+             + transactions.capacity() * sizeof(transaction_entry)
+             + actions.capacity() * sizeof(action_entry)
+             + authorizations.capacity() * sizeof(chain::permission_level)
+             + data.capacity()
+             + (new_producers ? new_producers->producers.size() * sizeof(chain::producer_key) : 0);
+    }
+
+    chain::action block_record::action( const action_entry& act ) const {
+        chain::action result;
+        load_action( act, result );
+        return result;
+    }
+
+    void block_record::load_action( const action_entry& act, chain::action& out ) const {
+        out.account = act.account;
+        out.name    = act.name;
+        out.authorization.assign( authorizations.begin() + act.first_auth, authorizations.begin() + act.first_auth + act.auth_count );
+        out.data.assign( data.begin() + act.data_offset, data.begin() + act.data_offset + act.data_size );
+    }
+
+} // namespace
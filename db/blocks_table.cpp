@@ -1,85 +1,119 @@
 // #include "blocks_table.hpp"
 #include <eosio/sql_db_plugin/blocks_table.hpp>
+#include <eosio/sql_db_plugin/metrics.hpp>
+#include <eosio/sql_db_plugin/sql_profiler.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <fc/log/logger.hpp>
 
 namespace eosio {
 
-    void blocks_table::add( std::shared_ptr<soci::session> m_session, const chain::block_state_ptr&  bs ) {
-        /*
-        auto block = bs->block;
-        const auto block_id_str = block->id().str();
-        const auto previous_block_id_str = block->previous.str();
-        const auto transaction_mroot_str = block->transaction_mroot.str();
-        const auto action_mroot_str = block->action_mroot.str();
-        const auto timestamp = std::chrono::seconds{block->timestamp.operator fc::time_point().sec_since_epoch()}.count();
-        const auto num_transactions = (int)bs->trxs.size();
+    void blocks_table::add( const block_record& block ) {
+        const auto timestamp = std::chrono::seconds{block.timestamp.operator fc::time_point().sec_since_epoch()}.count();
 
+        // ids, names and numbers only, nothing needs escaping. the producers JSON is names
+        // and public keys in double quotes
+        std::string row = "('" + block.id.str() + "'," + std::to_string(block.block_num) + ",'" + block.previous.str() + "',"
+                        + "FROM_UNIXTIME(" + std::to_string(timestamp) + "),'" + block.transaction_mroot.str() + "','" + block.action_mroot.str() + "','"
+                        + block.producer.to_string() + "'," + std::to_string(block.schedule_version) + "," + std::to_string(block.confirmed) + ","
+                        + std::to_string(block.transactions.size()) + ",";
+        row += block.new_producers ? "'" + fc::json::to_string(block.new_producers->producers) + "')" : std::string("NULL)");
+        m_rows.push_back( std::move(row) );
+    }
 
-        try{
-            *m_session << "INSERT INTO blocks(block_id, block_number, prev_block_id, timestamp, transaction_merkle_root, action_merkle_root,"
-                "producer, version, confirmed, num_transactions) VALUES (:id, :in, :pb, FROM_UNIXTIME(:ti), :tr, :ar, :pa, :ve, :pe, :nt) ON DUPLICATE KEY UPDATE block_number=:in, prev_block_id=:pb, timestamp=FROM_UNIXTIME(:ti), transaction_merkle_root=:tr, action_merkle_root=:ar,producer=:pa, version=:ve, confirmed=:pe, num_transactions=:nt",
-                soci::use(block_id_str),
-                soci::use(block->block_num()),
-                soci::use(previous_block_id_str),
-                soci::use(timestamp),
-                soci::use(transaction_mroot_str),
-                soci::use(action_mroot_str),
-                soci::use(block->producer.to_string()),
-                soci::use(block->schedule_version),
-                soci::use(block->confirmed),
-                soci::use(num_transactions),
-                soci::use(block->block_num()),
-                soci::use(previous_block_id_str),
-                soci::use(timestamp),
-                soci::use(transaction_mroot_str),
-                soci::use(action_mroot_str),
-                soci::use(block->producer.to_string()),
-                soci::use(block->schedule_version),
-                soci::use(block->confirmed),
-                soci::use(num_transactions);
-
-            if (block->new_producers) {
-                const auto new_producers = fc::json::to_string(block->new_producers->producers);
-                *m_session << "UPDATE blocks SET new_producers = :np WHERE block_id = :id",
-                        soci::use(new_producers),
-                        soci::use(block_id_str);
-
-                        
+    std::vector<std::string> blocks_table::take() {
+        std::vector<std::string> rows;
+        rows.swap(m_rows);
+        return rows;
+    }
+
+    void blocks_table::write( soci::session& sql, const std::vector<std::string>& rows ) const {
+        const size_t rows_per_statement = 500;
+
+        for(size_t begin = 0; begin < rows.size(); begin += rows_per_statement){
+            std::string insert = "INSERT INTO blocks(block_id, block_number, prev_block_id, timestamp, transaction_merkle_root, action_merkle_root, "
+                                 "producer, version, confirmed, num_transactions, new_producers) VALUES ";
+            size_t end = std::min(rows.size(), begin + rows_per_statement);
+            for(size_t i = begin; i < end; i++){
+                if( i > begin ) insert += ",";
+                insert += rows[i];
             }
-        } catch(soci::mysql_soci_error e) {
-            wlog("soci::error: ${e}",("e",e.what()) );
-        } catch(std::exception e) {
-            wlog( "add blocks failed. ${e}",("e",e.what()) );
-        } catch(...) {
-            wlog( "add blocks failed. " );
-        }*/
+            // a block id is one block, written again on a replay it is kept as it is
+            insert += m_sink->ignore_duplicate("block_id");
+
+            statement_timer stmt(sql, insert, "INSERT INTO blocks VALUES (...),...");
+            sql << stmt.sql();
+            stmt.done();
+            metrics().count_table("blocks", end - begin);
+        }
     }
 
-    bool blocks_table::irreversible_set( std::shared_ptr<soci::session> m_session, std::string block_id, bool irreversible ){
-        
-        int amount = 0;
+    bool blocks_table::irreversible_set( std::shared_ptr<soci::session> m_session, const std::vector<std::string>& block_ids ){
+        const size_t ids_per_statement = 500;
+
+        // by id, a fork block at the same height as a flagged one stays reversible. the
+        // rows flagged already are skipped
         try{
-            soci::statement st = ( m_session->prepare << "UPDATE blocks SET irreversible = :irreversible WHERE block_id = :id",
-                    soci::use(irreversible?1:0),
-                    soci::use(block_id) );
-            st.execute(true);
-            amount = st.get_affected_rows();
-            if(amount==0){
-                *m_session << "select count(*) from blocks where irreversible = 0 and block_id = :id ",
-                    soci::into(amount),
-                    soci::use(block_id);
-                if(amount==0) return true;
+            for(size_t begin = 0; begin < block_ids.size(); begin += ids_per_statement){
+                std::string update = "UPDATE blocks SET irreversible = TRUE WHERE block_id IN (";
+                size_t end = std::min(block_ids.size(), begin + ids_per_statement);
+                for(size_t i = begin; i < end; i++){
+                    if( i > begin ) update += ",";
+                    update += "'" + block_ids[i] + "'";
+                }
+                update += ") AND NOT irreversible";
+
+                statement_timer stmt(*m_session, update, "UPDATE blocks SET irreversible = TRUE WHERE block_id IN (...)");
+                *m_session << stmt.sql();
+                stmt.done();
             }
-            // wlog( "${amount}",("amount",amount) );
+            return true;
         } catch(soci::mysql_soci_error e) {
             wlog("soci::error: ${e}",("e",e.what()) );
         } catch(std::exception e) {
-            wlog( "update block irreversible failed.block id:${id},error: ${e}",("id",block_id)("e",e.what()) );
+            wlog( "update blocks irreversible failed, ${n} blocks,error: ${e}",("n",block_ids.size())("e",e.what()) );
         } catch(...) {
-            wlog("update block irreversible failed. ${id}",("id",block_id));
+            wlog("update blocks irreversible failed, ${n} blocks",("n",block_ids.size()));
+        }
+        return false;
+    }
+
+    std::vector<blocks_table::link> blocks_table::links( std::shared_ptr<soci::session> m_session, uint32_t first, uint32_t last ){
+        const int64_t from = first, to = last;
+        std::vector<link> blocks;
+        link row;
+        int64_t block_num = 0;
+
+        statement_timer stmt(*m_session, "SELECT block_id, block_number, prev_block_id FROM blocks WHERE block_number BETWEEN :first AND :last");
+        soci::statement st = (m_session->prepare << stmt.sql(),
+                              soci::use(from), soci::use(to),
+                              soci::into(row.block_id), soci::into(block_num), soci::into(row.prev_block_id));
+        st.execute();
+        while( st.fetch() ){
+            row.block_num = uint32_t(block_num);
+            blocks.push_back(row);
         }
-        return amount > 0;
+        stmt.done();
+        return blocks;
+    }
+
+    uint32_t blocks_table::irreversible_block( std::shared_ptr<soci::session> m_session ){
+        int64_t block_num = 0;
+        soci::indicator ind = soci::i_null;
+        statement_timer stmt(*m_session, "SELECT block_number FROM blocks WHERE irreversible ORDER BY block_number DESC LIMIT 1");
+        *m_session << stmt.sql(), soci::into(block_num, ind);
+        stmt.done();
+        return m_session->got_data() && ind == soci::i_ok ? uint32_t(block_num) : 0;
+    }
+
+    uint32_t blocks_table::last_block( std::shared_ptr<soci::session> m_session ){
+        int64_t block_num = 0;
+        soci::indicator ind = soci::i_null;
+        statement_timer stmt(*m_session, "SELECT block_number FROM blocks ORDER BY block_number DESC LIMIT 1");
+        *m_session << stmt.sql(), soci::into(block_num, ind);
+        stmt.done();
+        return m_session->got_data() && ind == soci::i_ok ? uint32_t(block_num) : 0;
     }
 
 } // namespace
@@ -0,0 +1,347 @@
+#include <eosio/sql_db_plugin/change_stream.hpp>
+#include <eosio/sql_db_plugin/json_writer.hpp>
+
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/filesystem.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/log/logger.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+namespace bfs = boost::filesystem;
+using boost::asio::local::stream_protocol;
+
+namespace eosio {
+
+    struct change_stream::subscriber {
+        subscriber( boost::asio::io_service& ios ):socket(ios){}
+
+        stream_protocol::socket socket;
+        boost::asio::streambuf  cursor;
+        std::deque<frame_ptr>   queue;
+        size_t                  queued_bytes = 0;
+        uint64_t                last_sequence = 0;
+        bool                    live = false;
+        bool                    writing = false;
+    };
+
+    namespace {
+
+        // the sequence of the last complete frame of a change file, 0 when there is none
+        uint64_t last_sequence( const bfs::path& path ) {
+            std::ifstream in(path.string(), std::ios::binary);
+            if( !in ) return 0;
+
+            if( path.extension() == ".bin" ){
+                // the length prefixes lead to the last frame, a frame cut by a crash is skipped
+                const uint64_t file_size = bfs::file_size(path);
+                uint64_t pos = 0, last = 0;
+                uint32_t size = 0, last_size = 0;
+                while( pos + sizeof(size) <= file_size && in.seekg(pos) && in.read(reinterpret_cast<char*>(&size), sizeof(size)) ){
+                    if( pos + sizeof(size) + size > file_size ) break;
+                    last = pos + sizeof(size);
+                    last_size = size;
+                    pos = last + size;
+                }
+                if( last_size == 0 ) return 0;
+                std::vector<char> packed(last_size);
+                in.clear();
+                if( !in.seekg(last) || !in.read(packed.data(), last_size) ) return 0;
+                return fc::raw::unpack<change_frame>(packed).sequence;
+            }
+
+            // the frames are small, the last line ending in the tail of the file is the last one
+            const uint64_t file_size = bfs::file_size(path);
+            const uint64_t tail = std::min<uint64_t>(file_size, 1024*1024);
+            std::string data(tail, '\0');
+            if( !in.seekg(file_size - tail) || !in.read(&data[0], tail) ) return 0;
+            auto end = data.rfind('\n');
+            if( end == std::string::npos ) return 0;
+            auto begin = data.rfind('\n', end == 0 ? 0 : end - 1);
+            begin = begin == std::string::npos || begin == end ? 0 : begin + 1;
+            return fc::json::from_string(data.substr(begin, end - begin))["seq"].as_uint64();
+        }
+
+    }
+
+    change_stream::change_stream( const change_stream_options& options ):m_options(options) {
+        if( !m_options.file_dir.empty() ){
+            bfs::create_directories(m_options.file_dir);
+            // continue after the files of the previous run
+            std::set<uint32_t> indexes;
+            for(bfs::directory_iterator itr(m_options.file_dir), end; itr != end; ++itr){
+                uint32_t index = 0;
+                if( std::sscanf(itr->path().filename().string().c_str(), "changes-%u.", &index) == 1 ){
+                    indexes.insert(index);
+                    m_file_index = std::max(m_file_index, index);
+                }
+            }
+            // and the sequence of their last frame, the newest files may be empty
+            for(auto itr = indexes.rbegin(); itr != indexes.rend() && m_sequence == 0; ++itr){
+                for(const char* ext : { "ndjson", "bin" }){
+                    char name[64];
+                    std::snprintf(name, sizeof(name), "changes-%06u.%s", *itr, ext);
+                    auto path = m_options.file_dir / name;
+                    if( m_sequence > 0 || !bfs::exists(path) ) continue;
+                    try{
+                        m_sequence = last_sequence(path);
+                    } catch(const fc::exception& e) {
+                        wlog("no sequence read from ${f}: ${e}", ("f", path.string())("e", e.to_string()));
+                    } catch(const std::exception& e) {
+                        wlog("no sequence read from ${f}: ${e}", ("f", path.string())("e", e.what()));
+                    }
+                }
+            }
+            rotate_file();
+        }
+        // without the files of a previous run the sequence starts at the clock, above the
+        // cursors the subscribers kept from that run
+        if( m_sequence == 0 ){
+            m_sequence = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+        ilog("change stream continues after sequence ${s}", ("s", m_sequence));
+
+        if( !m_options.socket_path.empty() ){
+            bfs::remove(m_options.socket_path);
+            m_acceptor = std::make_unique<stream_protocol::acceptor>(m_ios, stream_protocol::endpoint(m_options.socket_path));
+            m_work = std::make_unique<boost::asio::io_service::work>(m_ios);
+            accept();
+            m_thread = boost::thread([this]{ m_ios.run(); });
+            ilog("change stream listening on ${s}", ("s", m_options.socket_path));
+        }
+    }
+
+    change_stream::~change_stream() {
+        if( m_thread.joinable() ){
+            m_ios.post([this]{
+                if( m_acceptor ) m_acceptor->close();
+                for(const auto& s : m_subscribers){
+                    boost::system::error_code ec;
+                    s->socket.close(ec);
+                }
+                m_subscribers.clear();
+            });
+            m_work.reset();
+            m_thread.join();
+            bfs::remove(m_options.socket_path);
+        }
+        if( m_file ) std::fclose(m_file);
+    }
+
+    void change_stream::publish( const event_row& row, uint32_t block_num ) {
+        change_frame frame;
+        frame.table        = row.table;
+        frame.block_num    = block_num;
+        frame.irreversible = block_num <= m_irreversible;
+        frame.fields.reserve(row.fields.size());
+        for(const auto& f : row.fields){
+            frame.fields.push_back({ f.column, uint8_t(f.type), f.integer, f.text });
+        }
+        // the key of the row, for the subscribers that apply the frames at least once
+        if( row.ordinal != 0 ){
+            frame.fields.push_back({ "action_ordinal", uint8_t(event_row::kind::integer), int64_t(row.ordinal), std::string() });
+        }
+        publish(frame);
+    }
+
+    void change_stream::set_irreversible( uint32_t block_num ) {
+        if( block_num <= m_irreversible ) return;
+        m_irreversible = block_num;
+
+        change_frame frame;
+        frame.table        = "lib";
+        frame.block_num    = block_num;
+        frame.irreversible = true;
+        publish(frame);
+    }
+
+    void change_stream::publish( change_frame& frame ) {
+        frame_ptr data;
+        {
+            boost::mutex::scoped_lock lock(m_mtx);
+            frame.sequence = ++m_sequence;
+            data = std::make_shared<const std::string>( encode(frame) );
+            if( m_file ) write_file(*data);
+            if( m_options.replay_frames > 0 ){
+                m_replay.emplace_back(frame.sequence, data);
+                while( m_replay.size() > m_options.replay_frames ) m_replay.pop_front();
+            }
+        }
+
+        if( m_acceptor ){
+            auto sequence = frame.sequence;
+            m_ios.post([this, sequence, data]{
+                for(auto itr = m_subscribers.begin(); itr != m_subscribers.end(); ){
+                    auto s = *itr++;
+                    if( s->live && sequence > s->last_sequence ){
+                        s->last_sequence = sequence;
+                        enqueue(s, data);
+                    }
+                }
+            });
+        }
+    }
+
+    std::string change_stream::encode( const change_frame& frame ) const {
+        if( m_options.binary ){
+            auto packed = fc::raw::pack(frame);
+            uint32_t size = uint32_t(packed.size());
+            std::string out(sizeof(size) + packed.size(), '\0');
+            std::memcpy(&out[0], &size, sizeof(size));
+            std::memcpy(&out[sizeof(size)], packed.data(), packed.size());
+            return out;
+        }
+
+        json_writer out;
+        out.begin_object()
+           .key("seq").uint64(frame.sequence)
+           .key("table").string(frame.table)
+           .key("block_num").uint64(frame.block_num)
+           .key("irreversible").boolean(frame.irreversible)
+           .key("fields").begin_object();
+        for(const auto& f : frame.fields){
+            out.key(f.column);
+            switch( event_row::kind(f.type) ){
+                case event_row::kind::integer:
+                case event_row::kind::time:
+                    out.int64(f.integer);
+                    break;
+                default:
+                    out.string(f.text);
+                    break;
+            }
+        }
+        out.end_object().end_object();
+        return out.str() + "\n";
+    }
+
+    void change_stream::write_file( const std::string& data ) {
+        if( m_file_size > 0 && m_file_size + data.size() > m_options.file_bytes ) rotate_file();
+        if( !m_file ) return;
+        if( std::fwrite(data.data(), 1, data.size(), m_file) != data.size() ){
+            wlog("change stream file write failed, ${n} bytes lost", ("n", data.size()));
+        }
+        m_file_size += data.size();
+    }
+
+    void change_stream::rotate_file() {
+        if( m_file ) std::fclose(m_file);
+        m_file_index++;
+        m_file_size = 0;
+
+        const char* ext = m_options.binary ? "bin" : "ndjson";
+        auto file_name = [&]( uint32_t index ){
+            char name[64];
+            std::snprintf(name, sizeof(name), "changes-%06u.%s", index, ext);
+            return m_options.file_dir / name;
+        };
+
+        auto path = file_name(m_file_index);
+        m_file = std::fopen(path.string().c_str(), "wb");
+        if( !m_file ) elog("cannot open change stream file ${f}", ("f", path.string()));
+
+        if( m_options.file_count > 0 && m_file_index > m_options.file_count ){
+            boost::system::error_code ec;
+            bfs::remove(file_name(m_file_index - m_options.file_count), ec);
+        }
+    }
+
+    void change_stream::flush() {
+        boost::mutex::scoped_lock lock(m_mtx);
+        if( m_file ) std::fflush(m_file);
+    }
+
+    void change_stream::accept() {
+        auto s = std::make_shared<subscriber>(m_ios);
+        m_acceptor->async_accept(s->socket, [this, s]( const boost::system::error_code& ec ){
+            if( ec == boost::asio::error::operation_aborted ) return;
+            if( !ec ){
+                m_subscribers.insert(s);
+                read_cursor(s);
+            }
+            accept();
+        });
+    }
+
+    void change_stream::read_cursor( std::shared_ptr<subscriber> s ) {
+        boost::asio::async_read_until(s->socket, s->cursor, '\n', [this, s]( const boost::system::error_code& ec, size_t ){
+            if( ec ){
+                drop(s, "closed before sending a cursor");
+                return;
+            }
+
+            std::istream in(&s->cursor);
+            std::string line;
+            std::getline(in, line);
+
+            boost::mutex::scoped_lock lock(m_mtx);
+            if( line == "-" ){
+                s->last_sequence = m_sequence;
+            } else {
+                try{
+                    s->last_sequence = std::stoull(line);
+                } catch(...) {
+                    lock.unlock();
+                    drop(s, "sent an invalid cursor");
+                    return;
+                }
+                if( s->last_sequence > m_sequence ){
+                    lock.unlock();
+                    drop(s, "sent a cursor past the stream");
+                    return;
+                }
+                // frames after the cursor still retained, a gap shows in the sequence numbers
+                for(const auto& f : m_replay){
+                    if( f.first <= s->last_sequence ) continue;
+                    s->last_sequence = f.first;
+                    s->queue.push_back(f.second);
+                    s->queued_bytes += f.second->size();
+                }
+            }
+            s->live = true;
+            lock.unlock();
+            write_next(s);
+        });
+    }
+
+    void change_stream::enqueue( const std::shared_ptr<subscriber>& s, const frame_ptr& frame ) {
+        if( s->queued_bytes + frame->size() > m_options.subscriber_buffer_bytes ){
+            drop(s, "fell behind");
+            return;
+        }
+        s->queue.push_back(frame);
+        s->queued_bytes += frame->size();
+        write_next(s);
+    }
+
+    void change_stream::write_next( std::shared_ptr<subscriber> s ) {
+        if( s->writing || s->queue.empty() || !s->socket.is_open() ) return;
+        s->writing = true;
+        auto frame = s->queue.front();
+        boost::asio::async_write(s->socket, boost::asio::buffer(*frame), [this, s, frame]( const boost::system::error_code& ec, size_t ){
+            s->writing = false;
+            if( ec ){
+                drop(s, "closed");
+                return;
+            }
+            s->queue.pop_front();
+            s->queued_bytes -= frame->size();
+            write_next(s);
+        });
+    }
+
+    void change_stream::drop( const std::shared_ptr<subscriber>& s, const char* reason ) {
+        if( !m_subscribers.erase(s) ) return;
+        ilog("change stream subscriber ${r} at ${n}, disconnected", ("r", reason)("n", s->last_sequence));
+        boost::system::error_code ec;
+        s->socket.close(ec);
+        s->queue.clear();
+        s->queued_bytes = 0;
+    }
+
+} // namespace
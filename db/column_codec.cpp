@@ -0,0 +1,128 @@
+#include <eosio/sql_db_plugin/column_codec.hpp>
+
+#include <fc/crypto/base64.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+
+#ifdef SQL_DB_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+namespace eosio {
+
+    namespace {
+        const char prefix[] = "\"~zstd:";
+        const size_t prefix_size = sizeof(prefix) - 1;
+
+#ifdef SQL_DB_ZSTD
+        // one context per thread, the dictionaries are shared read only
+        ZSTD_CCtx* compress_context() {
+            thread_local std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> ctx( ZSTD_createCCtx(), ZSTD_freeCCtx );
+            return ctx.get();
+        }
+
+        ZSTD_DCtx* decompress_context() {
+            thread_local std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> ctx( ZSTD_createDCtx(), ZSTD_freeDCtx );
+            return ctx.get();
+        }
+#endif
+    }
+
+    struct column_codec::dictionaries {
+#ifdef SQL_DB_ZSTD
+        ZSTD_CDict* compress = nullptr;
+        ZSTD_DDict* decompress = nullptr;
+
+        ~dictionaries() {
+            ZSTD_freeCDict(compress);
+            ZSTD_freeDDict(decompress);
+        }
+#endif
+    };
+
+    column_codec::column_codec( int level, size_t min_bytes, const std::string& dictionary )
+    :m_level(level), m_min_bytes(min_bytes), m_dicts(std::make_unique<dictionaries>()) {
+#ifdef SQL_DB_ZSTD
+        m_enabled = true;
+        if( !dictionary.empty() ){
+            m_dicts->compress = ZSTD_createCDict(dictionary.data(), dictionary.size(), level);
+            m_dicts->decompress = ZSTD_createDDict(dictionary.data(), dictionary.size());
+            FC_ASSERT( m_dicts->compress && m_dicts->decompress, "invalid zstd dictionary" );
+        }
+#else
+        wlog("built without zstd, the columns are not compressed");
+#endif
+    }
+
+    column_codec::~column_codec() {}
+
+    bool column_codec::compressed( const std::string& stored ) {
+        return stored.size() > prefix_size && stored.compare(0, prefix_size, prefix) == 0 && stored.back() == '"';
+    }
+
+    std::string column_codec::encode( const std::string& value ) const {
+        if( !m_enabled || value.size() < m_min_bytes ) return value;
+#ifdef SQL_DB_ZSTD
+        std::string frame( ZSTD_compressBound(value.size()), '\0' );
+        size_t size = m_dicts->compress
+            ? ZSTD_compress_usingCDict( compress_context(), &frame[0], frame.size(), value.data(), value.size(), m_dicts->compress )
+            : ZSTD_compressCCtx( compress_context(), &frame[0], frame.size(), value.data(), value.size(), m_level );
+        if( ZSTD_isError(size) ) return value;
+
+        // base64 adds a third, short values may not be worth it
+        auto encoded = fc::base64_encode( reinterpret_cast<const unsigned char*>(frame.data()), unsigned(size) );
+        if( encoded.size() + prefix_size + 1 >= value.size() ) return value;
+        return prefix + encoded + '"';
+#else
+        return value;
+#endif
+    }
+
+    std::string column_codec::decode( const std::string& stored ) const {
+        if( !compressed(stored) ) return stored;
+#ifdef SQL_DB_ZSTD
+        auto frame = fc::base64_decode( stored.substr(prefix_size, stored.size() - prefix_size - 1) );
+        auto size = ZSTD_getFrameContentSize( frame.data(), frame.size() );
+        FC_ASSERT( size != ZSTD_CONTENTSIZE_ERROR && size != ZSTD_CONTENTSIZE_UNKNOWN, "invalid zstd column value" );
+
+        std::string value( size, '\0' );
+        // values compressed before the dictionary was trained have no dictionary id
+        size_t result = m_dicts && m_dicts->decompress && ZSTD_getDictID_fromFrame( frame.data(), frame.size() ) != 0
+            ? ZSTD_decompress_usingDDict( decompress_context(), &value[0], value.size(), frame.data(), frame.size(), m_dicts->decompress )
+            : ZSTD_decompressDCtx( decompress_context(), &value[0], value.size(), frame.data(), frame.size() );
+        FC_ASSERT( !ZSTD_isError(result), "zstd column value: ${e}", ("e", ZSTD_getErrorName(result)) );
+        value.resize(result);
+        return value;
+#else
+        FC_THROW( "compressed column value but built without zstd" );
+#endif
+    }
+
+    std::string column_codec::train( const std::vector<std::string>& samples, size_t max_bytes ) {
+#ifdef SQL_DB_ZSTD
+        // zdict wants a few samples per kB of dictionary
+        if( samples.size() < 8 ) return std::string();
+
+        std::string buffer;
+        std::vector<size_t> sizes;
+        sizes.reserve(samples.size());
+        for(const auto& s : samples){
+            buffer += s;
+            sizes.push_back(s.size());
+        }
+
+        std::string dictionary( max_bytes, '\0' );
+        size_t size = ZDICT_trainFromBuffer( &dictionary[0], dictionary.size(), buffer.data(), sizes.data(), unsigned(sizes.size()) );
+        if( ZDICT_isError(size) ){
+            wlog("zstd dictionary not trained: ${e}", ("e", ZDICT_getErrorName(size)));
+            return std::string();
+        }
+        dictionary.resize(size);
+        return dictionary;
+#else
+        return std::string();
+#endif
+    }
+
+} // namespace
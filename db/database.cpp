@@ -3,17 +3,40 @@
 #include <eosio/sql_db_plugin/sql_db_plugin.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
 
+#include <future>
+#include <set>
+
+#include <eosio/sql_db_plugin/metrics.hpp>
+#include <eosio/sql_db_plugin/sql_profiler.hpp>
+
 
 namespace eosio
 {
 
+    namespace {
+        // columns refreshed when the stakes or tokens row already exists
+        const std::vector<std::string> stake_columns = {
+            "liquid", "staked", "unstaking", "total", "total_stake", "totalasset",
+            "cpu_total", "cpu_staked", "cpu_delegated", "cpu_used", "cpu_available", "cpu_limit",
+            "net_total", "net_staked", "net_delegated", "net_used", "net_available", "net_limit",
+            "ram_quota", "ram_usage" };
+        const std::vector<std::string> token_columns = { "balance", "symbol_precision" };
+        // blocks and transactions rows buffered before they are written anyway
+        const size_t rows_per_write = 1000;
+    }
+
     sql_database::sql_database(const std::string &uri, uint32_t block_num_start, size_t pool_size) {
-        m_session_pool          = std::make_shared<soci_session_pool>(pool_size,uri);
+        m_sink                  = sql_sink::create(uri);
+        m_session_pool          = std::make_shared<soci_session_pool>(m_sink->pool_size(pool_size),uri,m_sink);
         m_accounts_table        = std::make_unique<accounts_table>();
         m_blocks_table          = std::make_unique<blocks_table>();
         m_transactions_table    = std::make_unique<transactions_table>();
         m_actions_table         = std::make_unique<actions_table>();
+        m_accounts_table->m_sink = m_blocks_table->m_sink = m_transactions_table->m_sink = m_actions_table->m_sink = m_sink;
+        m_sink->create_schema( *m_session_pool->get_session() );
+        m_dirty_accounts        = std::make_shared<dirty_accounts>();
         m_block_num_start       = block_num_start;
+        m_actions_table->m_dirty_accounts = m_dirty_accounts;
         system_account          = chain::name(chain::config::system_account_name).to_string();
     }
 
@@ -23,366 +46,503 @@ namespace eosio
         m_contract_filter_out = filter_out;
     }
 
-    void sql_database::wipe() {
-        chain::abi_def abi_def;
-        abi_def = eosio_contract_abi(abi_def);
-        m_accounts_table->add_eosio( m_session_pool->get_session(), system_account, fc::json::to_string( abi_def ));
+    void sql_database::enable_history(const boost::filesystem::path& dir, uint64_t size_mb) {
+        m_history = std::make_shared<action_history>(dir, size_mb);
+        m_actions_table->m_history = m_history;
     }
 
-    bool sql_database::is_started() {
-        return m_accounts_table->exist( m_session_pool->get_session(), system_account );
+    void sql_database::enable_raw_actions() {
+        m_actions_table->m_raw_actions = true;
     }
 
-    void sql_database::consume_block_state( const chain::block_state_ptr& bs) {
-        // auto m_session = m_session_pool->get_session();
+    void sql_database::set_column_codec(const std::shared_ptr<const column_codec>& codec) {
+        m_accounts_table->m_codec = m_blocks_table->m_codec = m_transactions_table->m_codec = m_actions_table->m_codec = codec;
+    }
 
+    std::string sql_database::train_column_dictionary(size_t max_bytes) {
+        std::vector<std::string> samples;
+        try{
+            auto session = m_session_pool->get_session();
+            for(const char* query : { "SELECT abi FROM accounts WHERE abi IS NOT NULL ORDER BY id DESC LIMIT 2000",
+                                      "SELECT producers FROM votes WHERE producers IS NOT NULL ORDER BY id DESC LIMIT 2000" }){
+                statement_timer stmt(*session, query);
+                soci::rowset<std::string> rows = ( session->prepare << stmt.sql() );
+                for(const auto& value : rows){
+                    // the values compressed already are no samples
+                    if( !value.empty() && !column_codec::compressed(value) ) samples.push_back(value);
+                }
+                stmt.done();
+            }
+        } catch(std::exception& e) {
+            wlog("no samples for the column dictionary: ${e}", ("e", e.what()));
+        }
+        return column_codec::train( samples, max_bytes );
+    }
 
-        auto block_id = bs->id.str();
+    void sql_database::enable_action_log(const boost::filesystem::path& dir, uint64_t segment_mb) {
+        m_action_log = std::make_shared<action_log::writer>(dir, segment_mb * 1024 * 1024);
+        m_actions_table->m_action_log = m_action_log;
+    }
 
-        if(this->m_blocks_table != nullptr) 
-               m_blocks_table->add(m_session_pool->get_session(),bs);
+    void sql_database::enable_change_stream(const change_stream_options& options) {
+        m_changes = std::make_shared<change_stream>(options);
+        m_actions_table->m_changes = m_changes;
+    }
 
-        for(auto& receipt : bs->block->transactions) {
-            string trx_id_str;
-            if( receipt.trx.contains<chain::packed_transaction>() ){
-                const auto& trx = fc::raw::unpack<chain::transaction>( receipt.trx.get<chain::packed_transaction>().get_raw_transaction() );
-                
-                m_transactions_table->add(m_session_pool->get_session(),trx);
+    void sql_database::enable_writer_strands(const std::string& uri, size_t strands) {
+        m_strands = std::make_shared<table_strands>(uri, m_sink, strands);
+        m_actions_table->m_strands = m_strands;
+    }
+
+    void sql_database::mark_irreversible(uint32_t lib, const chain::block_id_type& head_id) {
+        if( lib <= m_irreversible ) return;
 
-                if(trx.actions.size()==1 && trx.actions[0].name.to_string() == "onblock" ) continue ;
+        try{
+            auto session = m_session_pool->get_session();
+            if( !m_irreversible_loaded ){
+                m_irreversible = m_blocks_table->irreversible_block( session );
+                m_irreversible_loaded = true;
+                if( lib <= m_irreversible ) return;
+            }
 
-                for(const auto& act : trx.actions){
-                    m_actions_table->add( m_session_pool->get_session(), act,trx.id(), bs->block->timestamp, m_action_filter_on);
+            // back from the head through the previous ids, only these blocks are canonical
+            std::vector<std::string> block_ids, tx_ids;
+            chain::block_id_type id = head_id;
+            uint32_t lowest = 0;
+            for(auto itr = m_unflagged.find(id); itr != m_unflagged.end() && itr->second.block_num > m_irreversible; itr = m_unflagged.find(id)){
+                if( itr->second.block_num <= lib ){
+                    block_ids.push_back(id.str());
+                    tx_ids.insert(tx_ids.end(), itr->second.tx_ids.begin(), itr->second.tx_ids.end());
+                }
+                lowest = itr->second.block_num;
+                id = itr->second.previous;
+            }
+            if( lowest == 0 ) return;
+
+            // the blocks written before a restart are followed in the table. their transactions
+            // only have a block number, they are flagged by range when no height has a fork
+            bool transactions_ok = true;
+            if( lowest > m_irreversible + 1 ){
+                std::map<std::string, blocks_table::link> written;
+                std::set<uint32_t> heights;
+                bool forked = false;
+                for(auto& row : m_blocks_table->links( session, m_irreversible + 1, lowest - 1 )){
+                    if( row.block_num <= lib && !heights.insert(row.block_num).second ) forked = true;
+                    written[row.block_id] = std::move(row);
+                }
+                for(auto itr = written.find(id.str()); itr != written.end(); itr = written.find(itr->second.prev_block_id)){
+                    if( itr->second.block_num <= lib ) block_ids.push_back(itr->first);
                 }
 
-            }         
+                const uint32_t last = std::min(lib, lowest - 1);
+                if( forked ){
+                    wlog("forks in blocks ${f}-${l}, their transactions stay reversible", ("f", m_irreversible + 1)("l", last));
+                } else if( last > m_irreversible ){
+                    transactions_ok = m_transactions_table->irreversible_set( session, m_irreversible + 1, last );
+                }
+            }
 
+            // the watermark only moves once both are flagged, a failed batch is retried with the next one
+            if( transactions_ok &&
+                m_blocks_table->irreversible_set( session, block_ids ) &&
+                m_transactions_table->irreversible_set( session, tx_ids ) ){
+                m_irreversible = lib;
+                metrics().irreversible_block = lib;
+                for(auto itr = m_unflagged.begin(); itr != m_unflagged.end(); ){
+                    if( itr->second.block_num <= lib ) itr = m_unflagged.erase(itr);
+                    else ++itr;
+                }
+            }
+        } catch (std::exception& e) {
+            wlog("mark irreversible failed: ${e}", ("e", e.what()));
         }
     }
 
-    void sql_database::consume_transaction_trace( const trace_and_block_time& tbt ){
-        // ilog("${t} ${id}",("t",tbt.block_time)("id",tbt.trace->id.str()));
-        auto session = m_session_pool->get_session();
-        dfs_inline_traces( session, tbt.trace->action_traces, tbt.trace->id, tbt.block_time  );
+    void sql_database::wipe() {
+        chain::abi_def abi_def;
+        abi_def = eosio_contract_abi(abi_def);
+        m_accounts_table->add_eosio( m_session_pool->get_session(), system_account, fc::json::to_string( abi_def ));
     }
 
-    void sql_database::dfs_inline_traces( std::shared_ptr<soci::session> session, vector<chain::action_trace> trace,  chain::transaction_id_type transaction_id, chain::block_timestamp_type block_time ){
-        for(auto& atc : trace){
-            if( atc.receipt.receiver == atc.act.account ){
-                auto is_success = m_actions_table->add( session, atc.act, transaction_id, block_time, m_action_filter_on );
-                if( !is_success && atc.inline_traces.size()!=0 ){
-                    dfs_inline_traces( session, atc.inline_traces, transaction_id, block_time );
+    bool sql_database::is_started() {
+        return m_accounts_table->exist( m_session_pool->get_session(), system_account );
+    }
+
+    void sql_database::consume( const std::vector<block_record_ptr>& blocks ) {
+        if( blocks.empty() ) return;
+
+        const uint32_t batch = m_sink->batch_blocks();
+        bool open = false;
+        uint32_t in_batch = 0;
+        uint32_t lib = 0;
+        chain::block_id_type lib_head;
+        std::vector<uint32_t> batch_blocks;
+
+        // the blocks of a batch the sink failed to write stay below the watermark until
+        // a later batch writes them again
+        auto commit = [&](){
+            try{
+                auto session = m_session_pool->get_session();
+                {
+                    scoped_timer timer( metrics().stage(ingest_stage::commit) );
+                    m_sink->commit(*session);
                 }
+                for(auto block_num : batch_blocks) m_unwritten.erase(block_num);
+            } catch (fc::exception& e) {
+                elog("commit of blocks ${f} to ${l} failed ${e}", ("f", batch_blocks.front())("l", batch_blocks.back())("e", e.to_string()));
+                m_unwritten.insert(batch_blocks.begin(), batch_blocks.end());
+            } catch (std::exception& e) {
+                elog("commit of blocks ${f} to ${l} failed ${e}", ("f", batch_blocks.front())("l", batch_blocks.back())("e", e.what()));
+                m_unwritten.insert(batch_blocks.begin(), batch_blocks.end());
             }
-        }
-    }
+            batch_blocks.clear();
+        };
 
-    int sql_database::get_min_account_id(){
+        for(const auto& block : blocks){
+            if( batch > 0 && !open ){
+                m_sink->begin( *m_session_pool->get_session() );
+                open = true;
+            }
+            if( open ) batch_blocks.push_back( block->block_num );
 
-        int id = 0;           
-        auto session = m_session_pool->get_session();
-        *session << "select min(id) from accounts",
-            soci::into(id);
+            // the buffered rows go out with the last block of the call or of the sink batch
+            const bool write = &block == &blocks.back() || ( open && in_batch + 1 >= batch );
+            try{
+                consume_block( *block, write );
+            } catch (fc::exception& e) {
+                elog("FC Exception while consuming block ${e}", ("e", e.to_string()));
+            } catch (std::exception& e) {
+                elog("STD Exception while consuming block ${e}", ("e", e.what()));
+            } catch (...) {
+                elog("Unknown exception while consuming block");
+            }
 
-        if (!session->got_data()){
-            return -1;
-        }  
+            if( !m_irreversible_loaded || block->block_num > m_irreversible ){
+                auto& unflagged = m_unflagged[block->id];
+                unflagged.block_num = block->block_num;
+                unflagged.previous = block->previous;
+                unflagged.tx_ids.clear();
+                for(const auto& trx : block->transactions) unflagged.tx_ids.push_back(trx.id.str());
+            }
+            // the block that moved the last irreversible block is on its chain
+            if( block->irreversible_num >= lib ){
+                lib = block->irreversible_num;
+                lib_head = block->id;
+            }
 
-        return id;
-        
-    }
+            if( open && ++in_batch >= batch ){
+                commit();
+                open = false;
+                in_batch = 0;
+            }
+        }
 
-    int sql_database::get_max_account_id(){
+        if( open ){
+            commit();
+        }
+        // the strands keep writing, the indexed block catches up with them here
+        metrics().indexed_block = written_block( blocks.back()->block_num );
+        // no block past the written ones is flagged
+        mark_irreversible( std::min( lib, written_block( blocks.back()->block_num ) ), lib_head );
+        if( m_action_log ) m_action_log->flush();
+        if( m_changes ) m_changes->flush();
+    }
 
-        int id = 0;           
-        auto session = m_session_pool->get_session();
-        *session << "select max(id) from accounts",
-            soci::into(id);
-        
-        if (!session->got_data()){
-            return -1;
-        }  
-
-        return id;
-        
+    uint32_t sql_database::written_block( uint32_t consumed ) const {
+        uint32_t written = m_strands ? std::min( consumed, m_strands->checkpoint() ) : consumed;
+        if( !m_unwritten.empty() ) written = std::min( written, *m_unwritten.begin() - 1 );
+        return written;
     }
-    
-    bool sql_database::update_token(std::string account){
-
-        auto ro_api = app().get_plugin<sql_db_plugin>().get_read_only_api();
-        eosio::sql_db_apis::read_only::get_hold_tokens_params param;
-        param.account = name(account);
-        
-        eosio::sql_db_apis::read_only::get_hold_tokens_result result = ro_api.get_hold_tokens(param);
-        
-        for(auto it = result.tokens.begin() ; it != result.tokens.end(); it++){
-            
-            std::string symbol   =  it->symbol;
-            std::string quantity =  it->quantity;
-            int precision        =  it->precision;
-            std::string contract =  it->contract.to_string();
-
-            save_token(account,symbol,quantity,precision,contract);
-        }
 
-        return true;
+    void sql_database::consume_block_state( const chain::block_state_ptr& bs ) {
+        consume_block( block_record(bs) );
     }
 
+    void sql_database::consume_block( const block_record& block, bool write ) {
+        scoped_timer block_timer( metrics().stage(ingest_stage::block) );
 
-    bool sql_database::update_stake(std::string account){
-       
-        
-        auto ro_api = app().get_plugin<chain_plugin>().get_read_only_api();
-        if(!app().get_plugin<chain_plugin>().chain().head_block_state()){
-            ilog("head block state is null"); 
-            return false;
-        }
+        if(this->m_blocks_table != nullptr) 
+               m_blocks_table->add(block);
+        m_transactions_table->add(block);
 
-       
-        int64_t liquid = 0;
-        int64_t staked = 0;
-        int64_t unstaking = 0;
-        int64_t total = 0;
-        int64_t totalasset = 0;
+        if( m_changes ) m_changes->set_irreversible( block.irreversible_num );
+        if( m_action_log ) m_action_log->begin_block( block.block_num, block.timestamp.to_time_point().sec_since_epoch() );
 
-        int64_t cpu_total = 0;
-        int64_t cpu_staked = 0;
-        int64_t cpu_delegated = 0;
-        int64_t cpu_used = 0;
-        int64_t cpu_available = 0;
-        int64_t cpu_limit = 0;
+        {
+            // one lease and one scratch action for the whole block. nothing below takes a
+            // second lease, the sqlite3 pool has a single session
+            auto session = m_session_pool->get_session();
+            chain::action act;
 
-        int64_t net_total = 0;
-        int64_t net_staked = 0;
-        int64_t net_delegated = 0;
-        int64_t net_used = 0;
-        int64_t net_available = 0;
-        int64_t net_limit = 0;
+            for(const auto& trx : block.transactions) {
+                if( trx.action_count == 1 && block.actions[trx.first_action].name == N(onblock) ) continue;
 
-        int64_t ram_quota = 0;
-        int64_t ram_usage = 0;
+                for(uint32_t i = 0; i < trx.action_count; i++){
+                    block.load_action( block.actions[trx.first_action + i], act );
+                    m_actions_table->add( session, act, trx.id, block.timestamp, block.block_num, m_action_filter_on,
+                                          action_ordinal(block.block_num, trx.first_action + i), trx.index, i );
+                }
+            }
 
-        int64_t total_stake = 0;
-        
+            // a fork block written before at this height may have had more actions
+            if( !m_last_block_loaded ){
+                m_last_block = m_blocks_table->last_block( session );
+                m_last_block_loaded = true;
+            }
+            if( block.block_num <= m_last_block ){
+                m_actions_table->remove_events( *session, block.block_num, action_ordinal(block.block_num, uint32_t(block.actions.size())) );
+            }
+            m_last_block = std::max( m_last_block, block.block_num );
 
-        eosio::chain_apis::read_only::get_account_params param;
-        param.account_name = name(account);
+            // before the end of the block, a strand only passes it once its rows are written
+            if( write || m_blocks_table->pending() >= rows_per_write || m_transactions_table->pending() >= rows_per_write ){
+                write_rows( *session );
+            }
+        }
 
+        if( m_action_log ) m_action_log->end_block();
+        if( m_history ) m_history->end_block( block.block_num );
 
-        try{
-    
-            eosio::chain_apis::read_only::get_account_results result = ro_api.get_account(param);
+        if( m_strands ) m_strands->end_block( block.block_num );
+        metrics().indexed_block = written_block( block.block_num );
+        metrics().blocks++;
+    }
 
-            cpu_used      = result.cpu_limit.used;
-            cpu_available = result.cpu_limit.available;
-            cpu_limit     = result.cpu_limit.max;
+    void sql_database::write_rows( soci::session& sql ) {
+        auto blocks = std::make_shared<const std::vector<std::string>>( m_blocks_table->take() );
+        auto transactions = std::make_shared<const std::vector<std::string>>( m_transactions_table->take() );
 
+        if( m_strands ){
+            if( !blocks->empty() ) m_strands->post( "blocks", [this,blocks]( soci::session& s ){ m_blocks_table->write( s, *blocks ); });
+            if( !transactions->empty() ) m_strands->post( "transactions", [this,transactions]( soci::session& s ){ m_transactions_table->write( s, *transactions ); });
+            return;
+        }
 
-            net_used      = result.net_limit.used;
-            net_available = result.net_limit.available;
-            net_limit     = result.net_limit.max;
+        try{
+            m_blocks_table->write( sql, *blocks );
+            m_transactions_table->write( sql, *transactions );
+        } catch(soci::mysql_soci_error e) {
+            wlog("soci::error: ${e}",("e",e.what()) );
+        } catch(std::exception& e) {
+            wlog("write ${b} blocks and ${t} transactions failed: ${e}",("b",blocks->size())("t",transactions->size())("e",e.what()) );
+        } catch(...) {
+            wlog("write ${b} blocks and ${t} transactions failed",("b",blocks->size())("t",transactions->size()) );
+        }
+    }
 
-            ram_quota     = result.ram_quota;
-            ram_usage     = result.ram_usage;
+    void sql_database::consume_transaction_trace( const trace_and_block_time& tbt ){
+        // ilog("${t} ${id}",("t",tbt.block_time)("id",tbt.trace->id.str()));
+        auto session = m_session_pool->get_session();
+        dfs_inline_traces( session, tbt.trace->action_traces, tbt.trace->id, tbt.block_time  );
+    }
 
-            if ( result.core_liquid_balance.valid() ) {
-                    liquid = result.core_liquid_balance->get_amount();
-            }
-                
-            if ( result.total_resources.is_object() ) {
-        
-                cpu_total = asset::from_string(result.total_resources.get_object()["cpu_weight"].as_string()).get_amount();
-
-                if( result.self_delegated_bandwidth.is_object() ) {
-                    
-                    cpu_staked = asset::from_string(result.self_delegated_bandwidth.get_object()["cpu_weight"].as_string()).get_amount();
-                    cpu_delegated = cpu_total - cpu_staked;
-
-                } else {
-                    cpu_delegated = cpu_total;
+    void sql_database::dfs_inline_traces( const std::shared_ptr<soci::session>& session, const vector<chain::action_trace>& trace, const chain::transaction_id_type& transaction_id, chain::block_timestamp_type block_time ){
+        for(const auto& atc : trace){
+            if( atc.receipt.receiver == atc.act.account ){
+                auto is_success = m_actions_table->add( session, atc.act, transaction_id, block_time, 0, m_action_filter_on );
+                if( !is_success && atc.inline_traces.size()!=0 ){
+                    dfs_inline_traces( session, atc.inline_traces, transaction_id, block_time );
                 }
-            }  
+            }
+        }
+    }
 
-            if ( result.total_resources.is_object() ) {
-                
-                net_total = asset::from_string(result.total_resources.get_object()["net_weight"].as_string()).get_amount();
-                if( result.self_delegated_bandwidth.is_object() ) {
+    template<typename Result, typename Function>
+    bool sql_database::on_main_thread( Function&& f, Result& result ){
+        if( app().is_quiting() ) return false;
 
-                    net_staked =  asset::from_string( result.self_delegated_bandwidth.get_object()["net_weight"].as_string()).get_amount();
-                    net_delegated = net_total - net_staked;
-                }
-                else {
-                    net_delegated = net_total;
-                }
+        auto done = std::make_shared<std::promise<Result>>();
+        auto future = done->get_future();
+
+        app().get_io_service().post([f,done](){
+            try{
+                done->set_value( f() );
+            } catch(...) {
+                done->set_exception( std::current_exception() );
+            }
+        });
+
+        // short waits, a shutdown stops the main thread before it runs f
+        for(int waited_ms = 0; future.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready; waited_ms += 100){
+            if( app().is_quiting() ) return false;
+            if( waited_ms >= 30000 ){
+                wlog("chainbase read on the main thread timed out");
+                return false;
             }
+        }
+        result = future.get();
+        return true;
+    }
 
+    bool sql_database::snapshot_accounts(const std::vector<chain::account_name>& accounts, const std::vector<token_asset>& assets, std::vector<stake_row>& stakes, std::vector<token_row>& tokens, uint32_t& head_block_num){
+        auto& chain = app().get_plugin<chain_plugin>().chain();
 
-            if( result.refund_request.is_object() ) {
-                
-                auto obj = result.refund_request.get_object();
-                int net = asset::from_string( obj["net_amount"].as_string() ).get_amount();
-                int cpu = asset::from_string( obj["cpu_amount"].as_string() ).get_amount();
-                unstaking = net + cpu;
+        // chainbase belongs to the main thread, read the whole batch there in one pass
+        std::tuple<std::vector<stake_row>,std::vector<token_row>,uint32_t> rows;
+        bool done = on_main_thread([&chain,accounts,assets](){
+            std::tuple<std::vector<stake_row>,std::vector<token_row>,uint32_t> rows;
+            if(!chain.head_block_state()){
+                ilog("head block state is null");
+                return rows;
             }
+            resource_snapshot snapshot(chain);
+            std::get<0>(rows) = snapshot.take(accounts);
+            std::get<1>(rows) = snapshot.tokens(accounts, assets);
+            std::get<2>(rows) = chain.head_block_num();
+            return rows;
+        }, rows);
+
+        stakes = std::move(std::get<0>(rows));
+        tokens = std::move(std::get<1>(rows));
+        head_block_num = std::get<2>(rows);
+        return done;
+    }
 
-            staked = cpu_staked + net_staked;
-            total = staked + unstaking + liquid;
-
-            eosio::chain_apis::read_only::get_table_rows_params params1;
-            params1.code = name("eosio");
-            params1.scope = "eosio";
-            params1.limit = 1;
-            params1.lower_bound = account;
-            params1.table = name("voters");
-            params1.table_key = "owner";
-            params1.json = true;
-
-            eosio::chain_apis::read_only::get_table_rows_result result1 = ro_api.get_table_rows(params1);
-            if(result1.rows.size() == 1){
-                total_stake = result1.rows[0]["staked"].as_int64();
+    std::vector<token_asset> sql_database::load_token_assets(){
+        std::vector<token_asset> assets;
+        auto rows = m_actions_table->get_assets(m_session_pool->get_session());
+        for(auto it = rows.begin() ; it != rows.end(); it++){
+            try{
+                token_asset a;
+                a.contract = chain::name(it->get<string>(0));
+                a.symbol = it->get<string>(3);
+                a.symbol_code = chain::string_to_symbol(0, a.symbol.c_str()) >> 8;
+                assets.emplace_back(std::move(a));
+            } catch(fc::exception& e) {
+                wlog("skip asset ${c} ${s}: ${e}",("c",it->get<string>(0))("s",it->get<string>(3))("e",e.what()));
             }
+        }
+        return assets;
+    }
 
-            totalasset = total_stake + unstaking + liquid;
+    std::vector<token_asset> sql_database::token_assets(){
+        boost::mutex::scoped_lock lock(m_assets_mtx);
+        if( !m_token_assets_loaded || m_actions_table->m_assets_changed.exchange(false) ){
+            try{
+                m_token_assets = load_token_assets();
+                m_token_assets_loaded = true;
+            } catch(...) {
+                // loaded again on the next call
+                m_actions_table->m_assets_changed = true;
+                throw;
+            }
+        }
+        return m_token_assets;
+    }
+
+    int64_t sql_database::next_accounts(int64_t after_id, size_t limit, std::vector<chain::account_name>& accounts){
+        auto session = m_session_pool->get_session();
+        int64_t last_id = after_id;
+        int batch = limit;
+        soci::rowset<soci::row> rows = ( session->prepare << "select id, name from accounts where id > :id order by id limit :lt",
+            soci::use(after_id), soci::use(batch) );
+        for(auto it = rows.begin() ; it != rows.end(); it++){
+            last_id = it->get<long long>(0);
+            try{
+                accounts.emplace_back( chain::name(it->get<string>(1)) );
+            } catch(fc::exception& e) {
+                wlog("skip account ${n}",("n",it->get<string>(1)));
+            }
+        }
+        return last_id;
+    }
 
-            save_stake(account,liquid ,staked,unstaking,total,total_stake,totalasset,cpu_total,cpu_staked,cpu_delegated,cpu_used,cpu_available,cpu_limit,net_total,net_staked,net_delegated,net_used,net_available,net_limit,ram_quota,ram_usage);
+    void sql_database::save_stakes(const std::vector<stake_row>& rows){
+        const size_t rows_per_statement = 500;
+        auto session = m_session_pool->get_session();
 
+        for(size_t begin = 0; begin < rows.size(); begin += rows_per_statement){
+            std::string sql = "INSERT INTO stakes (account,liquid,staked,unstaking,total,total_stake,totalasset,cpu_total,cpu_staked,cpu_delegated,cpu_used,cpu_available,cpu_limit,net_total,net_staked,net_delegated,net_used,net_available,net_limit,ram_quota,ram_usage) VALUES ";
+            size_t end = std::min(rows.size(), begin + rows_per_statement);
+            for(size_t i = begin; i < end; i++){
+                const auto& r = rows[i];
+                if( i > begin ) sql += ",";
+                // account names only ever contain [a-z1-5.], no escaping needed
+                sql += "('" + r.account.to_string() + "'";
+                for(int64_t v : { r.liquid, r.staked, r.unstaking, r.total, r.total_stake, r.totalasset,
+                                  r.cpu_total, r.cpu_staked, r.cpu_delegated, r.cpu_used, r.cpu_available, r.cpu_limit,
+                                  r.net_total, r.net_staked, r.net_delegated, r.net_used, r.net_available, r.net_limit,
+                                  r.ram_quota, r.ram_usage }){
+                    sql += "," + std::to_string(v);
+                }
+                sql += ")";
+            }
+            sql += m_sink->upsert("account", stake_columns);
 
-        } catch(soci::mysql_soci_error e) {
-            wlog("update_stake::error: ${e}",("e",e.what()) );
-        } catch(std::exception e) {
-            wlog( "${e}",("e",e.what()) );
-        } catch(...) {
-            wlog("update_stake error");
+            try{
+                statement_timer stmt(*session, sql, "INSERT INTO stakes VALUES (...),...");
+                *session << stmt.sql();
+                stmt.done();
+            } catch(soci::mysql_soci_error e) {
+                wlog("soci::error: ${e}",("e",e.what()) );
+            } catch(std::exception e) {
+                wlog("save ${n} stakes failed: ${e}",("n",end - begin)("e",e.what()) );
+            } catch(...) {
+                wlog("save ${n} stakes failed",("n",end - begin));
+            }
         }
+    }
 
-        return true;
+    void sql_database::save_tokens(const std::vector<token_row>& rows){
+        const size_t rows_per_statement = 500;
+        auto session = m_session_pool->get_session();
 
-    }
+        for(size_t begin = 0; begin < rows.size(); begin += rows_per_statement){
+            std::string sql = "INSERT INTO tokens (account,symbol,balance,symbol_precision,contract_owner) VALUES ";
+            size_t end = std::min(rows.size(), begin + rows_per_statement);
+            for(size_t i = begin; i < end; i++){
+                const auto& r = rows[i];
+                if( i > begin ) sql += ",";
+                // names, symbols ([A-Z]) and formatted amounts never need escaping
+                sql += "('" + r.account.to_string() + "','" + r.symbol + "','" + r.balance + "',"
+                     + std::to_string(r.precision) + ",'" + r.contract.to_string() + "')";
+            }
+            sql += m_sink->upsert("account,symbol,contract_owner", token_columns);
 
-    void sql_database::save_stake(
-        std::string account,
-        int64_t liquid,
-        int64_t staked,
-        int64_t unstaking,
-        int64_t total,
-        int64_t total_stake,
-        int64_t totalasset,
-        int64_t cpu_total,
-        int64_t cpu_staked,
-        int64_t cpu_delegated,
-        int64_t cpu_used,
-        int64_t cpu_available,
-        int64_t cpu_limit,
-        int64_t net_total,
-        int64_t net_staked,
-        int64_t net_delegated,
-        int64_t net_used,
-        int64_t net_available,
-        int64_t net_limit,
-        int64_t ram_quota,
-        int64_t ram_usage
-        ){
-        
-            auto session = m_session_pool->get_session();
             try{
-                *session << "INSERT INTO stakes (account,liquid ,staked,unstaking,total,total_stake,totalasset,cpu_total,cpu_staked,cpu_delegated,cpu_used,cpu_available,cpu_limit,net_total,net_staked,net_delegated,net_used,net_available,net_limit,ram_quota,ram_usage)  VALUES( :account,:liquid ,:staked,:unstaking,:total,:total_stake,:totalasset,:cpu_total,:cpu_staked,:cpu_delegated,:cpu_used,:cpu_available,:cpu_limit,:net_total,:net_staked,:net_delegated,:net_used,:net_available,:net_limit,:ram_quota,:ram_usage ) ON DUPLICATE KEY UPDATE liquid=:liquid ,staked=:staked,unstaking=:unstaking,total=:total,total_stake=:total_stake,totalasset=:totalasset,cpu_total=:cpu_total,cpu_staked=:cpu_staked,cpu_delegated=:cpu_delegated,cpu_used=:cpu_used,cpu_available=:cpu_available,cpu_limit=:cpu_limit,net_total=:net_total,net_staked=:net_staked,net_delegated=:net_delegated,net_used=:net_used,net_available=:net_available,net_limit=:net_limit,ram_quota=:ram_quota,ram_usage=:ram_usage",
-                        soci::use(account),
-                        soci::use(liquid),
-                        soci::use(staked),
-                        soci::use(unstaking),
-                        soci::use(total),
-                        soci::use(total_stake),
-                        soci::use(totalasset),
-                        soci::use(cpu_total),
-                        soci::use(cpu_staked),
-                        soci::use(cpu_delegated),
-                        soci::use(cpu_used),
-                        soci::use(cpu_available),
-                        soci::use(cpu_limit),
-                        soci::use(net_total),
-                        soci::use(net_staked),
-                        soci::use(net_delegated),
-                        soci::use(net_used),
-                        soci::use(net_available),
-                        soci::use(net_limit),
-                        soci::use(ram_quota),
-                        soci::use(ram_usage),
-                        soci::use(liquid),
-                        soci::use(staked),
-                        soci::use(unstaking),
-                        soci::use(total),
-                        soci::use(total_stake),
-                        soci::use(totalasset),
-                        soci::use(cpu_total),
-                        soci::use(cpu_staked),
-                        soci::use(cpu_delegated),
-                        soci::use(cpu_used),
-                        soci::use(cpu_available),
-                        soci::use(cpu_limit),
-                        soci::use(net_total),
-                        soci::use(net_staked),
-                        soci::use(net_delegated),
-                        soci::use(net_used),
-                        soci::use(net_available),
-                        soci::use(net_limit),
-                        soci::use(ram_quota),
-                        soci::use(ram_usage);
-
+                statement_timer stmt(*session, sql, "INSERT INTO tokens VALUES (...),...");
+                *session << stmt.sql();
+                stmt.done();
             } catch(soci::mysql_soci_error e) {
                 wlog("soci::error: ${e}",("e",e.what()) );
             } catch(std::exception e) {
-                wlog(" ${account} ${liquid}",("account",account)("liquid",liquid));
-                wlog( "${e}",("e",e.what()) );
+                wlog("save ${n} tokens failed: ${e}",("n",end - begin)("e",e.what()) );
             } catch(...) {
-                wlog(" ${account} ${liquid}",("account",account)("liquid",liquid));
-            }  
+                wlog("save ${n} tokens failed",("n",end - begin));
+            }
+        }
     }
 
-    void sql_database::save_token(std::string account,std::string symbol,std::string quantity,int precision,std::string contract){
+    bool sql_database::refresh_accounts(const std::vector<chain::account_name>& accounts, bool retry){
+        if(accounts.empty()) return true;
 
-        auto session = m_session_pool->get_session();
         try{
-            *session << "INSERT INTO tokens (account,symbol ,balance,symbol_precision,contract_owner)  VALUES( :account, :symbol , :balance , :symbol_precision , :contract_owner ) ON DUPLICATE KEY UPDATE balance=:balance,symbol_precision=:symbol_precision",
-                    soci::use(account),
-                    soci::use(symbol),
-                    soci::use(quantity),
-                    soci::use(precision),
-                    soci::use(contract),
-                    soci::use(quantity),
-                    soci::use(precision);
-
-        } catch(soci::mysql_soci_error e) {
-            wlog("soci::error: ${e}",("e",e.what()) );
-        } catch(std::exception e) {
-            wlog(" ${account} ${symbol}",("account",account)("symbol",symbol));
+            std::vector<stake_row> stakes;
+            std::vector<token_row> tokens;
+            uint32_t head_block_num = 0;
+            auto assets = token_assets();
+            if(snapshot_accounts(accounts, assets, stakes, tokens, head_block_num)){
+                save_tokens(tokens);
+                save_stakes(stakes);
+                if( retry ) m_dirty_accounts->refreshed(accounts);
+                return true;
+            }
+        } catch(fc::exception& e) {
+            wlog("refresh_accounts::error: ${e}",("e",e.what()) );
+        } catch(std::exception& e) {
             wlog( "${e}",("e",e.what()) );
         } catch(...) {
-            wlog(" ${account} ${symbol}",("account",account)("symbol",symbol));
-        }               
-    }
-
-    bool sql_database::monitoraccount(int accountid){
-
-        bool flag = true;
-        auto ro_api = app().get_plugin<chain_plugin>().get_read_only_api();
-
-        std::string acc_name;
-        auto session = m_session_pool->get_session();
-
-        *session << "select name from accounts where id=:id ", 
-             soci::use(accountid),soci::into(acc_name);
-
-        if(acc_name.empty()){
-            return true;
+            wlog("refresh_accounts error");
         }
-               
-            
-        flag = update_token(acc_name);
-        flag = update_stake(acc_name);
-
-
-        return flag;
 
+        // drained already, they are refreshed with a later batch. the sweep comes back to
+        // its accounts anyway
+        if( retry ){
+            if( auto given_up = m_dirty_accounts->retry(accounts) ){
+                wlog("${n} accounts not refreshed after ${a} attempts, left to the sweep", ("n", given_up)("a", uint32_t(dirty_accounts::max_attempts)));
+            }
+        }
+        return false;
     }
 
 } // namespace
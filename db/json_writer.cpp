@@ -0,0 +1,387 @@
+#include <eosio/sql_db_plugin/json_writer.hpp>
+#include <eosio/sql_db_plugin/name_format.hpp>
+
+#include <eosio/chain/asset.hpp>
+#include <eosio/chain/block_timestamp.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+
+#include <unordered_map>
+
+namespace eosio {
+
+    void json_writer::separator() {
+        if( m_after_key ){
+            m_after_key = false;
+            return;
+        }
+        if( m_levels.empty() ) return;
+        if( m_levels.back() ) m_out += ',';
+        m_levels.back() = true;
+    }
+
+    json_writer& json_writer::begin_object() {
+        separator();
+        m_out += '{';
+        m_levels.push_back(false);
+        return *this;
+    }
+
+    json_writer& json_writer::end_object() {
+        m_out += '}';
+        m_levels.pop_back();
+        return *this;
+    }
+
+    json_writer& json_writer::begin_array() {
+        separator();
+        m_out += '[';
+        m_levels.push_back(false);
+        return *this;
+    }
+
+    json_writer& json_writer::end_array() {
+        m_out += ']';
+        m_levels.pop_back();
+        return *this;
+    }
+
+    json_writer& json_writer::key( const char* k, size_t size ) {
+        separator();
+        escaped(k, size);
+        m_out += ':';
+        m_after_key = true;
+        return *this;
+    }
+
+    void json_writer::escaped( const char* s, size_t size ) {
+        // printable ascii without quotes or backslashes is written as is by fc too
+        for(size_t i = 0; i < size; i++){
+            uint8_t c = uint8_t(s[i]);
+            if( c < 0x20 || c >= 0x7f || c == '"' || c == '\\' ){
+                m_out += fc::json::to_string( fc::variant(std::string(s, size)) );
+                return;
+            }
+        }
+        m_out += '"';
+        m_out.append(s, size);
+        m_out += '"';
+    }
+
+    json_writer& json_writer::string( const char* s, size_t size ) {
+        separator();
+        escaped(s, size);
+        return *this;
+    }
+
+    json_writer& json_writer::int64( int64_t v ) {
+        separator();
+        // fc quotes the integers above 32 bits, the negative ones are never quoted
+        if( v > 0xffffffffll ) m_out += '"';
+        m_out += std::to_string(v);
+        if( v > 0xffffffffll ) m_out += '"';
+        return *this;
+    }
+
+    json_writer& json_writer::uint64( uint64_t v ) {
+        separator();
+        if( v > 0xffffffffull ) m_out += '"';
+        m_out += std::to_string(v);
+        if( v > 0xffffffffull ) m_out += '"';
+        return *this;
+    }
+
+    json_writer& json_writer::boolean( bool v ) {
+        separator();
+        m_out += v ? "true" : "false";
+        return *this;
+    }
+
+    json_writer& json_writer::null() {
+        separator();
+        m_out += "null";
+        return *this;
+    }
+
+    json_writer& json_writer::variant( const fc::variant& v ) {
+        switch( v.get_type() ){
+            case fc::variant::null_type:   return null();
+            case fc::variant::bool_type:   return boolean(v.as_bool());
+            case fc::variant::int64_type:  return int64(v.as_int64());
+            case fc::variant::uint64_type: return uint64(v.as_uint64());
+            case fc::variant::string_type: return string(v.get_string());
+            case fc::variant::array_type:
+                begin_array();
+                for(const auto& e : v.get_array()) variant(e);
+                return end_array();
+            case fc::variant::object_type:
+                begin_object();
+                for(const auto& e : v.get_object()){
+                    key(e.key());
+                    variant(e.value());
+                }
+                return end_object();
+            default:
+                // doubles and blobs
+                separator();
+                m_out += fc::json::to_string(v);
+                return *this;
+        }
+    }
+
+    namespace {
+
+        enum class builtin {
+            boolean, int8, uint8, int16, uint16, int32, uint32, int64, uint64, varint32, varuint32,
+            float32, float64, name, string, bytes, asset, symbol, checksum160, checksum256, checksum512,
+            public_key, signature, time_point, time_point_sec, block_timestamp_type, extended_asset
+        };
+
+        const std::unordered_map<std::string, builtin>& builtins() {
+            static const std::unordered_map<std::string, builtin> types = {
+                {"bool", builtin::boolean}, {"int8", builtin::int8}, {"uint8", builtin::uint8},
+                {"int16", builtin::int16}, {"uint16", builtin::uint16}, {"int32", builtin::int32},
+                {"uint32", builtin::uint32}, {"int64", builtin::int64}, {"uint64", builtin::uint64},
+                {"varint32", builtin::varint32}, {"varuint32", builtin::varuint32},
+                {"float32", builtin::float32}, {"float64", builtin::float64},
+                {"name", builtin::name}, {"account_name", builtin::name}, {"permission_name", builtin::name},
+                {"action_name", builtin::name}, {"table_name", builtin::name}, {"scope_name", builtin::name},
+                {"string", builtin::string}, {"bytes", builtin::bytes}, {"asset", builtin::asset},
+                {"symbol", builtin::symbol}, {"checksum160", builtin::checksum160},
+                {"checksum256", builtin::checksum256}, {"checksum512", builtin::checksum512},
+                {"public_key", builtin::public_key}, {"signature", builtin::signature},
+                {"time_point", builtin::time_point}, {"time_point_sec", builtin::time_point_sec},
+                {"block_timestamp_type", builtin::block_timestamp_type}, {"extended_asset", builtin::extended_asset},
+            };
+            return types;
+        }
+
+        template<typename T>
+        bool unpack_value( const char*& pos, const char* end, T& v ) {
+            try{
+                fc::datastream<const char*> ds(pos, size_t(end - pos));
+                fc::raw::unpack(ds, v);
+                pos += ds.tellp();
+                return true;
+            } catch(...) {
+                return false;
+            }
+        }
+
+        // the types with no shortcut go through a variant of their own, not of the action
+        template<typename T>
+        bool write_as_variant( const char*& pos, const char* end, json_writer* out ) {
+            T v;
+            if( !unpack_value(pos, end, v) ) return false;
+            if( out ){
+                fc::variant var;
+                fc::to_variant(v, var);
+                out->variant(var);
+            }
+            return true;
+        }
+
+        template<typename T>
+        bool write_integer( const char*& pos, const char* end, json_writer* out ) {
+            T v;
+            if( !unpack_value(pos, end, v) ) return false;
+            if( out ){
+                if( std::is_signed<T>::value ) out->int64(int64_t(v));
+                else out->uint64(uint64_t(v));
+            }
+            return true;
+        }
+
+        const int max_depth = 32;
+    }
+
+    json_abi::json_abi( const chain::abi_def& abi ) {
+        for(const auto& t : abi.types) m_typedefs[t.new_type_name] = t.type;
+        for(const auto& s : abi.structs) m_structs[s.name] = s;
+        for(const auto& a : abi.actions) m_actions[a.name] = a.type;
+    }
+
+    const std::string& json_abi::resolve( const std::string& type ) const {
+        const std::string* t = &type;
+        for(int i = 0; i < max_depth; i++){
+            auto itr = m_typedefs.find(*t);
+            if( itr == m_typedefs.end() ) break;
+            t = &itr->second;
+        }
+        return *t;
+    }
+
+    const chain::struct_def* json_abi::find_struct( const std::string& type ) const {
+        auto itr = m_structs.find(resolve(type));
+        return itr == m_structs.end() ? nullptr : &itr->second;
+    }
+
+    bool json_abi::write_action( chain::name action, const char* data, size_t size, json_writer& out ) const {
+        auto act = m_actions.find(action);
+        if( act == m_actions.end() ) return false;
+        const char* pos = data;
+        return write_type(act->second, pos, data + size, &out, 0);
+    }
+
+    bool json_abi::write_field( chain::name action, const char* data, size_t size, const std::string& field, json_writer& out ) const {
+        auto act = m_actions.find(action);
+        if( act == m_actions.end() ) return false;
+        const auto* s = find_struct(act->second);
+        if( !s ) return false;
+
+        // the fields before it are only skipped
+        const char* pos = data;
+        const chain::field_def* found = nullptr;
+        if( !seek_field(*s, pos, data + size, field, found, 0) || !found ) return false;
+        return write_type(found->type, pos, data + size, &out, 1);
+    }
+
+    bool json_abi::write_struct( const chain::struct_def& s, const char*& pos, const char* end, json_writer* out, int depth ) const {
+        if( depth > max_depth ) return false;
+
+        // the fields of the base come first, in the same object
+        if( !s.base.empty() ){
+            const auto* base = find_struct(s.base);
+            if( !base || !write_struct(*base, pos, end, out, depth + 1) ) return false;
+        }
+        for(const auto& f : s.fields){
+            if( out ) out->key(f.name);
+            if( !write_type(f.type, pos, end, out, depth + 1) ) return false;
+        }
+        return true;
+    }
+
+    bool json_abi::seek_field( const chain::struct_def& s, const char*& pos, const char* end, const std::string& field, const chain::field_def*& found, int depth ) const {
+        if( depth > max_depth ) return false;
+
+        if( !s.base.empty() ){
+            const auto* base = find_struct(s.base);
+            if( !base || !seek_field(*base, pos, end, field, found, depth + 1) ) return false;
+            if( found ) return true;
+        }
+        for(const auto& f : s.fields){
+            if( f.name == field ){
+                found = &f;
+                return true;
+            }
+            if( !write_type(f.type, pos, end, nullptr, depth + 1) ) return false;
+        }
+        return true;
+    }
+
+    bool json_abi::write_type( const std::string& type, const char*& pos, const char* end, json_writer* out, int depth ) const {
+        if( depth > max_depth ) return false;
+        const auto& rtype = resolve(type);
+
+        if( rtype.size() > 2 && rtype.compare(rtype.size() - 2, 2, "[]") == 0 ){
+            fc::unsigned_int count;
+            if( !unpack_value(pos, end, count) ) return false;
+            // every element takes at least a byte
+            if( count.value > size_t(end - pos) ) return false;
+            const std::string element = rtype.substr(0, rtype.size() - 2);
+            if( out ) out->begin_array();
+            for(uint32_t i = 0; i < count.value; i++){
+                if( !write_type(element, pos, end, out, depth + 1) ) return false;
+            }
+            if( out ) out->end_array();
+            return true;
+        }
+
+        if( rtype.size() > 1 && rtype.back() == '?' ){
+            uint8_t present = 0;
+            if( !unpack_value(pos, end, present) ) return false;
+            if( !present ){
+                if( out ) out->null();
+                return true;
+            }
+            return write_type(rtype.substr(0, rtype.size() - 1), pos, end, out, depth + 1);
+        }
+
+        bool known = false;
+        if( !write_builtin(rtype, pos, end, out, known) ) return false;
+        if( known ) return true;
+
+        const auto* s = find_struct(rtype);
+        if( !s ) return false;
+        if( out ) out->begin_object();
+        if( !write_struct(*s, pos, end, out, depth + 1) ) return false;
+        if( out ) out->end_object();
+        return true;
+    }
+
+    bool json_abi::write_builtin( const std::string& type, const char*& pos, const char* end, json_writer* out, bool& known ) const {
+        auto itr = builtins().find(type);
+        known = itr != builtins().end();
+        if( !known ) return true;
+
+        switch( itr->second ){
+            case builtin::boolean: {
+                bool v;
+                if( !unpack_value(pos, end, v) ) return false;
+                if( out ) out->boolean(v);
+                return true;
+            }
+            case builtin::int8:      return write_integer<int8_t>(pos, end, out);
+            case builtin::uint8:     return write_integer<uint8_t>(pos, end, out);
+            case builtin::int16:     return write_integer<int16_t>(pos, end, out);
+            case builtin::uint16:    return write_integer<uint16_t>(pos, end, out);
+            case builtin::int32:     return write_integer<int32_t>(pos, end, out);
+            case builtin::uint32:    return write_integer<uint32_t>(pos, end, out);
+            case builtin::int64:     return write_integer<int64_t>(pos, end, out);
+            case builtin::uint64:    return write_integer<uint64_t>(pos, end, out);
+            case builtin::varint32: {
+                fc::signed_int v;
+                if( !unpack_value(pos, end, v) ) return false;
+                if( out ) out->int64(v.value);
+                return true;
+            }
+            case builtin::varuint32: {
+                fc::unsigned_int v;
+                if( !unpack_value(pos, end, v) ) return false;
+                if( out ) out->uint64(v.value);
+                return true;
+            }
+            case builtin::float32:   return write_as_variant<float>(pos, end, out);
+            case builtin::float64:   return write_as_variant<double>(pos, end, out);
+            case builtin::name: {
+                uint64_t v;
+                if( !unpack_value(pos, end, v) ) return false;
+                if( out ){
+                    char buf[max_name_chars];
+                    out->string(buf, format_name(v, buf));
+                }
+                return true;
+            }
+            case builtin::string: {
+                fc::unsigned_int size;
+                if( !unpack_value(pos, end, size) || size.value > size_t(end - pos) ) return false;
+                if( out ) out->string(pos, size.value);
+                pos += size.value;
+                return true;
+            }
+            case builtin::asset: {
+                chain::asset v;
+                if( !unpack_value(pos, end, v) ) return false;
+                if( out ){
+                    char buf[max_asset_chars];
+                    out->string(buf, format_asset(v, buf));
+                }
+                return true;
+            }
+            case builtin::bytes:                return write_as_variant<chain::bytes>(pos, end, out);
+            case builtin::symbol:               return write_as_variant<chain::symbol>(pos, end, out);
+            case builtin::checksum160:          return write_as_variant<chain::checksum160_type>(pos, end, out);
+            case builtin::checksum256:          return write_as_variant<chain::checksum256_type>(pos, end, out);
+            case builtin::checksum512:          return write_as_variant<chain::checksum512_type>(pos, end, out);
+            case builtin::public_key:           return write_as_variant<chain::public_key_type>(pos, end, out);
+            case builtin::signature:            return write_as_variant<chain::signature_type>(pos, end, out);
+            case builtin::time_point:           return write_as_variant<fc::time_point>(pos, end, out);
+            case builtin::time_point_sec:       return write_as_variant<fc::time_point_sec>(pos, end, out);
+            case builtin::block_timestamp_type: return write_as_variant<chain::block_timestamp_type>(pos, end, out);
+            case builtin::extended_asset:       return write_as_variant<chain::extended_asset>(pos, end, out);
+        }
+        return false;
+    }
+
+} // namespace
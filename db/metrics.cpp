@@ -0,0 +1,149 @@
+#include <eosio/sql_db_plugin/metrics.hpp>
+
+#include <sstream>
+
+namespace eosio {
+
+    latency_histogram::latency_histogram():total_count(0),total_sum(0),max_value(0) {
+        for(auto& c : counts) c.store(0, std::memory_order_relaxed);
+    }
+
+    int latency_histogram::bucket_of( uint64_t value ) {
+        if( value < sub_buckets ) return static_cast<int>(value);
+        int msb = 63 - __builtin_clzll(value);
+        int shift = msb - sub_bucket_bits;
+        return (shift + 1) * sub_buckets + static_cast<int>((value >> shift) & (sub_buckets - 1));
+    }
+
+    uint64_t latency_histogram::bucket_upper_bound( int bucket ) {
+        if( bucket < sub_buckets ) return bucket;
+        int shift = bucket / sub_buckets - 1;
+        uint64_t sub = bucket % sub_buckets;
+        return ((sub_buckets + sub + 1) << shift) - 1;
+    }
+
+    void latency_histogram::record( uint64_t value ) {
+        counts[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        total_count.fetch_add(1, std::memory_order_relaxed);
+        total_sum.fetch_add(value, std::memory_order_relaxed);
+
+        uint64_t current = max_value.load(std::memory_order_relaxed);
+        while( value > current && !max_value.compare_exchange_weak(current, value, std::memory_order_relaxed) );
+    }
+
+    uint64_t latency_histogram::percentile( double p ) const {
+        uint64_t total = count();
+        if( total == 0 ) return 0;
+
+        uint64_t rank = static_cast<uint64_t>(p / 100.0 * total);
+        if( rank == 0 ) rank = 1;
+        uint64_t seen = 0;
+        for(int i = 0; i < bucket_count; i++){
+            seen += counts[i].load(std::memory_order_relaxed);
+            if( seen >= rank ) return std::min(bucket_upper_bound(i), max());
+        }
+        return max();
+    }
+
+    const char* to_string( ingest_stage s ) {
+        switch( s ) {
+            case ingest_stage::unpack:      return "unpack";
+            case ingest_stage::abi_resolve: return "abi_resolve";
+            case ingest_stage::decode:      return "decode";
+            case ingest_stage::sql_execute: return "sql_execute";
+            case ingest_stage::block:       return "block";
+            case ingest_stage::pool_wait:   return "pool_wait";
+            case ingest_stage::commit:      return "commit";
+            default:                        return "unknown";
+        }
+    }
+
+    sql_db_metrics& metrics() {
+        static sql_db_metrics instance;
+        return instance;
+    }
+
+    fc::variant_object sql_db_metrics::status() const {
+        fc::mutable_variant_object stage_obj;
+        for(int i = 0; i < static_cast<int>(ingest_stage::stage_count); i++){
+            const auto& h = stages[i];
+            stage_obj( to_string(static_cast<ingest_stage>(i)), fc::mutable_variant_object()
+                ("count", h.count())
+                ("sum_us", h.sum())
+                ("max_us", h.max())
+                ("p50_us", h.percentile(50))
+                ("p90_us", h.percentile(90))
+                ("p99_us", h.percentile(99)) );
+        }
+
+        fc::mutable_variant_object action_obj;
+        actions.for_each([&]( const std::pair<uint64_t,uint64_t>& key, uint64_t n ){
+            action_obj( key.first == 0 ? std::string("other") : chain::name(key.first).to_string() + "::" + chain::name(key.second).to_string(), n );
+        });
+
+        fc::mutable_variant_object table_obj;
+        tables.for_each([&]( const std::string& key, uint64_t n ){
+            table_obj( key, n );
+        });
+
+        uint32_t head = head_block.load();
+        uint32_t indexed = indexed_block.load();
+
+        return fc::mutable_variant_object()
+            ("head_block", head)
+            ("indexed_block", indexed)
+            ("lag_blocks", head > indexed ? head - indexed : 0)
+            ("irreversible_block", irreversible_block.load())
+            ("queue_depth", queue_depth.load())
+            ("queue_bytes", queue_bytes.load())
+            ("blocks", blocks.load())
+            ("pool_waits", pool_waits.load())
+            ("stages", stage_obj)
+            ("actions", action_obj)
+            ("tables", table_obj);
+    }
+
+    std::string sql_db_metrics::prometheus() const {
+        std::ostringstream out;
+        uint32_t head = head_block.load();
+        uint32_t indexed = indexed_block.load();
+
+        out << "# TYPE sql_db_head_block gauge\n" << "sql_db_head_block " << head << "\n";
+        out << "# TYPE sql_db_indexed_block gauge\n" << "sql_db_indexed_block " << indexed << "\n";
+        out << "# TYPE sql_db_lag_blocks gauge\n" << "sql_db_lag_blocks " << (head > indexed ? head - indexed : 0) << "\n";
+        out << "# TYPE sql_db_irreversible_block gauge\n" << "sql_db_irreversible_block " << irreversible_block.load() << "\n";
+        out << "# TYPE sql_db_queue_depth gauge\n" << "sql_db_queue_depth " << queue_depth.load() << "\n";
+        out << "# TYPE sql_db_queue_bytes gauge\n" << "sql_db_queue_bytes " << queue_bytes.load() << "\n";
+        out << "# TYPE sql_db_blocks_total counter\n" << "sql_db_blocks_total " << blocks.load() << "\n";
+        out << "# TYPE sql_db_pool_waits_total counter\n" << "sql_db_pool_waits_total " << pool_waits.load() << "\n";
+
+        out << "# TYPE sql_db_stage_microseconds summary\n";
+        for(int i = 0; i < static_cast<int>(ingest_stage::stage_count); i++){
+            const auto& h = stages[i];
+            const char* name = to_string(static_cast<ingest_stage>(i));
+            for(double q : {0.5, 0.9, 0.99}){
+                out << "sql_db_stage_microseconds{stage=\"" << name << "\",quantile=\"" << q << "\"} " << h.percentile(q * 100) << "\n";
+            }
+            out << "sql_db_stage_microseconds_sum{stage=\"" << name << "\"} " << h.sum() << "\n";
+            out << "sql_db_stage_microseconds_count{stage=\"" << name << "\"} " << h.count() << "\n";
+        }
+
+        out << "# TYPE sql_db_actions_total counter\n";
+        actions.for_each([&]( const std::pair<uint64_t,uint64_t>& key, uint64_t n ){
+            if( key.first == 0 ){
+                out << "sql_db_actions_total{account=\"other\",action=\"other\"} " << n << "\n";
+                return;
+            }
+            out << "sql_db_actions_total{account=\"" << chain::name(key.first).to_string()
+                << "\",action=\"" << chain::name(key.second).to_string() << "\"} " << n << "\n";
+        });
+
+        out << "# TYPE sql_db_table_rows_total counter\n";
+        tables.for_each([&]( const std::string& key, uint64_t n ){
+            out << "sql_db_table_rows_total{table=\"" << key << "\"} " << n << "\n";
+        });
+
+        return out.str();
+    }
+
+} // namespace
@@ -0,0 +1,162 @@
+#include <eosio/sql_db_plugin/name_format.hpp>
+
+#include <boost/thread/mutex.hpp>
+
+#include <array>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+
+namespace eosio {
+
+    namespace {
+
+        const char name_chars[] = ".12345abcdefghijklmnopqrstuvwxyz";
+
+        // character -> 5 bit value of a name, 0xff for the characters a name can not hold
+        struct name_char_table {
+            uint8_t values[256];
+
+            name_char_table() {
+                std::memset(values, 0xff, sizeof(values));
+                for(uint8_t i = 0; i < 32; i++) values[uint8_t(name_chars[i])] = i;
+            }
+        };
+        const name_char_table name_values;
+
+        const char digit_pairs[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+
+        // writes the digits of v ending at end, returns the first digit
+        char* write_digits( uint64_t v, char* end ) {
+            while( v >= 100 ){
+                auto pair = (v % 100) * 2;
+                v /= 100;
+                *--end = digit_pairs[pair + 1];
+                *--end = digit_pairs[pair];
+            }
+            if( v >= 10 ){
+                *--end = digit_pairs[v * 2 + 1];
+                *--end = digit_pairs[v * 2];
+            } else {
+                *--end = char('0' + v);
+            }
+            return end;
+        }
+    }
+
+    size_t format_name( uint64_t value, char* out ) {
+        if( value == 0 ) return 0;
+
+        for(int i = 0; i < 12; i++){
+            out[i] = name_chars[(value >> (59 - 5 * i)) & 0x1f];
+        }
+        out[12] = name_chars[value & 0x0f];
+
+        // the trailing dots are the trailing zero bits
+        if( value & 0x0f ) return 13;
+        return 12 - __builtin_ctzll(value >> 4) / 5;
+    }
+
+    bool parse_name( const char* s, size_t size, uint64_t& value ) {
+        if( size > max_name_chars ) return false;
+
+        uint64_t v = 0;
+        uint8_t bad = 0;
+        const size_t head = size < 12 ? size : 12;
+        for(size_t i = 0; i < head; i++){
+            uint8_t c = name_values.values[uint8_t(s[i])];
+            bad |= c;
+            v |= uint64_t(c & 0x1f) << (59 - 5 * i);
+        }
+        if( size == 13 ){
+            uint8_t c = name_values.values[uint8_t(s[12])];
+            // the last character has 4 bits, up to 'j'
+            bad |= c | (c & 0x10 ? 0xff : 0);
+            v |= c & 0x0f;
+        }
+        // 0xff marks an invalid character and a trailing dot is not a normalized name
+        if( bad == 0xff || (size > 0 && s[size - 1] == '.') ) return false;
+
+        value = v;
+        return true;
+    }
+
+    size_t format_asset_amount( int64_t amount, uint8_t decimals, char* out ) {
+        char digits[24];
+        char* end = digits + sizeof(digits);
+        uint64_t magnitude = amount < 0 ? 0 - uint64_t(amount) : uint64_t(amount);
+        char* first = write_digits(magnitude, end);
+
+        // at least one digit before the point
+        while( end - first < decimals + 1 ) *--first = '0';
+
+        char* pos = out;
+        if( amount < 0 ) *pos++ = '-';
+        size_t whole = size_t(end - first) - decimals;
+        std::memcpy(pos, first, whole);
+        pos += whole;
+        if( decimals ){
+            *pos++ = '.';
+            std::memcpy(pos, first + whole, decimals);
+            pos += decimals;
+        }
+        return size_t(pos - out);
+    }
+
+    size_t format_asset( const chain::asset& a, char* out ) {
+        size_t size = format_asset_amount(a.get_amount(), a.decimals(), out);
+        out[size++] = ' ';
+        for(uint64_t sym = a.get_symbol().value() >> 8; sym & 0xff; sym >>= 8){
+            out[size++] = char(sym & 0xff);
+        }
+        return size;
+    }
+
+    namespace {
+
+        class name_cache {
+            public:
+                name_cache() {
+                    for(auto n : { N(eosio), N(eosio.token), N(eosio.msig), N(transfer), N(issue), N(newaccount),
+                                   N(setabi), N(setcode), N(voteproducer), N(delegatebw), N(undelegatebw),
+                                   N(buyram), N(buyrambytes), N(sellram), N(regproducer), N(onblock),
+                                   N(active), N(owner) }){
+                        get( chain::name(n) );
+                    }
+                }
+
+                const std::string& get( chain::name n ) {
+                    boost::mutex::scoped_lock lock(mtx);
+                    auto& s = names[n.value];
+                    if( !s ) s = std::make_unique<const std::string>( name_string(n) );
+                    return *s;
+                }
+
+            private:
+                boost::mutex mtx;
+                std::unordered_map<uint64_t, std::unique_ptr<const std::string>> names;
+        };
+
+        name_cache& interned_names() {
+            static name_cache cache;
+            return cache;
+        }
+    }
+
+    const std::string& interned_name( chain::name n ) {
+        // a per thread direct mapped front keeps the lock off the hot names
+        struct slot { uint64_t value; const std::string* str; };
+        thread_local std::array<slot, 256> front{};
+
+        auto& s = front[(n.value * 0x9e3779b97f4a7c15ull) >> 56];
+        if( s.str && s.value == n.value ) return *s.str;
+
+        const auto& str = interned_names().get(n);
+        s = slot{ n.value, &str };
+        return str;
+    }
+
+} // namespace
@@ -0,0 +1,332 @@
+#include <eosio/sql_db_plugin/sql_sink.hpp>
+#include <eosio/sql_db_plugin/sql_profiler.hpp>
+
+#include <soci/postgresql/soci-postgresql.h>
+#include <libpq-fe.h>
+
+#include <fc/crypto/hex.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+
+#include <chrono>
+
+namespace eosio {
+
+    namespace {
+
+        // microseconds between the unix and the postgres epoch (2000-01-01)
+        const int64_t postgres_epoch_us = 946684800LL * 1000000;
+
+        const char copy_header[] = "PGCOPY\n\377\r\n\0\0\0\0\0\0\0\0\0";
+
+        void put16( std::string& out, int16_t v ) {
+            out.push_back(char((v >> 8) & 0xff));
+            out.push_back(char(v & 0xff));
+        }
+
+        void put32( std::string& out, int32_t v ) {
+            for(int shift = 24; shift >= 0; shift -= 8) out.push_back(char((v >> shift) & 0xff));
+        }
+
+        void put64( std::string& out, int64_t v ) {
+            for(int shift = 56; shift >= 0; shift -= 8) out.push_back(char((uint64_t(v) >> shift) & 0xff));
+        }
+
+        bool exec( PGconn* conn, const std::string& sql ) {
+            PGresult* res = PQexec(conn, sql.c_str());
+            bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+            if( !ok ) elog("${s} failed: ${e}", ("s", sql)("e", PQerrorMessage(conn)));
+            PQclear(res);
+            return ok;
+        }
+
+        // sends one binary COPY, false with the error logged when the server refused it
+        bool copy_in( PGconn* conn, const std::string& copy, const std::string& table, const std::string& data ) {
+            PGresult* res = PQexec(conn, copy.c_str());
+            if( PQresultStatus(res) != PGRES_COPY_IN ){
+                elog("COPY ${t} failed: ${e}", ("t", table)("e", PQerrorMessage(conn)));
+                PQclear(res);
+                return false;
+            }
+            PQclear(res);
+            bool ok = PQputCopyData(conn, data.data(), int(data.size())) == 1;
+            ok = PQputCopyEnd(conn, ok ? nullptr : "put copy data failed") == 1 && ok;
+            while( (res = PQgetResult(conn)) != nullptr ){
+                if( PQresultStatus(res) != PGRES_COMMAND_OK ){
+                    if( ok ) elog("COPY ${t} failed: ${e}", ("t", table)("e", PQerrorMessage(conn)));
+                    ok = false;
+                }
+                PQclear(res);
+            }
+            return ok;
+        }
+
+        PGconn* connection( soci::session& sql ) {
+            auto backend = dynamic_cast<soci::postgresql_session_backend*>(sql.get_backend());
+            FC_ASSERT( backend != nullptr, "postgresql sink used on a ${b} session", ("b", sql.get_backend_name()) );
+            return backend->conn_;
+        }
+
+        // the name columns of the event tables, bigint before they were text
+        const std::pair<const char*, const char*> name_columns[] = {
+            {"votes", "voter"}, {"votes", "proxy"}, {"buyram", "payer"}, {"buyram", "receiver"}, {"sellram", "account"},
+            {"delegatebw", "frm_acc"}, {"delegatebw", "receiver"}, {"undelegatebw", "frm_acc"}, {"undelegatebw", "receiver"},
+            {"regproducer", "producer"}, {"transfer", "frm_acc"}, {"transfer", "to_acc"} };
+
+        // eos.sql and sql_change.sql in postgres types. the upsert targets are unique
+        // like in MySQL, the event tables store ids as bytea.
+        const char* schema[] = {
+            "CREATE TABLE IF NOT EXISTS accounts (id BIGSERIAL PRIMARY KEY, name VARCHAR(16) NOT NULL DEFAULT '' UNIQUE, abi TEXT, "
+                "created_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, updated_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP)",
+            "CREATE TABLE IF NOT EXISTS accounts_keys (id BIGSERIAL PRIMARY KEY, account VARCHAR(16) NOT NULL DEFAULT '', "
+                "public_key VARCHAR(64) NOT NULL DEFAULT '', permission VARCHAR(16) NOT NULL DEFAULT '')",
+            "CREATE INDEX IF NOT EXISTS accounts_keys_account ON accounts_keys (account)",
+            // the keys written twice by a replayed newaccount before they were unique
+            "DELETE FROM accounts_keys WHERE id NOT IN (SELECT MIN(id) FROM accounts_keys GROUP BY account, permission, public_key)",
+            "CREATE UNIQUE INDEX IF NOT EXISTS accounts_keys_key ON accounts_keys (account, permission, public_key)",
+            "CREATE TABLE IF NOT EXISTS assets (id BIGSERIAL PRIMARY KEY, supply BIGINT NOT NULL DEFAULT 0, max_supply BIGINT NOT NULL DEFAULT 0, "
+                "symbol_precision INT NOT NULL DEFAULT 0, symbol VARCHAR(16) NOT NULL DEFAULT '', issuer VARCHAR(16) NOT NULL DEFAULT '', "
+                "contract_owner VARCHAR(16) NOT NULL DEFAULT '', logo_url VARCHAR(200) NOT NULL DEFAULT '', UNIQUE (symbol, contract_owner))",
+            "CREATE TABLE IF NOT EXISTS blocks (id BIGSERIAL PRIMARY KEY, block_id VARCHAR(64) NOT NULL DEFAULT '' UNIQUE, "
+                "block_number BIGINT NOT NULL DEFAULT 0, prev_block_id VARCHAR(64) NOT NULL DEFAULT '', irreversible BOOLEAN NOT NULL DEFAULT FALSE, "
+                "timestamp TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, transaction_merkle_root VARCHAR(64) NOT NULL DEFAULT '', "
+                "action_merkle_root VARCHAR(64) NOT NULL DEFAULT '', producer VARCHAR(16) NOT NULL DEFAULT '', version INT NOT NULL DEFAULT 0, "
+                "new_producers TEXT, num_transactions INT NOT NULL DEFAULT 0, confirmed INT NOT NULL DEFAULT 0)",
+            "CREATE INDEX IF NOT EXISTS blocks_block_number ON blocks (block_number)",
+            "CREATE TABLE IF NOT EXISTS stakes (id BIGSERIAL PRIMARY KEY, account VARCHAR(16) NOT NULL DEFAULT '' UNIQUE, "
+                "liquid BIGINT NOT NULL DEFAULT 0, staked BIGINT NOT NULL DEFAULT 0, unstaking BIGINT NOT NULL DEFAULT 0, total BIGINT NOT NULL DEFAULT 0, "
+                "total_stake BIGINT NOT NULL DEFAULT 0, totalasset BIGINT NOT NULL DEFAULT 0, "
+                "cpu_total BIGINT NOT NULL DEFAULT 0, cpu_staked BIGINT NOT NULL DEFAULT 0, cpu_delegated BIGINT NOT NULL DEFAULT 0, "
+                "cpu_used BIGINT NOT NULL DEFAULT 0, cpu_available BIGINT NOT NULL DEFAULT 0, cpu_limit BIGINT NOT NULL DEFAULT 0, "
+                "net_total BIGINT NOT NULL DEFAULT 0, net_staked BIGINT NOT NULL DEFAULT 0, net_delegated BIGINT NOT NULL DEFAULT 0, "
+                "net_used BIGINT NOT NULL DEFAULT 0, net_available BIGINT NOT NULL DEFAULT 0, net_limit BIGINT NOT NULL DEFAULT 0, "
+                "ram_quota BIGINT NOT NULL DEFAULT 0, ram_usage BIGINT NOT NULL DEFAULT 0)",
+            "CREATE TABLE IF NOT EXISTS tokens (id BIGSERIAL PRIMARY KEY, account VARCHAR(16) NOT NULL DEFAULT '', symbol VARCHAR(16) NOT NULL DEFAULT '', "
+                "balance VARCHAR(200) NOT NULL DEFAULT '0', symbol_precision INT NOT NULL DEFAULT 0, contract_owner VARCHAR(16) NOT NULL DEFAULT '', "
+                "UNIQUE (account, symbol, contract_owner))",
+            "CREATE TABLE IF NOT EXISTS transactions (id BIGSERIAL PRIMARY KEY, tx_id VARCHAR(64) NOT NULL DEFAULT '' UNIQUE, "
+                "block_num BIGINT NOT NULL DEFAULT 0, ref_block_num BIGINT NOT NULL DEFAULT 0, ref_block_prefix BIGINT NOT NULL DEFAULT 0, "
+                "expiration TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, pending BOOLEAN NOT NULL DEFAULT FALSE, "
+                "created_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, num_actions BIGINT NOT NULL DEFAULT 0, "
+                "updated_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, irreversible BOOLEAN NOT NULL DEFAULT FALSE, "
+                "cpu_usage_us BIGINT NOT NULL DEFAULT 0, net_usage_words BIGINT NOT NULL DEFAULT 0)",
+            "CREATE INDEX IF NOT EXISTS transactions_block_num ON transactions (block_num)",
+            "CREATE TABLE IF NOT EXISTS proposal (id BIGSERIAL PRIMARY KEY, proposer VARCHAR(16) NOT NULL DEFAULT '', "
+                "proposal_name VARCHAR(16) NOT NULL DEFAULT '', requested_approvals TEXT, UNIQUE (proposer, proposal_name))",
+            "CREATE TABLE IF NOT EXISTS votes (id BIGSERIAL PRIMARY KEY, voter VARCHAR(13) NOT NULL, proxy VARCHAR(13) NOT NULL, producers TEXT, "
+                "tran_id BYTEA NOT NULL, block_time TIMESTAMP NOT NULL, "
+                "block_num BIGINT, action_ordinal BIGINT, UNIQUE (block_num, action_ordinal))",
+            "CREATE TABLE IF NOT EXISTS buyram (id BIGSERIAL PRIMARY KEY, payer VARCHAR(13) NOT NULL, receiver VARCHAR(13) NOT NULL, "
+                "quant VARCHAR(30) NOT NULL DEFAULT '', tran_id BYTEA NOT NULL, block_time TIMESTAMP NOT NULL, "
+                "block_num BIGINT, action_ordinal BIGINT, UNIQUE (block_num, action_ordinal))",
+            "CREATE TABLE IF NOT EXISTS sellram (id BIGSERIAL PRIMARY KEY, account VARCHAR(13) NOT NULL, bytes BIGINT NOT NULL DEFAULT 0, "
+                "tran_id BYTEA NOT NULL, block_time TIMESTAMP NOT NULL, "
+                "block_num BIGINT, action_ordinal BIGINT, UNIQUE (block_num, action_ordinal))",
+            "CREATE TABLE IF NOT EXISTS delegatebw (id BIGSERIAL PRIMARY KEY, frm_acc VARCHAR(13) NOT NULL, receiver VARCHAR(13) NOT NULL, "
+                "stake_net_quantity VARCHAR(30) NOT NULL DEFAULT '', stake_cpu_quantity VARCHAR(30) NOT NULL DEFAULT '', "
+                "tran_id BYTEA NOT NULL, block_time TIMESTAMP NOT NULL, "
+                "block_num BIGINT, action_ordinal BIGINT, UNIQUE (block_num, action_ordinal))",
+            "CREATE TABLE IF NOT EXISTS undelegatebw (id BIGSERIAL PRIMARY KEY, frm_acc VARCHAR(13) NOT NULL, receiver VARCHAR(13) NOT NULL, "
+                "unstake_net_quantity VARCHAR(30) NOT NULL DEFAULT '', unstake_cpu_quantity VARCHAR(30) NOT NULL DEFAULT '', "
+                "tran_id BYTEA NOT NULL, block_time TIMESTAMP NOT NULL, "
+                "block_num BIGINT, action_ordinal BIGINT, UNIQUE (block_num, action_ordinal))",
+            "CREATE TABLE IF NOT EXISTS regproducer (id BIGSERIAL PRIMARY KEY, producer VARCHAR(13) NOT NULL, producer_key VARCHAR(64) NOT NULL, "
+                "url VARCHAR(100) NOT NULL DEFAULT '', tran_id BYTEA NOT NULL, block_time TIMESTAMP NOT NULL, "
+                "block_num BIGINT, action_ordinal BIGINT, UNIQUE (block_num, action_ordinal))",
+            "CREATE TABLE IF NOT EXISTS transfer (id BIGSERIAL PRIMARY KEY, frm_acc VARCHAR(13) NOT NULL, to_acc VARCHAR(13) NOT NULL, "
+                "quantity VARCHAR(30) NOT NULL DEFAULT '', memo VARCHAR(2000) NOT NULL DEFAULT '', tran_id BYTEA NOT NULL, block_time TIMESTAMP NOT NULL, "
+                "block_num BIGINT, action_ordinal BIGINT, UNIQUE (block_num, action_ordinal))",
+            // the text of a name stored as a signed bigint by the earlier schema
+            "CREATE OR REPLACE FUNCTION eosio_name_text(v BIGINT) RETURNS VARCHAR AS $$ "
+                "DECLARE s TEXT := ''; "
+                "BEGIN "
+                "FOR i IN 0..11 LOOP s := s || substr('.12345abcdefghijklmnopqrstuvwxyz', ((v >> (59 - 5 * i)) & 31)::int + 1, 1); END LOOP; "
+                "RETURN rtrim(s || substr('.12345abcdefghijklmnopqrstuvwxyz', (v & 15)::int + 1, 1), '.'); "
+                "END $$ LANGUAGE plpgsql IMMUTABLE",
+            // FROM_UNIXTIME and NOW of the statements shared with MySQL
+            "CREATE OR REPLACE FUNCTION FROM_UNIXTIME(BIGINT) RETURNS TIMESTAMP AS 'SELECT to_timestamp($1) AT TIME ZONE ''UTC''' LANGUAGE SQL IMMUTABLE",
+        };
+    }
+
+    bool postgresql_sink::ping( soci::session& sql ) {
+        return PQstatus(connection(sql)) == CONNECTION_OK;
+    }
+
+    void postgresql_sink::create_schema( soci::session& sql ) {
+        for(const char* ddl : schema){
+            sql << ddl;
+        }
+        // the event tables created before they had a key
+        for(const char* table : event_tables){
+            sql << std::string("ALTER TABLE ") + table + " ADD COLUMN IF NOT EXISTS block_num BIGINT, ADD COLUMN IF NOT EXISTS action_ordinal BIGINT";
+            sql << std::string("CREATE UNIQUE INDEX IF NOT EXISTS ") + table + "_action ON " + table + " (block_num, action_ordinal)";
+        }
+        // the names read back negative from bigint once their first letter was k or later
+        for(const auto& column : name_columns){
+            std::string type;
+            soci::indicator ind;
+            sql << "SELECT data_type FROM information_schema.columns WHERE table_name = :t AND column_name = :c",
+                   soci::use(std::string(column.first)), soci::use(std::string(column.second)), soci::into(type, ind);
+            if( sql.got_data() && ind == soci::i_ok && type == "bigint" ){
+                sql << std::string("ALTER TABLE ") + column.first + " ALTER COLUMN " + column.second
+                       + " TYPE VARCHAR(13) USING eosio_name_text(" + column.second + ")";
+            }
+        }
+        // and the transactions created before they had the resource usage
+        sql << "ALTER TABLE transactions ADD COLUMN IF NOT EXISTS cpu_usage_us BIGINT NOT NULL DEFAULT 0, "
+               "ADD COLUMN IF NOT EXISTS net_usage_words BIGINT NOT NULL DEFAULT 0";
+    }
+
+    std::string postgresql_sink::ignore_duplicate( const std::string& keys ) const {
+        return " ON CONFLICT(" + keys + ") DO NOTHING";
+    }
+
+    std::string postgresql_sink::upsert( const std::string& keys, const std::vector<std::string>& columns ) const {
+        std::string sql = " ON CONFLICT(" + keys + ") DO UPDATE SET ";
+        for(size_t i = 0; i < columns.size(); i++){
+            if( i > 0 ) sql += ",";
+            const auto& c = columns[i];
+            if( c.find('=') != std::string::npos ) sql += c;
+            else sql += c + "=EXCLUDED." + c;
+        }
+        return sql;
+    }
+
+    void postgresql_sink::write_event( soci::session&, const event_row& row ) {
+        boost::mutex::scoped_lock lock(m_mtx);
+        auto& buffer = m_buffers[row.table];
+        if( buffer.data.empty() ){
+            buffer.columns.clear();
+            buffer.fields.clear();
+            for(const auto& f : row.fields){
+                if( !buffer.columns.empty() ) buffer.columns += ",";
+                buffer.columns += f.column;
+                buffer.fields.push_back(f.column);
+            }
+            buffer.columns += ",block_num,action_ordinal";
+            buffer.data.assign(copy_header, sizeof(copy_header) - 1);
+        }
+
+        auto& out = buffer.data;
+        buffer.offsets.push_back(out.size());
+        buffer.keys.emplace_back(row.block_num, row.ordinal);
+        put16(out, int16_t(row.fields.size() + 2));
+        for(const auto& f : row.fields){
+            switch( f.type ){
+                case event_row::kind::integer:
+                    put32(out, 8);
+                    put64(out, f.integer);
+                    break;
+                case event_row::kind::time:
+                    put32(out, 8);
+                    put64(out, f.integer * 1000000 - postgres_epoch_us);
+                    break;
+                case event_row::kind::checksum: {
+                    std::vector<char> bytes(f.text.size() / 2);
+                    auto n = fc::from_hex(f.text, bytes.data(), bytes.size());
+                    put32(out, int32_t(n));
+                    out.append(bytes.data(), n);
+                    break;
+                }
+                case event_row::kind::name:
+                case event_row::kind::text:
+                    put32(out, int32_t(f.text.size()));
+                    out += f.text;
+                    break;
+            }
+        }
+        // a null key for the rows without an ordinal
+        if( row.ordinal != 0 ){
+            put32(out, 8);
+            put64(out, row.block_num);
+            put32(out, 8);
+            put64(out, int64_t(row.ordinal));
+        } else {
+            put32(out, -1);
+            put32(out, -1);
+        }
+        buffer.rows++;
+    }
+
+    void postgresql_sink::remove_events( soci::session&, const char* table, uint32_t block_num, uint64_t from_ordinal ) {
+        boost::mutex::scoped_lock lock(m_mtx);
+        m_removals.push_back({ table, block_num, from_ordinal });
+    }
+
+    void postgresql_sink::commit( soci::session& sql ) {
+        std::map<std::string, copy_buffer> buffers;
+        std::vector<removal> removals;
+        {
+            boost::mutex::scoped_lock lock(m_mtx);
+            buffers.swap(m_buffers);
+            removals.swap(m_removals);
+        }
+
+        PGconn* conn = connection(sql);
+        std::vector<std::string> failed;
+        for(auto& entry : buffers){
+            auto& buffer = entry.second;
+            if( buffer.rows == 0 ) continue;
+            const size_t rows_end = buffer.data.size();
+            put16(buffer.data, -1);
+
+            // COPY can not replace the rows already there, it fills a staging table of the
+            // session that is then upserted on the action key
+            const std::string& table = entry.first;
+            const std::string stage = table + "_stage";
+            const std::string copy = "COPY " + stage + " (" + buffer.columns + ") FROM STDIN (FORMAT binary)";
+            auto start = std::chrono::steady_clock::now();
+            bool ok = exec(conn, "CREATE TEMP TABLE IF NOT EXISTS " + stage + " (LIKE " + table + " INCLUDING DEFAULTS)")
+                   && exec(conn, "TRUNCATE " + stage);
+
+            size_t staged = buffer.rows;
+            bool rows_failed = false;
+            if( ok && !copy_in(conn, copy, table, buffer.data) ){
+                // one bad row fails the whole COPY, the others are staged one by one
+                staged = 0;
+                std::string one;
+                for(size_t i = 0; i < buffer.rows; i++){
+                    const size_t begin = buffer.offsets[i];
+                    const size_t end = i + 1 < buffer.rows ? buffer.offsets[i + 1] : rows_end;
+                    one.assign(copy_header, sizeof(copy_header) - 1);
+                    one.append(buffer.data, begin, end - begin);
+                    put16(one, -1);
+                    if( copy_in(conn, copy, table, one) ){
+                        staged++;
+                    } else {
+                        elog("${t} row of block ${b} action ${o} not written", ("t", table)("b", buffer.keys[i].first)("o", buffer.keys[i].second));
+                        rows_failed = true;
+                    }
+                }
+            }
+            // the rows without a key never conflict. of the keyed ones the last staged row
+            // of a position wins, a fork switch inside the batch stages the position twice
+            // and ON CONFLICT DO UPDATE can not touch a row twice in one statement
+            ok = ok && exec(conn, "INSERT INTO " + table + " (" + buffer.columns + ") SELECT " + buffer.columns + " FROM " + stage
+                                  + " WHERE action_ordinal IS NULL");
+            ok = ok && exec(conn, "INSERT INTO " + table + " (" + buffer.columns + ") SELECT DISTINCT ON (block_num,action_ordinal) "
+                                  + buffer.columns + " FROM " + stage + " WHERE action_ordinal IS NOT NULL"
+                                  " ORDER BY block_num,action_ordinal,ctid DESC"
+                                  + upsert("block_num,action_ordinal", buffer.fields));
+
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            profiler().record(copy.c_str(), uint64_t(us), ok ? staged : 0, !ok || rows_failed);
+            if( !ok || rows_failed ) failed.push_back(table);
+        }
+        for(const auto& r : removals){
+            if( !exec(conn, std::string("DELETE FROM ") + r.table + " WHERE block_num = " + std::to_string(r.block_num)
+                            + " AND action_ordinal >= " + std::to_string(r.from_ordinal)) ){
+                failed.push_back(r.table);
+            }
+        }
+        // the caller keeps the watermark below the blocks of the batch
+        FC_ASSERT( failed.empty(), "event rows not written to ${t}", ("t", failed) );
+    }
+
+    void postgresql_sink::rollback( soci::session& ) {
+        boost::mutex::scoped_lock lock(m_mtx);
+        m_buffers.clear();
+        m_removals.clear();
+    }
+
+} // namespace
@@ -0,0 +1,124 @@
+#include <eosio/sql_db_plugin/resource_snapshot.hpp>
+#include <eosio/sql_db_plugin/name_format.hpp>
+
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/resource_limits.hpp>
+
+namespace eosio {
+
+    std::string format_asset_amount( const chain::asset& a ){
+        char buf[max_asset_chars];
+        return std::string( buf, format_asset_amount(a.get_amount(), a.decimals(), buf) );
+    }
+
+    template<typename Row>
+    bool resource_snapshot::find_row( const chain::name& code, const chain::name& scope, const chain::name& table, uint64_t primary, Row& row ) const {
+        const auto& d = chain.db();
+        const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(code, scope, table));
+        if( t_id == nullptr ) return false;
+
+        const auto& idx = d.get_index<chain::key_value_index, chain::by_scope_primary>();
+        auto it = idx.find(boost::make_tuple(t_id->id, primary));
+        if( it == idx.end() ) return false;
+
+        fc::datastream<const char *> ds(it->value.data(), it->value.size());
+        fc::raw::unpack(ds, row);
+        return true;
+    }
+
+    stake_row resource_snapshot::take( const chain::account_name& account ) const {
+        stake_row row;
+        row.account = account;
+
+        const auto& rm = chain.get_resource_limits_manager();
+        int64_t net_weight = 0;
+        int64_t cpu_weight = 0;
+        rm.get_account_limits( account, row.ram_quota, net_weight, cpu_weight );
+        row.ram_usage = rm.get_account_ram_usage( account );
+
+        auto cpu = rm.get_account_cpu_limit_ex( account );
+        row.cpu_used      = cpu.used;
+        row.cpu_available = cpu.available;
+        row.cpu_limit     = cpu.max;
+
+        auto net = rm.get_account_net_limit_ex( account );
+        row.net_used      = net.used;
+        row.net_available = net.available;
+        row.net_limit     = net.max;
+
+        chain::asset balance;
+        if( find_row( N(eosio.token), account, N(accounts), chain::symbol().to_symbol_code().value, balance ) ) {
+            row.liquid = balance.get_amount();
+        }
+
+        system_rows::user_resources total;
+        if( find_row( chain::config::system_account_name, account, N(userres), account.value, total ) ) {
+            row.cpu_total = total.cpu_weight.get_amount();
+            row.net_total = total.net_weight.get_amount();
+
+            system_rows::delegated_bandwidth self;
+            if( find_row( chain::config::system_account_name, account, N(delband), account.value, self ) ) {
+                row.cpu_staked = self.cpu_weight.get_amount();
+                row.net_staked = self.net_weight.get_amount();
+            }
+            row.cpu_delegated = row.cpu_total - row.cpu_staked;
+            row.net_delegated = row.net_total - row.net_staked;
+        }
+
+        system_rows::refund_request refund;
+        if( find_row( chain::config::system_account_name, account, N(refunds), account.value, refund ) ) {
+            row.unstaking = refund.net_amount.get_amount() + refund.cpu_amount.get_amount();
+        }
+
+        system_rows::voter_info voter;
+        if( find_row( chain::config::system_account_name, chain::config::system_account_name, N(voters), account.value, voter ) ) {
+            row.total_stake = voter.staked;
+        }
+
+        row.staked     = row.cpu_staked + row.net_staked;
+        row.total      = row.staked + row.unstaking + row.liquid;
+        row.totalasset = row.total_stake + row.unstaking + row.liquid;
+        return row;
+    }
+
+    std::vector<stake_row> resource_snapshot::take( const std::vector<chain::account_name>& accounts ) const {
+        std::vector<stake_row> rows;
+        rows.reserve(accounts.size());
+        for(const auto& account : accounts){
+            try{
+                rows.emplace_back( take(account) );
+            } catch(fc::exception& e) {
+                wlog("stake snapshot of ${a} failed: ${e}",("a",account)("e",e.what()));
+            } catch(std::exception& e) {
+                wlog("stake snapshot of ${a} failed: ${e}",("a",account)("e",e.what()));
+            }
+        }
+        return rows;
+    }
+
+    std::vector<token_row> resource_snapshot::tokens( const std::vector<chain::account_name>& accounts, const std::vector<token_asset>& assets ) const {
+        std::vector<token_row> rows;
+        for(const auto& account : accounts){
+            for(const auto& a : assets){
+                try{
+                    // token contracts key the accounts table by symbol code
+                    chain::asset balance;
+                    if( !find_row( a.contract, account, N(accounts), a.symbol_code, balance ) ) continue;
+                    if( !balance.get_symbol().valid() || balance.symbol_name() != a.symbol ) continue;
+
+                    token_row row;
+                    row.account   = account;
+                    row.contract  = a.contract;
+                    row.symbol    = a.symbol;
+                    row.balance   = format_asset_amount(balance);
+                    row.precision = balance.decimals();
+                    rows.emplace_back(std::move(row));
+                } catch(fc::exception& e) {
+                    wlog("token snapshot of ${a} ${c} ${s} failed: ${e}",("a",account)("c",a.contract)("s",a.symbol)("e",e.what()));
+                }
+            }
+        }
+        return rows;
+    }
+
+} // namespace
@@ -0,0 +1,212 @@
+#include <eosio/sql_db_plugin/sql_profiler.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include <boost/functional/hash.hpp>
+
+#include <soci/mysql/soci-mysql.h>
+#include <fc/log/logger.hpp>
+#include <fc/variant_object.hpp>
+
+namespace eosio {
+
+    namespace {
+
+        // index of the ')' closing the '(' at begin, npos when unbalanced
+        size_t closing_paren( const std::string& s, size_t begin ) {
+            int depth = 0;
+            for(size_t i = begin; i < s.size(); i++){
+                if( s[i] == '(' ) depth++;
+                else if( s[i] == ')' && --depth == 0 ) return i;
+            }
+            return std::string::npos;
+        }
+
+        bool is_word( char c ) {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == ':';
+        }
+
+        std::string strip_literals( const std::string& sql ) {
+            std::string out;
+            out.reserve(sql.size());
+
+            for(size_t i = 0; i < sql.size(); ){
+                char c = sql[i];
+                if( c == '\'' || c == '"' ) {
+                    // quoted literal, backslash and doubled quote escapes
+                    size_t j = i + 1;
+                    while( j < sql.size() ) {
+                        if( sql[j] == '\\' ) { j += 2; continue; }
+                        if( sql[j] == c ) {
+                            if( j + 1 < sql.size() && sql[j+1] == c ) { j += 2; continue; }
+                            break;
+                        }
+                        j++;
+                    }
+                    out += '?';
+                    i = j + 1;
+                } else if( std::isdigit(static_cast<unsigned char>(c)) && (out.empty() || !is_word(out.back())) ) {
+                    size_t j = i;
+                    while( j < sql.size() && (std::isdigit(static_cast<unsigned char>(sql[j])) || sql[j] == '.') ) j++;
+                    out += '?';
+                    i = j;
+                } else if( std::isspace(static_cast<unsigned char>(c)) ) {
+                    if( !out.empty() && out.back() != ' ' ) out += ' ';
+                    i++;
+                } else {
+                    out += c;
+                    i++;
+                }
+            }
+            while( !out.empty() && out.back() == ' ' ) out.pop_back();
+            return out;
+        }
+
+        // (?,?),(?,?),(?,?) -> (?,?),...
+        std::string fold_groups( const std::string& sql ) {
+            std::string out;
+            out.reserve(sql.size());
+
+            std::string last_group;
+            size_t last_end = std::string::npos;
+            bool folded = false;
+
+            for(size_t i = 0; i < sql.size(); ){
+                if( sql[i] == '(' ) {
+                    size_t end = closing_paren(sql, i);
+                    if( end == std::string::npos ) {
+                        out.append(sql, i, std::string::npos);
+                        break;
+                    }
+                    last_group.assign(sql, i, end - i + 1);
+                    out += last_group;
+                    last_end = out.size();
+                    folded = false;
+                    i = end + 1;
+                    continue;
+                }
+
+                if( sql[i] == ',' && out.size() == last_end ) {
+                    size_t j = i + 1;
+                    if( j < sql.size() && sql[j] == ' ' ) j++;
+                    if( j < sql.size() && sql[j] == '(' ) {
+                        size_t end = closing_paren(sql, j);
+                        if( end != std::string::npos && sql.compare(j, end - j + 1, last_group) == 0 ) {
+                            if( !folded ) {
+                                out += ",...";
+                                last_end = out.size();
+                                folded = true;
+                            }
+                            i = end + 1;
+                            continue;
+                        }
+                    }
+                }
+
+                out += sql[i];
+                i++;
+            }
+            return out;
+        }
+
+        uint64_t affected_rows( soci::session& session ) {
+            auto backend = dynamic_cast<soci::mysql_session_backend*>(session.get_backend());
+            if( backend == nullptr || backend->conn_ == nullptr ) return 0;
+            auto rows = mysql_affected_rows(backend->conn_);
+            // (my_ulonglong)-1 after an error or a select not yet fetched
+            return rows == static_cast<decltype(rows)>(-1) ? 0 : rows;
+        }
+
+    }
+
+    std::string normalize_statement( const std::string& sql ) {
+        return fold_groups( strip_literals(sql) );
+    }
+
+    void sql_profiler::record( const char* sql, uint64_t elapsed_us, uint64_t rows, bool error ) {
+        const size_t hash = boost::hash_range(sql, sql + std::strlen(sql));
+        std::string key;
+        {
+            boost::mutex::scoped_lock lock(mtx);
+            auto itr = templates.find(hash);
+            if( itr != templates.end() && itr->second.text == sql ) key = itr->second.key;
+        }
+        if( key.empty() ){
+            key = normalize_statement(sql);
+            boost::mutex::scoped_lock lock(mtx);
+            if( templates.size() >= template_cache_size ) templates.clear();
+            templates[hash] = cached_template{ sql, key };
+        }
+        record_template( key, elapsed_us, rows, error );
+    }
+
+    void sql_profiler::record_template( const std::string& key, uint64_t elapsed_us, uint64_t rows, bool error ) {
+        uint64_t slow = slow_us.load(std::memory_order_relaxed);
+        if( slow > 0 && elapsed_us >= slow ) {
+            wlog("slow statement ${ms} ms, ${r} rows: ${sql}",("ms",elapsed_us / 1000)("r",rows)("sql",key));
+        }
+
+        boost::mutex::scoped_lock lock(mtx);
+        auto& s = statements[key];
+        s.count++;
+        s.total_us += elapsed_us;
+        s.max_us = std::max(s.max_us, elapsed_us);
+        s.rows += rows;
+        if( error ) s.errors++;
+    }
+
+    fc::variants sql_profiler::dump( size_t limit ) const {
+        std::vector<std::pair<std::string, statement_stats>> sorted;
+        {
+            boost::mutex::scoped_lock lock(mtx);
+            sorted.assign(statements.begin(), statements.end());
+        }
+        std::sort(sorted.begin(), sorted.end(), []( const auto& a, const auto& b ){
+            return a.second.total_us > b.second.total_us;
+        });
+        if( sorted.size() > limit ) sorted.resize(limit);
+
+        fc::variants result;
+        result.reserve(sorted.size());
+        for(const auto& entry : sorted){
+            const auto& s = entry.second;
+            result.emplace_back( fc::mutable_variant_object()
+                ("statement", entry.first)
+                ("count", s.count)
+                ("total_us", s.total_us)
+                ("avg_us", s.count ? s.total_us / s.count : 0)
+                ("max_us", s.max_us)
+                ("rows", s.rows)
+                ("errors", s.errors) );
+        }
+        return result;
+    }
+
+    void sql_profiler::reset() {
+        boost::mutex::scoped_lock lock(mtx);
+        statements.clear();
+        templates.clear();
+    }
+
+    sql_profiler& profiler() {
+        static sql_profiler instance;
+        return instance;
+    }
+
+    void statement_timer::finish( bool error ) {
+        finished = true;
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        uint64_t rows = 0;
+        if( !error ) {
+            try{
+                rows = affected_rows(session);
+            } catch(...) {
+            }
+        }
+        if( statement ) profiler().record_template( statement, elapsed, rows, error );
+        else profiler().record( sql_text, elapsed, rows, error );
+    }
+
+} // namespace
@@ -0,0 +1,100 @@
+#include <eosio/sql_db_plugin/sql_sink.hpp>
+#include <eosio/sql_db_plugin/sql_profiler.hpp>
+
+#include <soci/mysql/soci-mysql.h>
+#include "/usr/include/mysql/mysql.h"
+
+#include <fc/exception/exception.hpp>
+
+namespace eosio {
+
+    std::shared_ptr<sql_sink> sql_sink::create( const std::string& uri ) {
+        if( uri.compare(0, 10, "sqlite3://") == 0 ){
+#ifdef SQL_DB_SQLITE
+            return std::make_shared<sqlite_sink>();
+#else
+            FC_THROW( "sql_db_plugin was built without the soci sqlite3 backend: ${u}", ("u", uri) );
+#endif
+        }
+        if( uri.compare(0, 13, "postgresql://") == 0 ){
+#ifdef SQL_DB_POSTGRESQL
+            return std::make_shared<postgresql_sink>();
+#else
+            FC_THROW( "sql_db_plugin was built without the soci postgresql backend: ${u}", ("u", uri) );
+#endif
+        }
+        return std::make_shared<mysql_sink>();
+    }
+
+    void sql_sink::write_event( soci::session& sql, const event_row& row ) {
+        std::string columns, values;
+        for(const auto& f : row.fields){
+            if( !columns.empty() ){
+                columns += ",";
+                values += ",";
+            }
+            columns += f.column;
+            values += f.type == event_row::kind::time ? std::string("FROM_UNIXTIME(:") + f.column + ")" : std::string(":") + f.column;
+        }
+
+        const bool keyed = row.ordinal != 0;
+        std::vector<std::string> replaced;
+        if( keyed ){
+            columns += ",block_num,action_ordinal";
+            values += ",:block_num,:action_ordinal";
+            // the action of the canonical block replaces the one of a fork block at the
+            // same position, a replay writes the same row again
+            for(const auto& f : row.fields) replaced.push_back(f.column);
+        }
+
+        const std::string insert = std::string("INSERT INTO ") + row.table + " (" + columns + ") VALUES (" + values + ")"
+                                 + (keyed ? upsert("block_num,action_ordinal", replaced) : std::string());
+        statement_timer stmt(sql, insert);
+        soci::statement st = (sql.prepare << stmt.sql());
+        for(const auto& f : row.fields){
+            if( f.type == event_row::kind::integer || f.type == event_row::kind::time ) st.exchange(soci::use(f.integer));
+            else st.exchange(soci::use(f.text));
+        }
+        // soci binds signed integers, the ordinal stays below 2^63 for any block number below 2^31
+        const int64_t block_num = row.block_num, ordinal = int64_t(row.ordinal);
+        if( keyed ){
+            st.exchange(soci::use(block_num));
+            st.exchange(soci::use(ordinal));
+        }
+        st.define_and_bind();
+        st.execute(true);
+        stmt.done();
+    }
+
+    void sql_sink::remove_events( soci::session& sql, const char* table, uint32_t block_num, uint64_t from_ordinal ) {
+        const int64_t block = block_num, ordinal = int64_t(from_ordinal);
+        const std::string remove = std::string("DELETE FROM ") + table + " WHERE block_num = :block_num AND action_ordinal >= :action_ordinal";
+        statement_timer stmt(sql, remove);
+        sql << stmt.sql(), soci::use(block), soci::use(ordinal);
+        stmt.done();
+    }
+
+    std::string mysql_sink::ignore_duplicate( const std::string& ) const {
+        // unlike INSERT IGNORE, every other error is still raised
+        return " ON DUPLICATE KEY UPDATE id=id";
+    }
+
+    bool mysql_sink::ping( soci::session& sql ) {
+        auto backend = dynamic_cast<soci::mysql_session_backend*>(sql.get_backend());
+        // the empty backend of the benchmarks has nothing to ping
+        if( backend == nullptr ) return true;
+        return mysql_ping(backend->conn_) == 0;
+    }
+
+    std::string mysql_sink::upsert( const std::string&, const std::vector<std::string>& columns ) const {
+        std::string sql = " ON DUPLICATE KEY UPDATE ";
+        for(size_t i = 0; i < columns.size(); i++){
+            if( i > 0 ) sql += ",";
+            const auto& c = columns[i];
+            if( c.find('=') != std::string::npos ) sql += c;
+            else sql += c + "=VALUES(" + c + ")";
+        }
+        return sql;
+    }
+
+} // namespace
@@ -0,0 +1,145 @@
+#include <eosio/sql_db_plugin/sql_sink.hpp>
+
+#include <soci/sqlite3/soci-sqlite3.h>
+
+#include <ctime>
+
+namespace eosio {
+
+    namespace {
+
+        // the datetime text MySQL stores, so both backends read back the same strings
+        void format_time( sqlite_api::sqlite3_context* ctx, std::time_t t ) {
+            std::tm tm;
+            gmtime_r(&t, &tm);
+            char buf[32];
+            size_t n = std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+            sqlite_api::sqlite3_result_text(ctx, buf, int(n), SQLITE_TRANSIENT);
+        }
+
+        void from_unixtime( sqlite_api::sqlite3_context* ctx, int, sqlite_api::sqlite3_value** argv ) {
+            format_time(ctx, std::time_t(sqlite_api::sqlite3_value_int64(argv[0])));
+        }
+
+        void now( sqlite_api::sqlite3_context* ctx, int, sqlite_api::sqlite3_value** ) {
+            format_time(ctx, std::time(nullptr));
+        }
+
+        // eos.sql and sql_change.sql without the MySQL specifics, the unique keys are the
+        // same so the ON CONFLICT targets of upsert() match the ON DUPLICATE KEY ones
+        const char* schema[] = {
+            "CREATE TABLE IF NOT EXISTS accounts (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT NOT NULL DEFAULT '' UNIQUE, abi TEXT, "
+                "created_at TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP, updated_at TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP)",
+            "CREATE TABLE IF NOT EXISTS accounts_keys (id INTEGER PRIMARY KEY AUTOINCREMENT, account TEXT NOT NULL DEFAULT '', "
+                "public_key TEXT NOT NULL DEFAULT '', permission TEXT NOT NULL DEFAULT '')",
+            "CREATE INDEX IF NOT EXISTS accounts_keys_account ON accounts_keys (account)",
+            // the keys written twice by a replayed newaccount before they were unique
+            "DELETE FROM accounts_keys WHERE id NOT IN (SELECT MIN(id) FROM accounts_keys GROUP BY account, permission, public_key)",
+            "CREATE UNIQUE INDEX IF NOT EXISTS accounts_keys_key ON accounts_keys (account, permission, public_key)",
+            "CREATE TABLE IF NOT EXISTS actions (id INTEGER PRIMARY KEY AUTOINCREMENT, account TEXT NOT NULL DEFAULT '', transaction_id TEXT NOT NULL DEFAULT '', "
+                "seq INTEGER NOT NULL DEFAULT 0, parent INTEGER NOT NULL DEFAULT 0, name TEXT NOT NULL DEFAULT '', "
+                "created_at TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP, data TEXT, authorization TEXT, "
+                "eosto TEXT NOT NULL DEFAULT '', eosfrom TEXT NOT NULL DEFAULT '', receiver TEXT NOT NULL DEFAULT '', payer TEXT NOT NULL DEFAULT '', "
+                "newaccount TEXT NOT NULL DEFAULT '', sellram_account TEXT NOT NULL DEFAULT '')",
+            "CREATE INDEX IF NOT EXISTS idx_actions_account ON actions (account)",
+            "CREATE INDEX IF NOT EXISTS idx_actions_tx_id ON actions (transaction_id)",
+            "CREATE TABLE IF NOT EXISTS assets (id INTEGER PRIMARY KEY AUTOINCREMENT, supply INTEGER NOT NULL DEFAULT 0, max_supply INTEGER NOT NULL DEFAULT 0, "
+                "symbol_precision INTEGER NOT NULL DEFAULT 0, symbol TEXT NOT NULL DEFAULT '', issuer TEXT NOT NULL DEFAULT '', "
+                "contract_owner TEXT NOT NULL DEFAULT '', logo_url TEXT NOT NULL DEFAULT '', UNIQUE (symbol, contract_owner))",
+            "CREATE TABLE IF NOT EXISTS blocks (id INTEGER PRIMARY KEY AUTOINCREMENT, block_id TEXT NOT NULL DEFAULT '' UNIQUE, "
+                "block_number INTEGER NOT NULL DEFAULT 0, prev_block_id TEXT NOT NULL DEFAULT '', irreversible INTEGER NOT NULL DEFAULT 0, "
+                "timestamp TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP, transaction_merkle_root TEXT NOT NULL DEFAULT '', action_merkle_root TEXT NOT NULL DEFAULT '', "
+                "producer TEXT NOT NULL DEFAULT '', version INTEGER NOT NULL DEFAULT 0, new_producers TEXT, "
+                "num_transactions INTEGER NOT NULL DEFAULT 0, confirmed INTEGER NOT NULL DEFAULT 0)",
+            "CREATE INDEX IF NOT EXISTS blocks_block_number ON blocks (block_number)",
+            "CREATE TABLE IF NOT EXISTS stakes (id INTEGER PRIMARY KEY AUTOINCREMENT, account TEXT NOT NULL DEFAULT '' UNIQUE, "
+                "liquid INTEGER NOT NULL DEFAULT 0, staked INTEGER NOT NULL DEFAULT 0, unstaking INTEGER NOT NULL DEFAULT 0, total INTEGER NOT NULL DEFAULT 0, "
+                "total_stake INTEGER NOT NULL DEFAULT 0, totalasset INTEGER NOT NULL DEFAULT 0, "
+                "cpu_total INTEGER NOT NULL DEFAULT 0, cpu_staked INTEGER NOT NULL DEFAULT 0, cpu_delegated INTEGER NOT NULL DEFAULT 0, "
+                "cpu_used INTEGER NOT NULL DEFAULT 0, cpu_available INTEGER NOT NULL DEFAULT 0, cpu_limit INTEGER NOT NULL DEFAULT 0, "
+                "net_total INTEGER NOT NULL DEFAULT 0, net_staked INTEGER NOT NULL DEFAULT 0, net_delegated INTEGER NOT NULL DEFAULT 0, "
+                "net_used INTEGER NOT NULL DEFAULT 0, net_available INTEGER NOT NULL DEFAULT 0, net_limit INTEGER NOT NULL DEFAULT 0, "
+                "ram_quota INTEGER NOT NULL DEFAULT 0, ram_usage INTEGER NOT NULL DEFAULT 0)",
+            "CREATE TABLE IF NOT EXISTS tokens (id INTEGER PRIMARY KEY AUTOINCREMENT, account TEXT NOT NULL DEFAULT '', symbol TEXT NOT NULL DEFAULT '', "
+                "balance TEXT NOT NULL DEFAULT '0', symbol_precision INTEGER NOT NULL DEFAULT 0, contract_owner TEXT NOT NULL DEFAULT '', "
+                "UNIQUE (account, symbol, contract_owner))",
+            "CREATE TABLE IF NOT EXISTS transactions (id INTEGER PRIMARY KEY AUTOINCREMENT, tx_id TEXT NOT NULL DEFAULT '' UNIQUE, "
+                "block_num INTEGER NOT NULL DEFAULT 0, ref_block_num INTEGER NOT NULL DEFAULT 0, ref_block_prefix INTEGER NOT NULL DEFAULT 0, "
+                "expiration TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP, pending INTEGER NOT NULL DEFAULT 0, created_at TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP, "
+                "num_actions INTEGER NOT NULL DEFAULT 0, updated_at TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP, irreversible INTEGER NOT NULL DEFAULT 0, "
+                "cpu_usage_us INTEGER NOT NULL DEFAULT 0, net_usage_words INTEGER NOT NULL DEFAULT 0)",
+            "CREATE INDEX IF NOT EXISTS transactions_block_num ON transactions (block_num)",
+            "CREATE TABLE IF NOT EXISTS votes (id INTEGER PRIMARY KEY AUTOINCREMENT, voter TEXT NOT NULL DEFAULT '', proxy TEXT NOT NULL DEFAULT '', "
+                "producers TEXT, tran_id TEXT NOT NULL DEFAULT '', block_time TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP, "
+                "block_num INTEGER, action_ordinal INTEGER, UNIQUE (block_num, action_ordinal))",
+            "CREATE TABLE IF NOT EXISTS buyram (id INTEGER PRIMARY KEY AUTOINCREMENT, payer TEXT NOT NULL, receiver TEXT NOT NULL, "
+                "tran_id TEXT NOT NULL DEFAULT '', quant TEXT NOT NULL DEFAULT '', block_time TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP, "
+                "block_num INTEGER, action_ordinal INTEGER, UNIQUE (block_num, action_ordinal))",
+            "CREATE TABLE IF NOT EXISTS sellram (id INTEGER PRIMARY KEY AUTOINCREMENT, tran_id TEXT NOT NULL DEFAULT '', account TEXT NOT NULL, "
+                "bytes INTEGER NOT NULL DEFAULT 0, block_time TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP, "
+                "block_num INTEGER, action_ordinal INTEGER, UNIQUE (block_num, action_ordinal))",
+            "CREATE TABLE IF NOT EXISTS delegatebw (id INTEGER PRIMARY KEY AUTOINCREMENT, tran_id TEXT NOT NULL DEFAULT '', frm_acc TEXT NOT NULL, "
+                "receiver TEXT NOT NULL, stake_net_quantity TEXT NOT NULL DEFAULT '', stake_cpu_quantity TEXT NOT NULL DEFAULT '', "
+                "block_time TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP, "
+                "block_num INTEGER, action_ordinal INTEGER, UNIQUE (block_num, action_ordinal))",
+            "CREATE TABLE IF NOT EXISTS undelegatebw (id INTEGER PRIMARY KEY AUTOINCREMENT, frm_acc TEXT NOT NULL, receiver TEXT NOT NULL, "
+                "unstake_net_quantity TEXT NOT NULL DEFAULT '', unstake_cpu_quantity TEXT NOT NULL DEFAULT '', tran_id TEXT NOT NULL DEFAULT '', "
+                "block_time TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP, "
+                "block_num INTEGER, action_ordinal INTEGER, UNIQUE (block_num, action_ordinal))",
+            "CREATE TABLE IF NOT EXISTS regproducer (id INTEGER PRIMARY KEY AUTOINCREMENT, producer TEXT NOT NULL, producer_key TEXT NOT NULL, "
+                "url TEXT NOT NULL DEFAULT '', tran_id TEXT NOT NULL DEFAULT '', block_time TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP, "
+                "block_num INTEGER, action_ordinal INTEGER, UNIQUE (block_num, action_ordinal))",
+            "CREATE TABLE IF NOT EXISTS transfer (id INTEGER PRIMARY KEY AUTOINCREMENT, frm_acc TEXT NOT NULL, to_acc TEXT NOT NULL, "
+                "quantity TEXT NOT NULL DEFAULT '', memo TEXT NOT NULL DEFAULT '', tran_id TEXT NOT NULL DEFAULT '', "
+                "block_time TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP, "
+                "block_num INTEGER, action_ordinal INTEGER, UNIQUE (block_num, action_ordinal))",
+            "CREATE TABLE IF NOT EXISTS proposal (id INTEGER PRIMARY KEY AUTOINCREMENT, proposer TEXT NOT NULL DEFAULT '', proposal_name TEXT NOT NULL DEFAULT '', "
+                "requested_approvals TEXT, UNIQUE (proposer, proposal_name))",
+        };
+    }
+
+    void sqlite_sink::open( soci::session& sql ) {
+        auto backend = static_cast<soci::sqlite3_session_backend*>(sql.get_backend());
+        sqlite_api::sqlite3_create_function(backend->conn_, "FROM_UNIXTIME", 1, SQLITE_UTF8, nullptr, &from_unixtime, nullptr, nullptr);
+        sqlite_api::sqlite3_create_function(backend->conn_, "NOW", 0, SQLITE_UTF8, nullptr, &now, nullptr, nullptr);
+
+        // readers of the API pool never block the writer, a crash loses at most the open batch
+        sql << "PRAGMA journal_mode=WAL";
+        sql << "PRAGMA synchronous=NORMAL";
+        sql << "PRAGMA busy_timeout=5000";
+    }
+
+    void sqlite_sink::create_schema( soci::session& sql ) {
+        for(const char* ddl : schema){
+            sql << ddl;
+        }
+    }
+
+    std::string sqlite_sink::upsert( const std::string& keys, const std::vector<std::string>& columns ) const {
+        std::string sql = " ON CONFLICT(" + keys + ") DO UPDATE SET ";
+        for(size_t i = 0; i < columns.size(); i++){
+            if( i > 0 ) sql += ",";
+            const auto& c = columns[i];
+            if( c.find('=') != std::string::npos ) sql += c;
+            else sql += c + "=excluded." + c;
+        }
+        return sql;
+    }
+
+    std::string sqlite_sink::ignore_duplicate( const std::string& keys ) const {
+        return " ON CONFLICT(" + keys + ") DO NOTHING";
+    }
+
+    void sqlite_sink::begin( soci::session& sql ) {
+        sql.begin();
+    }
+
+    void sqlite_sink::commit( soci::session& sql ) {
+        sql.commit();
+    }
+
+    void sqlite_sink::rollback( soci::session& sql ) {
+        sql.rollback();
+    }
+
+} // namespace
@@ -0,0 +1,148 @@
+#include <eosio/sql_db_plugin/table_strands.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+
+namespace eosio {
+
+    struct table_strands::strand {
+        struct item {
+            task     run;
+            // the end of a block when there is nothing to run
+            uint32_t block_num = 0;
+        };
+
+        std::shared_ptr<soci::session> session;
+        boost::mutex mtx;
+        boost::condition_variable changed;
+        std::deque<item> items;
+        bool busy = false;
+        bool done = false;
+        uint32_t written_block = 0;
+        // a task of the current block threw
+        bool block_failed = false;
+        // the block of a failed write, written_block stays below it until it is written again
+        uint32_t failed_block = 0;
+        boost::thread thread;
+    };
+
+    table_strands::table_strands( const std::string& uri, const std::shared_ptr<sql_sink>& sink, size_t strands, size_t max_pending )
+    :m_max_pending(std::max<size_t>(1, max_pending)) {
+        FC_ASSERT( strands > 0, "no writer strands" );
+        m_pool = std::make_shared<soci_session_pool>(strands, uri, sink);
+
+        for(size_t i = 0; i < strands; i++){
+            m_strands.emplace_back( std::make_unique<strand>() );
+            auto& s = *m_strands.back();
+            // the connection belongs to the strand for as long as it runs
+            s.session = m_pool->get_session();
+            s.thread = boost::thread([this,&s]{
+                while( true ){
+                    strand::item next;
+                    {
+                        boost::mutex::scoped_lock lock(s.mtx);
+                        while( s.items.empty() && !s.done ) s.changed.wait(lock);
+                        if( s.items.empty() ) return;
+                        next = std::move(s.items.front());
+                        s.items.pop_front();
+                        s.busy = true;
+                    }
+
+                    bool failed = false;
+                    if( next.run ){
+                        failed = true;
+                        try{
+                            next.run( *s.session );
+                            failed = false;
+                        } catch(fc::exception& e) {
+                            wlog("table write failed: ${e}", ("e", e.to_string()));
+                        } catch(std::exception& e) {
+                            wlog("table write failed: ${e}", ("e", e.what()));
+                            // the connection may be gone, the next write needs a working one
+                            try{
+                                m_pool->reconnect(s.session);
+                            } catch(...) {
+                            }
+                        } catch(...) {
+                            wlog("table write failed");
+                        }
+                    }
+
+                    boost::mutex::scoped_lock lock(s.mtx);
+                    if( failed ) s.block_failed = true;
+                    if( !next.run ){
+                        if( s.block_failed ){
+                            if( s.failed_block == 0 || next.block_num < s.failed_block ) s.failed_block = next.block_num;
+                            wlog("block ${b} not written, the strand stays at block ${w}", ("b", next.block_num)("w", s.written_block));
+                        } else if( next.block_num == s.failed_block ){
+                            s.failed_block = 0;
+                        }
+                        s.block_failed = false;
+                        if( s.failed_block == 0 ) s.written_block = next.block_num;
+                    }
+                    s.busy = false;
+                    s.changed.notify_all();
+                }
+            });
+        }
+    }
+
+    table_strands::~table_strands() {
+        // the queued writes are still done
+        for(auto& s : m_strands){
+            boost::mutex::scoped_lock lock(s->mtx);
+            s->done = true;
+            s->changed.notify_all();
+        }
+        for(auto& s : m_strands) s->thread.join();
+    }
+
+    table_strands::strand& table_strands::strand_of( const std::string& table ) {
+        boost::mutex::scoped_lock lock(m_mtx);
+        auto itr = m_tables.find(table);
+        if( itr == m_tables.end() ) itr = m_tables.emplace(table, m_tables.size() % m_strands.size()).first;
+        return *m_strands[itr->second];
+    }
+
+    void table_strands::post( const std::string& table, task f ) {
+        auto& s = strand_of(table);
+        boost::mutex::scoped_lock lock(s.mtx);
+        while( s.items.size() >= m_max_pending ) s.changed.wait(lock);
+        s.items.push_back({ std::move(f), 0 });
+        s.changed.notify_all();
+    }
+
+    void table_strands::end_block( uint32_t block_num ) {
+        for(auto& s : m_strands){
+            boost::mutex::scoped_lock lock(s->mtx);
+            // a marker never waits, the strand is only behind by the tasks of the block
+            s->items.push_back({ task(), block_num });
+            s->changed.notify_all();
+        }
+    }
+
+    uint32_t table_strands::checkpoint() {
+        uint32_t block_num = 0;
+        bool first = true;
+        for(auto& s : m_strands){
+            boost::mutex::scoped_lock lock(s->mtx);
+            if( first || s->written_block < block_num ) block_num = s->written_block;
+            first = false;
+        }
+        return block_num;
+    }
+
+    void table_strands::wait( const std::string& table ) {
+        auto& s = strand_of(table);
+        boost::mutex::scoped_lock lock(s.mtx);
+        while( !s.items.empty() || s.busy ) s.changed.wait(lock);
+    }
+
+    void table_strands::wait_all() {
+        for(auto& s : m_strands){
+            boost::mutex::scoped_lock lock(s->mtx);
+            while( !s->items.empty() || s->busy ) s->changed.wait(lock);
+        }
+    }
+
+} // namespace
@@ -1,63 +1,113 @@
 // #include "transactions_table.hpp"
 #include <eosio/sql_db_plugin/transactions_table.hpp>
+#include <eosio/sql_db_plugin/metrics.hpp>
+#include <eosio/sql_db_plugin/sql_profiler.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <fc/log/logger.hpp>
 
 namespace eosio {
 
-    void transactions_table::add( std::shared_ptr<soci::session> m_session, chain::transaction transaction ) {
+    void transactions_table::add( const block_record& block ) {
+        const auto created_at = std::chrono::seconds{block.timestamp.operator fc::time_point().sec_since_epoch()}.count();
+        const auto block_num = std::to_string(block.block_num);
+
+        for(const auto& transaction : block.transactions){
+            const auto expiration = std::chrono::seconds{transaction.expiration.sec_since_epoch()}.count();
+            m_rows.push_back( "('" + transaction.id.str() + "'," + block_num + "," + std::to_string(transaction.ref_block_num) + ","
+                            + std::to_string(transaction.ref_block_prefix) + ",FROM_UNIXTIME(" + std::to_string(expiration) + "),"
+                            + "FROM_UNIXTIME(" + std::to_string(created_at) + ")," + std::to_string(transaction.action_count) + ","
+                            + std::to_string(transaction.cpu_usage_us) + "," + std::to_string(transaction.net_usage_words) + ")" );
+        }
+    }
+
+    std::vector<std::string> transactions_table::take() {
+        std::vector<std::string> rows;
+        rows.swap(m_rows);
+        return rows;
+    }
+
+    void transactions_table::write( soci::session& sql, const std::vector<std::string>& rows ) const {
+        const size_t rows_per_statement = 500;
+
+        for(size_t begin = 0; begin < rows.size(); begin += rows_per_statement){
+            std::string insert = "INSERT INTO transactions(tx_id, block_num, ref_block_num, ref_block_prefix, expiration, created_at, "
+                                 "num_actions, cpu_usage_us, net_usage_words) VALUES ";
+            size_t end = std::min(rows.size(), begin + rows_per_statement);
+            for(size_t i = begin; i < end; i++){
+                if( i > begin ) insert += ",";
+                insert += rows[i];
+            }
+            // a transaction seen again on another fork moves to the block that has it now
+            insert += m_sink->upsert("tx_id", {"block_num", "cpu_usage_us", "net_usage_words"});
+
+            statement_timer stmt(sql, insert, "INSERT INTO transactions VALUES (...),...");
+            sql << stmt.sql();
+            stmt.done();
+            metrics().count_table("transactions", end - begin);
+        }
+    }
+
+    bool transactions_table::irreversible_set( std::shared_ptr<soci::session> m_session, uint32_t first, uint32_t last ) {
 
-        /*
-        const auto transaction_id_str = transaction.id().str();
-        const auto expiration = std::chrono::seconds{transaction.expiration.sec_since_epoch()}.count();
         try{
-            
-            *m_session << "INSERT INTO transactions(tx_id, ref_block_num, ref_block_prefix, expiration, pending, created_at, updated_at, num_actions) "
-                        "VALUES (:id, :ida, :idb, FROM_UNIXTIME(:ex), :pe, FROM_UNIXTIME(:ca), FROM_UNIXTIME(:ua), :na)",
-                soci::use(transaction_id_str,"id"),
-                soci::use((long long )transaction.ref_block_num,"ida"),
-                soci::use((long long)transaction.ref_block_prefix,"idb"),
-                soci::use(expiration,"ex"),
-                soci::use(0,"pe"),
-                soci::use(expiration,"ca"),
-                soci::use(expiration,"ua"),
-                soci::use(transaction.total_actions(),"na");
-                
+            const int64_t from = first, to = last;
+            statement_timer stmt(*m_session, "UPDATE transactions SET irreversible = TRUE WHERE block_num BETWEEN :first AND :last AND NOT irreversible");
+            *m_session << stmt.sql(),
+                soci::use(from),
+                soci::use(to);
+            stmt.done();
+            return true;
         } catch(soci::mysql_soci_error e) {
             wlog("soci::error: ${e}",("e",e.what()) );
         } catch (std::exception e) {
-            wlog("insert transaction failed. ${id}",("id",transaction_id_str));
+            wlog("update transactions failed ${first}-${last}",("first",first)("last",last));
             wlog("${e}",("e",e.what()));
-        } catch(...){
-            wlog("insert transaction failed. ${id}",("id",transaction_id_str));
-        }*/
+        } catch(...) {
+            wlog("update transactions failed ${first}-${last}",("first",first)("last",last));
+        }
+        return false;
     }
 
-    void transactions_table::irreversible_set( std::shared_ptr<soci::session> m_session, std::string block_id, bool irreversible, std::string transaction_id_str) {
+    bool transactions_table::irreversible_set( std::shared_ptr<soci::session> m_session, const std::vector<std::string>& tx_ids ) {
+        const size_t ids_per_statement = 500;
 
         try{
-            *m_session << "UPDATE transactions SET block_id = :block_id, irreversible = :irreversible WHERE block_id = :id ",
-                soci::use(block_id),
-                soci::use(irreversible?1:0),
-                soci::use(transaction_id_str);
+            for(size_t begin = 0; begin < tx_ids.size(); begin += ids_per_statement){
+                std::string update = "UPDATE transactions SET irreversible = TRUE WHERE tx_id IN (";
+                size_t end = std::min(tx_ids.size(), begin + ids_per_statement);
+                for(size_t i = begin; i < end; i++){
+                    if( i > begin ) update += ",";
+                    update += "'" + tx_ids[i] + "'";
+                }
+                update += ") AND NOT irreversible";
+
+                statement_timer stmt(*m_session, update, "UPDATE transactions SET irreversible = TRUE WHERE tx_id IN (...)");
+                *m_session << stmt.sql();
+                stmt.done();
+            }
+            return true;
         } catch(soci::mysql_soci_error e) {
             wlog("soci::error: ${e}",("e",e.what()) );
         } catch (std::exception e) {
-            wlog("update transaction failed ${id}",("id",transaction_id_str));
+            wlog("update transactions failed, ${n} transactions",("n",tx_ids.size()));
             wlog("${e}",("e",e.what()));
         } catch(...) {
-            wlog("update transaction failed ${id}",("id",transaction_id_str));
+            wlog("update transactions failed, ${n} transactions",("n",tx_ids.size()));
         }
+        return false;
     }
 
     bool transactions_table::find_transaction( std::shared_ptr<soci::session> m_session, std::string transaction_id_str) {
         
         int amount;
         try{
-            *m_session << "SELECT COUNT(*) FROM transactions WHERE id = :id",
+            statement_timer stmt(*m_session, "SELECT COUNT(*) FROM transactions WHERE id = :id");
+            *m_session << stmt.sql(),
                 soci::into(amount),
                 soci::use(transaction_id_str);
+            stmt.done();
         } catch(soci::mysql_soci_error e) {
             wlog("soci::error: ${e}",("e",e.what()) );
         } catch(...) {
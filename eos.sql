@@ -55,7 +55,8 @@ CREATE TABLE `accounts_keys` (
   `public_key` varchar(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL DEFAULT '' COMMENT '公钥',
   `permission` varchar(16) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL DEFAULT '' COMMENT '权限名称',
   PRIMARY KEY (`id`),
-  KEY `account` (`account`)
+  KEY `account` (`account`),
+  UNIQUE KEY `idx_accounts_keys_key` (`account`,`permission`,`public_key`)
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci;
 /*!40101 SET character_set_client = @saved_cs_client */;
 
@@ -159,7 +160,8 @@ CREATE TABLE `blocks` (
   PRIMARY KEY (`id`),
   UNIQUE KEY `idx_block_id` (`block_id`),
   KEY `idx_blocks_producer` (`producer`),
-  KEY `idx_prev_block_id` (`prev_block_id`)
+  KEY `idx_prev_block_id` (`prev_block_id`),
+  KEY `idx_blocks_number` (`block_number`)
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci;
 /*!40101 SET character_set_client = @saved_cs_client */;
 
@@ -238,6 +240,8 @@ CREATE TABLE `transactions` (
   `num_actions` bigint(20) NOT NULL DEFAULT '0' COMMENT '交易中 action 的数量',
   `updated_at` datetime NOT NULL DEFAULT CURRENT_TIMESTAMP COMMENT '更新时间',
   `irreversible` tinyint(1) NOT NULL DEFAULT '0' COMMENT '是否不可逆',
+  `cpu_usage_us` int(10) unsigned NOT NULL DEFAULT '0' COMMENT 'cpu 使用量(微秒)',
+  `net_usage_words` int(10) unsigned NOT NULL DEFAULT '0' COMMENT 'net 使用量(8字节)',
   PRIMARY KEY (`tx_id`),
   UNIQUE KEY `idx_transactions_id` (`id`),
   KEY `transactions_block_num` (`block_num`)
@@ -258,6 +262,9 @@ CREATE TABLE `votes` (
   `producers` json DEFAULT NULL COMMENT '账号所投节点的列表',
   `tran_id` varchar(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL DEFAULT '',  
   `block_time` datetime NOT NULL DEFAULT CURRENT_TIMESTAMP COMMENT '时间',
-  PRIMARY KEY (`id`)
+  `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  PRIMARY KEY (`id`),
+  UNIQUE KEY `idx_votes_action` (`block_num`,`action_ordinal`)
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci;
 /*!40101 SET character_set_client = @saved_cs_client */;
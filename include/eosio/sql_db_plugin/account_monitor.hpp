@@ -0,0 +1,60 @@
+#pragma once
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <eosio/sql_db_plugin/database.hpp>
+
+namespace eosio {
+
+struct account_monitor_options {
+    uint32_t threads = 2;
+    uint32_t accounts_per_second = 500;
+    uint32_t batch_size = 100;
+    uint32_t sweep_ms = 100;
+};
+
+// caps the number of accounts refreshed per second, 0 means no cap
+class rate_limiter {
+    public:
+        rate_limiter(uint32_t per_second):per_second(per_second){}
+
+        // waits until n more accounts fit in the budget of the current second.
+        // returns false when exit was raised while waiting.
+        bool acquire( size_t n, const boost::atomic<bool>& exit );
+
+    private:
+        const uint32_t per_second;
+        boost::mutex mtx;
+        boost::posix_time::ptime window_start;
+        size_t used = 0;
+};
+
+// keeps the tokens and stakes tables up to date. workers refresh the accounts marked
+// dirty by ingest first and sweep the whole accounts table in the background when idle.
+class account_monitor : public boost::noncopyable {
+    public:
+        account_monitor(sql_database& db, const account_monitor_options& options);
+        ~account_monitor();
+
+        void shutdown();
+
+    private:
+        void run();
+        std::vector<chain::account_name> next_sweep_batch();
+
+        sql_database& db;
+        const account_monitor_options options;
+        rate_limiter limiter;
+        boost::atomic<bool> exit{false};
+
+        boost::mutex mtx_sweep;
+        boost::posix_time::ptime last_sweep;
+        int64_t sweep_cursor = 0;
+
+        boost::thread_group workers;
+};
+
+} // namespace
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <deque>
+#include <map>
+#include <set>
+
+#include <chainbase/chainbase.hpp>
+
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/action.hpp>
+#include <eosio/chain/types.hpp>
+#include <eosio/sql_db_plugin/action_ordinal.hpp>
+
+namespace eosio {
+
+// compact binary form of an action, stored once however many accounts it touches
+struct action_history_record {
+    uint64_t                   ordinal = 0;
+    uint32_t                   block_num = 0;
+    uint32_t                   block_time = 0;
+    chain::transaction_id_type trx_id;
+    chain::action              act;
+};
+
+namespace history {
+    using namespace boost::multi_index;
+
+    enum object_type {
+        action_object_type = 1,
+        account_object_type,
+        abi_object_type,
+        decoded_object_type
+    };
+
+    struct action_object : public chainbase::object<action_object_type, action_object> {
+        OBJECT_CTOR(action_object, (packed))
+
+        id_type             id;
+        uint64_t            ordinal = 0;
+        chain::shared_string packed;
+    };
+
+    // one entry per account the action touches
+    struct account_object : public chainbase::object<account_object_type, account_object> {
+        OBJECT_CTOR(account_object)
+
+        id_type             id;
+        chain::name         account;
+        uint64_t            ordinal = 0;
+    };
+
+    // the abi set by a setabi, its ordinal is the version of the abi
+    struct abi_object : public chainbase::object<abi_object_type, abi_object> {
+        OBJECT_CTOR(abi_object, (packed))
+
+        id_type             id;
+        chain::name         account;
+        uint64_t            ordinal = 0;
+        chain::shared_string packed;
+    };
+
+    // the data of a raw action decoded ahead of the reads, as JSON
+    struct decoded_object : public chainbase::object<decoded_object_type, decoded_object> {
+        OBJECT_CTOR(decoded_object, (json))
+
+        id_type             id;
+        uint64_t            ordinal = 0;
+        chain::shared_string json;
+    };
+
+    struct by_ordinal;
+    struct by_account_ordinal;
+    struct by_ordinal_account;
+
+    typedef chainbase::shared_multi_index_container<
+        action_object,
+        indexed_by<
+            ordered_unique<tag<chain::by_id>, member<action_object, action_object::id_type, &action_object::id>>,
+            ordered_unique<tag<by_ordinal>, member<action_object, uint64_t, &action_object::ordinal>>
+        >
+    > action_index;
+
+    typedef chainbase::shared_multi_index_container<
+        account_object,
+        indexed_by<
+            ordered_unique<tag<chain::by_id>, member<account_object, account_object::id_type, &account_object::id>>,
+            ordered_unique<tag<by_account_ordinal>,
+                composite_key<account_object,
+                    member<account_object, chain::name, &account_object::account>,
+                    member<account_object, uint64_t, &account_object::ordinal>
+                >
+            >,
+            ordered_unique<tag<by_ordinal_account>,
+                composite_key<account_object,
+                    member<account_object, uint64_t, &account_object::ordinal>,
+                    member<account_object, chain::name, &account_object::account>
+                >
+            >
+        >
+    > account_index;
+
+    typedef chainbase::shared_multi_index_container<
+        abi_object,
+        indexed_by<
+            ordered_unique<tag<chain::by_id>, member<abi_object, abi_object::id_type, &abi_object::id>>,
+            ordered_unique<tag<by_account_ordinal>,
+                composite_key<abi_object,
+                    member<abi_object, chain::name, &abi_object::account>,
+                    member<abi_object, uint64_t, &abi_object::ordinal>
+                >
+            >
+        >
+    > abi_index;
+
+    typedef chainbase::shared_multi_index_container<
+        decoded_object,
+        indexed_by<
+            ordered_unique<tag<chain::by_id>, member<decoded_object, decoded_object::id_type, &decoded_object::id>>,
+            ordered_unique<tag<by_ordinal>, member<decoded_object, uint64_t, &decoded_object::ordinal>>
+        >
+    > decoded_index;
+}
+
+// account action history kept in an embedded chainbase database next to the SQL one.
+// actions are keyed by their ordinal and every touched account by (account, ordinal), so
+// both lookups are a btree seek plus a scan whatever the size of the chain.
+//
+// the action data is stored as it is on chain. the abi of every setabi is kept under its
+// ordinal, the version of the abi, so the data of an action is decoded on read with the
+// abi its contract had at the time.
+class action_history {
+    public:
+        action_history( const boost::filesystem::path& dir, uint64_t size_mb );
+        ~action_history();
+
+        // stores the action once, replays of a block already stored are ignored. a different
+        // action at the ordinal, from the block that won a fork, replaces the stored one.
+        // abi_data is null for an action stored raw, it is then listed under its contract
+        // and authorizers only until the materializer decodes it
+        void add( const chain::action& act, const fc::variant& abi_data, uint32_t block_num, uint64_t ordinal,
+                  uint32_t block_time, const chain::transaction_id_type& trx_id );
+
+        // drops the actions of the block that were not added since the last end_block, the
+        // rest of a fork block with more actions than the block that replaced it
+        void end_block( uint32_t block_num );
+
+        // the abi set by the setabi of the given ordinal, empty when the abi was cleared
+        void add_abi( chain::name account, uint64_t ordinal, const chain::bytes& packed_abi );
+        // the ordinal of the setabi in force at the ordinal, 0 when the history has none
+        uint64_t abi_version( chain::name account, uint64_t ordinal );
+        // the data of the action decoded with its abi version, null when there is no abi
+        fc::variant decode( const action_history_record& record );
+
+        // the raw actions of these contracts are decoded on a background thread as they
+        // are added, and listed under the accounts of their data
+        void set_hot_contracts( const std::set<chain::name>& contracts );
+
+        // newest first, starting below before_ordinal when it is not 0
+        std::vector<action_history_record> account_actions( chain::name account, size_t limit, uint64_t before_ordinal = 0 );
+        // oldest first, blocks first_block to last_block included
+        std::vector<action_history_record> block_actions( uint32_t first_block, uint32_t last_block, size_t limit );
+
+        // the accounts an action is listed under: contract, authorizers and the account fields of its data
+        static std::vector<chain::name> touched_accounts( const chain::action& act, const fc::variant& abi_data );
+
+    private:
+        action_history_record unpack( const history::action_object& obj ) const;
+        // the action, its decoded data and its account entries, mtx held
+        void erase( uint64_t ordinal );
+        std::shared_ptr<const chain::abi_serializer> serializer_for( chain::name account, uint64_t version );
+        fc::variant decode_raw( const action_history_record& record );
+        void materialize();
+
+        static const size_t serializer_cache_size = 1000;
+
+        boost::mutex mtx;
+        chainbase::database db;
+        // the ordinals added since the last end_block
+        std::set<uint64_t> block_ordinals;
+
+        boost::mutex serializer_mtx;
+        std::map<std::pair<chain::name, uint64_t>, std::shared_ptr<const chain::abi_serializer>> serializers;
+
+        std::set<chain::name> hot_contracts;
+        boost::mutex materialize_mtx;
+        boost::condition_variable materialize_cv;
+        std::deque<uint64_t> materialize_queue;
+        bool done = false;
+        boost::thread materializer;
+};
+
+} // namespace
+
+CHAINBASE_SET_INDEX_TYPE( eosio::history::action_object, eosio::history::action_index )
+CHAINBASE_SET_INDEX_TYPE( eosio::history::account_object, eosio::history::account_index )
+CHAINBASE_SET_INDEX_TYPE( eosio::history::abi_object, eosio::history::abi_index )
+CHAINBASE_SET_INDEX_TYPE( eosio::history::decoded_object, eosio::history::decoded_index )
+
+FC_REFLECT( eosio::action_history_record, (ordinal)(block_num)(block_time)(trx_id)(act) )
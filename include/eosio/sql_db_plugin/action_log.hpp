@@ -0,0 +1,184 @@
+#pragma once
+
+// append-only binary log of the decoded actions, one directory of segments:
+//
+//   actions-<first block>.log     segment header, then per block a fixed block header
+//                                 followed by its actions
+//   actions-<first block>.index   one fixed index_entry per block, block number -> offset
+//
+// names and amounts are varints and the action data is the ABI decoded value in a
+// compact tagged encoding, so readers never need the ABIs. the reader maps the files
+// and hands out views into the mapping without copying.
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <eosio/chain/action.hpp>
+#include <eosio/chain/types.hpp>
+
+namespace eosio { namespace action_log {
+
+const char     segment_magic[8] = { 'E', 'O', 'S', 'A', 'C', 'T', 'L', 'G' };
+const uint32_t format_version = 1;
+
+struct segment_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t first_block;
+    uint8_t  reserved[16];
+};
+
+struct block_header {
+    uint32_t block_num;
+    uint32_t block_time;     // seconds since epoch
+    uint32_t action_count;
+    uint32_t size;           // bytes of actions after the header
+};
+
+struct index_entry {
+    uint32_t block_num;
+    uint32_t reserved;
+    uint64_t offset;         // of the block_header in the segment
+};
+
+static_assert( sizeof(segment_header) == 32, "segment_header is part of the file format" );
+static_assert( sizeof(block_header) == 16, "block_header is part of the file format" );
+static_assert( sizeof(index_entry) == 16, "index_entry is part of the file format" );
+
+// tags of the encoded values
+enum class value_tag : uint8_t {
+    null = 0, false_value, true_value, int64, uint64, float64, string, name, asset, array, object, bytes
+};
+
+void write_varint( std::string& out, uint64_t v );
+uint64_t read_varint( const char*& pos, const char* end );
+
+// the decoded action data, strings holding a name or an asset are stored as such
+void encode_value( std::string& out, const fc::variant& v );
+fc::variant decode_value( const char*& pos, const char* end );
+
+std::string segment_name( uint32_t first_block );
+
+// one action of a mapped block, the pointers stay valid as long as the reader
+struct action_view {
+    uint32_t       trx_index = 0;
+    uint32_t       action_index = 0;
+    const char*    trx_id = nullptr;        // 32 bytes
+    chain::name    account;
+    chain::name    name;
+    std::vector<chain::permission_level> authorization;
+    const char*    data_begin = nullptr;    // encoded value
+    const char*    data_end = nullptr;
+
+    chain::transaction_id_type transaction_id() const;
+    fc::variant data() const;
+};
+
+struct block_view {
+    uint32_t    block_num = 0;
+    uint32_t    block_time = 0;
+    uint32_t    action_count = 0;
+    const char* begin = nullptr;
+    const char* end = nullptr;
+
+    // calls f(const action_view&) for every action of the block
+    template<typename F>
+    void for_each_action( F&& f ) const;
+
+    static bool parse_action( const char*& pos, const char* end, action_view& act );
+};
+
+class writer {
+    public:
+        writer( const boost::filesystem::path& dir, uint64_t segment_bytes );
+        ~writer();
+
+        uint32_t last_block() const { return m_last_block; }
+
+        // appends a block, a block number at or below the last one replaces the blocks from
+        // there on when it is in the open segment (fork switch) and is ignored otherwise
+        void begin_block( uint32_t block_num, uint32_t block_time );
+        void add_action( uint32_t trx_index, uint32_t action_index, const chain::transaction_id_type& trx_id,
+                         const chain::action& act, const fc::variant* decoded );
+        void end_block();
+        void flush();
+
+    private:
+        void open_segment( uint32_t first_block );
+        void open_last_segment();
+        void truncate_to( uint32_t block_num );
+
+        boost::filesystem::path m_dir;
+        uint64_t m_segment_bytes;
+        uint32_t m_last_block = 0;
+        uint32_t m_segment_first = 0;
+
+        std::FILE* m_log = nullptr;
+        std::FILE* m_index = nullptr;
+        uint64_t m_log_size = 0;
+        std::vector<index_entry> m_entries;   // of the open segment
+
+        bool m_in_block = false;
+        bool m_skip_block = false;
+        block_header m_block;
+        std::string m_actions;
+};
+
+class reader {
+    public:
+        explicit reader( const boost::filesystem::path& dir );
+
+        uint32_t first_block() const;
+        uint32_t last_block() const;
+
+        bool find_block( uint32_t block_num, block_view& block ) const;
+
+        // calls f(const block_view&) for the blocks first to last, oldest first
+        template<typename F>
+        void for_each_block( uint32_t first, uint32_t last, F&& f ) const {
+            for(const auto& s : m_segments){
+                auto entries = s->entries();
+                for(size_t i = 0; i < s->entry_count(); i++){
+                    if( entries[i].block_num < first ) continue;
+                    if( entries[i].block_num > last ) return;
+                    block_view block;
+                    if( s->block(entries[i], block) ) f(block);
+                }
+            }
+        }
+
+    private:
+        struct segment {
+            segment( const boost::filesystem::path& log, const boost::filesystem::path& index );
+
+            const index_entry* entries() const { return reinterpret_cast<const index_entry*>(index_region.get_address()); }
+            size_t entry_count() const { return index_region.get_size() / sizeof(index_entry); }
+            bool block( const index_entry& entry, block_view& block ) const;
+
+            boost::interprocess::file_mapping  log_file;
+            boost::interprocess::mapped_region log_region;
+            boost::interprocess::file_mapping  index_file;
+            boost::interprocess::mapped_region index_region;
+        };
+
+        std::vector<std::unique_ptr<segment>> m_segments;
+};
+
+template<typename F>
+void block_view::for_each_action( F&& f ) const {
+    const char* pos = begin;
+    action_view act;
+    for(uint32_t i = 0; i < action_count && pos < end; i++){
+        if( !parse_action(pos, end, act) ) return;
+        f(act);
+    }
+}
+
+} } // namespace
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+namespace eosio {
+
+// position of an action in the chain: block number and position of the action among
+// all the actions of the block's transactions. increases with the chain like the global
+// sequence of the action receipts, which the block_state ingest path never sees. the
+// position has the whole low half, no block has 2^32 actions
+inline uint64_t action_ordinal( uint32_t block_num, uint32_t action_position ) {
+    return (uint64_t(block_num) << 32) | uint64_t(action_position);
+}
+
+inline uint32_t ordinal_block_num( uint64_t ordinal ) {
+    return uint32_t(ordinal >> 32);
+}
+
+} // namespace
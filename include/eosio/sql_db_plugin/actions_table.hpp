@@ -1,9 +1,18 @@
 #pragma once
 
 #include <eosio/sql_db_plugin/table.hpp>
-
+#include <eosio/sql_db_plugin/dirty_accounts.hpp>
+#include <eosio/sql_db_plugin/action_history.hpp>
+#include <eosio/sql_db_plugin/action_log.hpp>
+#include <eosio/sql_db_plugin/change_stream.hpp>
+#include <eosio/sql_db_plugin/json_writer.hpp>
+#include <eosio/sql_db_plugin/table_strands.hpp>
+
+#include <atomic>
+#include <map>
 #include <vector>
 
+#include <boost/thread/mutex.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/uuid/uuid_generators.hpp>
@@ -32,19 +41,63 @@ struct system_contract_arg{
     chain::account_name account;
 };
 
+// the parsed abi of a contract, the serializer and the json writer of its action data
+struct contract_abi {
+    contract_abi( const chain::abi_def& abi, const fc::microseconds& max_time )
+    :serializer(abi, max_time), json(abi)
+    {}
+    chain::abi_serializer serializer;
+    json_abi              json;
+};
+
 class actions_table : public mysql_table {
     public:
         actions_table(){}
 
-        bool add( std::shared_ptr<soci::session>, chain::action , chain::transaction_id_type , chain::block_timestamp_type , std::vector<std::string> ); 
-        bool parse_actions( std::shared_ptr<soci::session>, chain::action ,const std::string & transaction_id,const long long timestamp);
-        string add_data( std::shared_ptr<soci::session>, chain::action );
+        // trx_index and action_index locate the action in the block for the action log
+        bool add( const std::shared_ptr<soci::session>&, const chain::action& , const chain::transaction_id_type& , chain::block_timestamp_type , uint32_t block_num, const std::vector<std::string>&, uint64_t ordinal = 0, uint32_t trx_index = 0, uint32_t action_index = 0 ); 
+        bool parse_actions( const std::shared_ptr<soci::session>&, const chain::action& ,const std::string & transaction_id,const long long timestamp, uint32_t block_num, uint64_t ordinal = 0, uint32_t trx_index = 0, uint32_t action_index = 0);
+        string add_data( const std::shared_ptr<soci::session>&, const chain::action& );
         soci::rowset<soci::row> get_assets( std::shared_ptr<soci::session>, int ,int );
         soci::rowset<soci::row> get_assets( std::shared_ptr<soci::session> );
         soci::rowset<soci::row> get_proposal(std::shared_ptr<soci::session>, string );
+        void mark_dirty( const chain::action& , const fc::variant& );
+        // whether a table is fed from the data of the action, it is decoded at ingest then
+        static bool indexed( const chain::action& );
+        // writes the row through the sink and publishes it on the change stream
+        void write_event( soci::session&, const event_row& row );
+        // removes the event rows of the block from from_ordinal on, after its rows
+        void remove_events( soci::session&, uint32_t block_num, uint64_t from_ordinal );
+        // runs the write of the table on its strand, or on the session when there are none
+        void write( soci::session&, const std::string& table, const table_strands::task& f );
+
+        std::shared_ptr<dirty_accounts> m_dirty_accounts;
+        std::shared_ptr<action_history> m_history;
+        std::shared_ptr<action_log::writer> m_action_log;
+        std::shared_ptr<change_stream> m_changes;
+        // the table writes go through these when set, ingest only decodes
+        std::shared_ptr<table_strands> m_strands;
+        // skip the decoding of the actions that feed no table
+        bool m_raw_actions = false;
+        // a create wrote an asset since the assets were last loaded
+        std::atomic<bool> m_assets_changed{false};
+
+        // the abi of the account, null when it has none. built once from the accounts
+        // table and kept until a setabi of the account
+        std::shared_ptr<const contract_abi> abi_for( soci::session&, chain::name account );
+        void invalidate_abi( chain::name account );
 
         static const chain::account_name newaccount;
         static const chain::account_name setabi;
+
+    private:
+        // the JSON of one field of the action data, valid until the next call on the thread
+        static const std::string& json_field( const contract_abi&, const chain::action&, const std::string& field, const fc::variant& abi_data );
+
+        static const size_t abi_cache_size = 10000;
+
+        boost::mutex m_abi_mtx;
+        std::map<chain::name, std::shared_ptr<const contract_abi>> m_abi_cache;
 };
 
 
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <eosio/chain/block_state.hpp>
+#include <eosio/chain/transaction.hpp>
+#include <eosio/chain/types.hpp>
+
+namespace eosio {
+
+// the part of a block the index reads, unpacked from the block_state on the consumer
+// thread so the accepted_block handler of the main thread only queues the block state,
+// which is released once its record is taken. the actions of all transactions share a
+// few flat arrays, a block costs a handful of allocations whatever its number of actions.
+class block_record {
+    public:
+        struct transaction_entry {
+            chain::transaction_id_type id;
+            uint32_t                   index = 0;        // of the receipt in the block
+            fc::time_point_sec         expiration;
+            uint16_t                   ref_block_num = 0;
+            uint32_t                   ref_block_prefix = 0;
+            uint32_t                   cpu_usage_us = 0;
+            uint32_t                   net_usage_words = 0;
+            uint32_t                   first_action = 0;
+            uint32_t                   action_count = 0;
+        };
+
+        struct action_entry {
+            chain::name account;
+            chain::name name;
+            uint32_t    first_auth = 0;
+            uint32_t    auth_count = 0;
+            uint32_t    data_offset = 0;
+            uint32_t    data_size = 0;
+        };
+
+        explicit block_record( const chain::block_state_ptr& bs );
+
+        // bytes held by the record, for the queue limit
+        size_t bytes() const;
+
+        // the action copied out of the arena, load_action reuses the buffers of out
+        chain::action action( const action_entry& act ) const;
+        void load_action( const action_entry& act, chain::action& out ) const;
+
+        uint32_t                    block_num = 0;
+        uint32_t                    irreversible_num = 0;
+        chain::block_id_type        id;
+        chain::block_id_type        previous;
+        chain::block_timestamp_type timestamp;
+        chain::account_name         producer;
+        uint16_t                    confirmed = 0;
+        uint32_t                    schedule_version = 0;
+        chain::checksum256_type     transaction_mroot;
+        chain::checksum256_type     action_mroot;
+        fc::optional<chain::producer_schedule_type> new_producers;
+
+        std::vector<transaction_entry>       transactions;
+        std::vector<action_entry>            actions;
+        std::vector<chain::permission_level> authorizations;
+        std::vector<char>                    data;
+};
+
+typedef std::shared_ptr<const block_record> block_record_ptr;
+
+} // namespace
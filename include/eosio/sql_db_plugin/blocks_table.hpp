@@ -3,8 +3,10 @@
 #include <eosio/sql_db_plugin/table.hpp>
 
 #include <chrono>
+#include <string>
+#include <vector>
 
-#include <eosio/chain/block_state.hpp>
+#include <eosio/sql_db_plugin/block_record.hpp>
 
 namespace eosio {
 
@@ -12,10 +14,29 @@ class blocks_table : public mysql_table {
     public:
         blocks_table(){};
 
-        // void add(chain::signed_block_ptr block);
-        void add( std::shared_ptr<soci::session>, const chain::block_state_ptr& );
-        bool irreversible_set( std::shared_ptr<soci::session>, std::string , bool  );
-
+        // buffers the row of the block until the batch is taken
+        void add( const block_record& );
+        size_t pending() const { return m_rows.size(); }
+        // the buffered rows, the table is left empty
+        std::vector<std::string> take();
+        // the rows with a few multi row INSERTs, blocks already in the table are skipped
+        void write( soci::session&, const std::vector<std::string>& rows ) const;
+        // flags the blocks of the ids, false when the update failed
+        bool irreversible_set( std::shared_ptr<soci::session>, const std::vector<std::string>& block_ids );
+        struct link {
+            std::string block_id;
+            uint32_t    block_num = 0;
+            std::string prev_block_id;
+        };
+        // the blocks numbered first to last in the table, of every fork
+        std::vector<link> links( std::shared_ptr<soci::session>, uint32_t first, uint32_t last );
+        // the highest block flagged irreversible, 0 when there is none
+        uint32_t irreversible_block( std::shared_ptr<soci::session> );
+        // the highest block in the table, 0 when it is empty
+        uint32_t last_block( std::shared_ptr<soci::session> );
+
+    private:
+        std::vector<std::string> m_rows;
 };
 
 } // namespace
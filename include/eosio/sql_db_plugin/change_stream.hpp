@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <set>
+#include <string>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/atomic.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <fc/reflect/reflect.hpp>
+
+#include <eosio/sql_db_plugin/sql_sink.hpp>
+
+namespace eosio {
+
+struct change_field {
+    std::string column;
+    uint8_t     type = 0;        // event_row::kind
+    int64_t     integer = 0;
+    std::string text;
+};
+
+// one indexed row. rows of a block above the last irreversible block are published with
+// irreversible false, a "lib" frame with the new block number follows when it advances.
+struct change_frame {
+    uint64_t                  sequence = 0;
+    std::string               table;
+    uint32_t                  block_num = 0;
+    bool                      irreversible = false;
+    std::vector<change_field> fields;
+};
+
+struct change_stream_options {
+    std::string             socket_path;               // unix socket, disabled when empty
+    boost::filesystem::path file_dir;                  // rotating files, disabled when empty
+    uint64_t                file_bytes = 256*1024*1024;
+    uint32_t                file_count = 8;
+    bool                    binary = false;            // length prefixed fc::raw frames instead of NDJSON
+    size_t                  subscriber_buffer_bytes = 16*1024*1024;
+    size_t                  replay_frames = 100000;    // kept for subscribers resuming from a cursor
+};
+
+// publishes the rows ingest writes to local subscribers. a subscriber connects to the
+// socket and sends its cursor, the last sequence it has seen, as a decimal line ("0" for
+// everything still retained, "-" for new frames only). frames are queued per subscriber
+// up to subscriber_buffer_bytes, a subscriber falling further behind is disconnected
+// and resumes from its cursor, ingest never waits on a reader. the sequence continues
+// after the last frame of the change files across restarts, without files it starts
+// at the clock in microseconds.
+class change_stream : public boost::noncopyable {
+    public:
+        explicit change_stream( const change_stream_options& options );
+        ~change_stream();
+
+        void publish( const event_row& row, uint32_t block_num );
+        void set_irreversible( uint32_t block_num );
+        void flush();
+
+        uint64_t sequence() const { return m_sequence; }
+
+    private:
+        struct subscriber;
+        typedef std::shared_ptr<const std::string> frame_ptr;
+
+        void publish( change_frame& frame );
+        std::string encode( const change_frame& frame ) const;
+        void write_file( const std::string& data );
+        void rotate_file();
+
+        void accept();
+        void read_cursor( std::shared_ptr<subscriber> s );
+        void enqueue( const std::shared_ptr<subscriber>& s, const frame_ptr& frame );
+        void write_next( std::shared_ptr<subscriber> s );
+        void drop( const std::shared_ptr<subscriber>& s, const char* reason );
+
+        const change_stream_options m_options;
+        boost::atomic<uint32_t> m_irreversible{0};
+
+        // publish side, the ingest thread
+        boost::mutex m_mtx;
+        uint64_t m_sequence = 0;
+        std::deque<std::pair<uint64_t,frame_ptr>> m_replay;
+        std::FILE* m_file = nullptr;
+        uint64_t m_file_size = 0;
+        uint32_t m_file_index = 0;
+
+        // subscriber side, the io thread
+        boost::asio::io_service m_ios;
+        std::unique_ptr<boost::asio::io_service::work> m_work;
+        std::unique_ptr<boost::asio::local::stream_protocol::acceptor> m_acceptor;
+        std::set<std::shared_ptr<subscriber>> m_subscribers;
+        boost::thread m_thread;
+};
+
+} // namespace
+
+FC_REFLECT( eosio::change_field, (column)(type)(integer)(text) )
+FC_REFLECT( eosio::change_frame, (sequence)(table)(block_num)(irreversible)(fields) )
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace eosio {
+
+// zstd compression of the large JSON columns, done by the tables before the write and
+// after the read. a compressed value is stored as a JSON string, "~zstd:" and the base64
+// of the frame in quotes, so it still fits the json and TEXT columns of every backend and
+// the rows written before compression was enabled read back as they are.
+class column_codec {
+    public:
+        // compression off, encode returns the value
+        column_codec() = default;
+        // values shorter than min_bytes are stored as they are. the dictionary, when not
+        // empty, has to stay the same for as long as rows compressed with it are kept
+        column_codec( int level, size_t min_bytes, const std::string& dictionary );
+        ~column_codec();
+
+        bool enabled() const { return m_enabled; }
+
+        std::string encode( const std::string& value ) const;
+        // throws when the value is compressed and can not be decompressed
+        std::string decode( const std::string& stored ) const;
+        static bool compressed( const std::string& stored );
+
+        // a dictionary of up to max_bytes trained from sample values, empty when there
+        // are too few samples or zstd is not built in
+        static std::string train( const std::vector<std::string>& samples, size_t max_bytes );
+
+    private:
+        struct dictionaries;
+
+        bool   m_enabled = false;
+        int    m_level = 3;
+        size_t m_min_bytes = 0;
+        std::unique_ptr<dictionaries> m_dicts;
+};
+
+} // namespace
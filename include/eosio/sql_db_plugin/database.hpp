@@ -12,10 +12,18 @@
 #include <eosio/sql_db_plugin/blocks_table.hpp>
 #include <eosio/sql_db_plugin/actions_table.hpp>
 #include <eosio/sql_db_plugin/session_pool.hpp>
+#include <eosio/sql_db_plugin/resource_snapshot.hpp>
+#include <eosio/sql_db_plugin/sql_sink.hpp>
+#include <eosio/sql_db_plugin/block_record.hpp>
+
+#include "consumer_core.h"
 
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 
+#include <map>
+#include <set>
+
 namespace eosio {
 
 struct trace_and_block_time{
@@ -23,62 +31,94 @@ struct trace_and_block_time{
     chain::block_timestamp_type block_time;
 };
 
-class sql_database {
+class sql_database : public consumer_core<block_record_ptr> {
     public:
         sql_database(const std::string& uri, uint32_t block_num_start, size_t pool_size);
         sql_database(const std::string& uri, uint32_t block_num_start, size_t pool_size, std::vector<std::string>, std::vector<std::string>);
         
         void wipe();
+        void enable_history(const boost::filesystem::path& dir, uint64_t size_mb);
+        void enable_raw_actions();
+        // the codec of the abi and producers columns of every table
+        void set_column_codec(const std::shared_ptr<const column_codec>& codec);
+        // a zstd dictionary trained on the stored abis and producers lists, empty when
+        // there are too few of them
+        std::string train_column_dictionary(size_t max_bytes);
+        void enable_action_log(const boost::filesystem::path& dir, uint64_t segment_mb);
+        void enable_change_stream(const change_stream_options& options);
+        // the actions table writes run on strands of their own connections to the uri,
+        // the indexed block is the last one every strand has written
+        void enable_writer_strands(const std::string& uri, size_t strands);
+        // flags the blocks and transactions from the previous watermark up to the last
+        // irreversible block, those of the chain head_id is on. the blocks of forks that
+        // lost stay reversible
+        void mark_irreversible(uint32_t lib, const chain::block_id_type& head_id);
         bool is_started();
+        // indexes the blocks, one sink transaction per batch_blocks() of them
+        void consume( const std::vector<block_record_ptr>& blocks ) override;
+        // write false keeps the blocks and transactions rows buffered for a later block
+        void consume_block( const block_record&, bool write = true );
+        // the buffered blocks and transactions rows, on their strands when there are some
+        void write_rows( soci::session& );
+        // the last block up to consumed whose rows are all written
+        uint32_t written_block( uint32_t consumed ) const;
         void consume_block_state( const chain::block_state_ptr& );
         void consume_irreversible_block_state( const chain::block_state_ptr& , boost::mutex::scoped_lock& , boost::condition_variable& condition,boost::atomic<bool>& exit);
 
         void consume_transaction_metadata( const chain::transaction_metadata_ptr& );
         void consume_transaction_trace( const trace_and_block_time& );
 
-        void dfs_inline_traces( std::shared_ptr<soci::session>, vector<chain::action_trace>,  chain::transaction_id_type, chain::block_timestamp_type );
-        int get_min_account_id();
-        int get_max_account_id();
-        bool monitoraccount(int accountid);
-
-        bool update_token(std::string account);
-        void save_token(std::string account,std::string symbol,std::string quantity,int precision,std::string contract);
-        
-        bool update_stake(std::string account);
-        void save_stake(
-                std::string account,
-                int64_t liquid,
-                int64_t staked,
-                int64_t unstaking,
-                int64_t total,
-                int64_t total_stake,
-                int64_t totalasset,
-                int64_t cpu_total,
-                int64_t cpu_staked,
-                int64_t cpu_delegated,
-                int64_t cpu_used,
-                int64_t cpu_available,
-                int64_t cpu_limit,
-                int64_t net_total,
-                int64_t net_staked,
-                int64_t net_delegated,
-                int64_t net_used,
-                int64_t net_available,
-                int64_t net_limit,
-                int64_t ram_quota,
-                int64_t ram_usage
-                );
+        void dfs_inline_traces( const std::shared_ptr<soci::session>&, const vector<chain::action_trace>&, const chain::transaction_id_type&, chain::block_timestamp_type );
+        // retry queues the accounts of a failed refresh again, false for the sweep batches
+        bool refresh_accounts(const std::vector<chain::account_name>& accounts, bool retry = true);
+        bool snapshot_accounts(const std::vector<chain::account_name>& accounts, const std::vector<token_asset>& assets, std::vector<stake_row>& stakes, std::vector<token_row>& tokens, uint32_t& head_block_num);
+        std::vector<token_asset> load_token_assets();
+        // the assets loaded once, and again after a create of a new symbol
+        std::vector<token_asset> token_assets();
+        int64_t next_accounts(int64_t after_id, size_t limit, std::vector<chain::account_name>& accounts);
+        void save_stakes(const std::vector<stake_row>& rows);
+        void save_tokens(const std::vector<token_row>& rows);
 
+        std::shared_ptr<sql_sink> m_sink;
         std::shared_ptr<soci_session_pool> m_session_pool;
         std::unique_ptr<actions_table> m_actions_table;
         std::unique_ptr<accounts_table> m_accounts_table;
         std::unique_ptr<blocks_table> m_blocks_table;
         std::unique_ptr<transactions_table> m_transactions_table;
+        std::shared_ptr<dirty_accounts> m_dirty_accounts;
+        std::shared_ptr<action_history> m_history;
+        std::shared_ptr<action_log::writer> m_action_log;
+        std::shared_ptr<change_stream> m_changes;
+        std::shared_ptr<table_strands> m_strands;
+        // the highest block written, read from the blocks table once. a block at or below it
+        // replaces the rows of the one written before at its height
+        uint32_t m_last_block = 0;
+        bool m_last_block_loaded = false;
+        // blocks up to this one are flagged irreversible, read from the blocks table once
+        uint32_t m_irreversible = 0;
+        bool m_irreversible_loaded = false;
+        // the blocks consumed above the watermark, by id, to find the chain of the last
+        // irreversible one
+        struct unflagged_block {
+            uint32_t                 block_num = 0;
+            chain::block_id_type     previous;
+            std::vector<std::string> tx_ids;
+        };
+        std::map<chain::block_id_type, unflagged_block> m_unflagged;
+        // the blocks of the sink batches that failed to commit
+        std::set<uint32_t> m_unwritten;
+        boost::mutex m_assets_mtx;
+        std::vector<token_asset> m_token_assets;
+        bool m_token_assets_loaded = false;
         std::string system_account;
         uint32_t m_block_num_start;
         std::vector<std::string> m_action_filter_on;
         std::vector<std::string> m_contract_filter_out;
 
+    private:
+        // runs f on the main thread, which owns chainbase, and waits for its result
+        template<typename Result, typename Function>
+        bool on_main_thread( Function&& f, Result& result );
     };
 
 } // namespace
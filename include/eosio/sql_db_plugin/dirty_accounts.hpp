@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+#include <eosio/chain/types.hpp>
+
+namespace eosio {
+
+// accounts touched by ingested actions whose tokens and stake need a refresh.
+// an account is queued once no matter how often it is marked before being drained.
+class dirty_accounts {
+    public:
+        // refreshes of an account that fail before it is left to the sweep
+        static const uint32_t max_attempts = 5;
+
+        void mark( const chain::account_name& account ){
+            if( account.value == 0 ) return;
+            boost::mutex::scoped_lock lock(mtx);
+            if( pending.insert(account.value).second ){
+                order.emplace_back(account);
+            }
+        }
+
+        std::vector<chain::account_name> drain( size_t max ){
+            std::vector<chain::account_name> accounts;
+            boost::mutex::scoped_lock lock(mtx);
+            // the retries whose delay is over queue behind the marked accounts
+            const auto now = clock::now();
+            while( !delayed.empty() && delayed.begin()->first <= now ){
+                const auto account = delayed.begin()->second;
+                delayed.erase(delayed.begin());
+                if( pending.insert(account.value).second ) order.emplace_back(account);
+            }
+            while( !order.empty() && accounts.size() < max ){
+                accounts.emplace_back(order.front());
+                pending.erase(order.front().value);
+                order.pop_front();
+            }
+            return accounts;
+        }
+
+        // the refresh of the accounts failed, each is queued again after a delay doubling
+        // with its attempts. returns the accounts given up after max_attempts
+        size_t retry( const std::vector<chain::account_name>& accounts ){
+            size_t given_up = 0;
+            boost::mutex::scoped_lock lock(mtx);
+            const auto now = clock::now();
+            for(const auto& account : accounts){
+                auto& attempts = failures[account.value];
+                if( ++attempts >= max_attempts ){
+                    failures.erase(account.value);
+                    given_up++;
+                    continue;
+                }
+                delayed.emplace( now + std::chrono::seconds(1 << (attempts - 1)), account );
+            }
+            return given_up;
+        }
+
+        // the accounts were refreshed, their failed attempts are forgotten
+        void refreshed( const std::vector<chain::account_name>& accounts ){
+            boost::mutex::scoped_lock lock(mtx);
+            if( failures.empty() ) return;
+            for(const auto& account : accounts) failures.erase(account.value);
+        }
+
+        size_t size() const {
+            boost::mutex::scoped_lock lock(mtx);
+            return order.size() + delayed.size();
+        }
+
+    private:
+        typedef std::chrono::steady_clock clock;
+
+        mutable boost::mutex mtx;
+        std::unordered_set<uint64_t> pending;
+        std::deque<chain::account_name> order;
+        std::multimap<clock::time_point, chain::account_name> delayed;
+        std::unordered_map<uint64_t, uint32_t> failures;
+};
+
+}
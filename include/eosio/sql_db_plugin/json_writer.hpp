@@ -0,0 +1,71 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <eosio/chain/abi_def.hpp>
+#include <eosio/chain/types.hpp>
+
+#include <fc/variant.hpp>
+
+namespace eosio {
+
+// writes JSON into a reusable buffer, byte for byte what fc::json::to_string writes for
+// the same values: no spaces, integers above 0xffffffff quoted. strings and doubles fc
+// escapes or formats in ways of its own are handed to fc::json for that one value.
+class json_writer {
+    public:
+        void clear() { m_out.clear(); m_levels.clear(); m_after_key = false; }
+        const std::string& str() const { return m_out; }
+
+        json_writer& begin_object();
+        json_writer& end_object();
+        json_writer& begin_array();
+        json_writer& end_array();
+        json_writer& key( const char* k, size_t size );
+        json_writer& key( const std::string& k ) { return key(k.data(), k.size()); }
+
+        json_writer& string( const char* s, size_t size );
+        json_writer& string( const std::string& s ) { return string(s.data(), s.size()); }
+        json_writer& int64( int64_t v );
+        json_writer& uint64( uint64_t v );
+        json_writer& boolean( bool v );
+        json_writer& null();
+        json_writer& variant( const fc::variant& v );
+
+    private:
+        void separator();
+        void escaped( const char* s, size_t size );
+
+        std::string m_out;
+        std::vector<bool> m_levels;     // true once the level has an element
+        bool m_after_key = false;
+};
+
+// writes action data as JSON straight from its binary form and the ABI, the output of
+// fc::json::to_string(abi_serializer::binary_to_variant(...)) without the variant tree.
+// the writes return false on data or types the serializer would reject, the caller
+// then falls back to the serializer.
+class json_abi {
+    public:
+        explicit json_abi( const chain::abi_def& abi );
+
+        bool write_action( chain::name action, const char* data, size_t size, json_writer& out ) const;
+        // only the value of one field of the action struct
+        bool write_field( chain::name action, const char* data, size_t size, const std::string& field, json_writer& out ) const;
+
+    private:
+        const chain::struct_def* find_struct( const std::string& type ) const;
+        const std::string& resolve( const std::string& type ) const;
+        bool write_struct( const chain::struct_def& s, const char*& pos, const char* end, json_writer* out, int depth ) const;
+        bool seek_field( const chain::struct_def& s, const char*& pos, const char* end, const std::string& field, const chain::field_def*& found, int depth ) const;
+        bool write_type( const std::string& type, const char*& pos, const char* end, json_writer* out, int depth ) const;
+        bool write_builtin( const std::string& type, const char*& pos, const char* end, json_writer* out, bool& known ) const;
+
+        std::map<std::string, std::string>       m_typedefs;
+        std::map<std::string, chain::struct_def> m_structs;
+        std::map<chain::name, std::string>       m_actions;
+};
+
+} // namespace
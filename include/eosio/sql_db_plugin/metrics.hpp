@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+#include <boost/thread/shared_mutex.hpp>
+
+#include <eosio/chain/types.hpp>
+#include <fc/variant_object.hpp>
+
+namespace eosio {
+
+// log-linear histogram in the spirit of HdrHistogram: 8 sub-buckets per power of two,
+// so any recorded value is reported within 12.5%. recording is lock free.
+class latency_histogram {
+    public:
+        static constexpr int sub_bucket_bits = 3;
+        static constexpr int sub_buckets = 1 << sub_bucket_bits;
+        static constexpr int bucket_count = 64 * sub_buckets;
+
+        latency_histogram();
+
+        void record( uint64_t value );
+
+        uint64_t count() const { return total_count.load(std::memory_order_relaxed); }
+        uint64_t sum() const { return total_sum.load(std::memory_order_relaxed); }
+        uint64_t max() const { return max_value.load(std::memory_order_relaxed); }
+
+        // upper bound of the bucket holding the p-th percentile, p in [0,100]
+        uint64_t percentile( double p ) const;
+
+        static int bucket_of( uint64_t value );
+        static uint64_t bucket_upper_bound( int bucket );
+
+    private:
+        std::atomic<uint64_t> counts[bucket_count];
+        std::atomic<uint64_t> total_count;
+        std::atomic<uint64_t> total_sum;
+        std::atomic<uint64_t> max_value;
+};
+
+// counters created on first use, the lookup of an existing counter only takes a shared lock
+template<typename Key, typename Compare = std::less<Key>>
+class counter_map {
+    public:
+        template<typename K>
+        void increment( const K& key, uint64_t n = 1 ){
+            {
+                boost::shared_lock<boost::shared_mutex> lock(mtx);
+                auto it = counters.find(key);
+                if( it != counters.end() ){
+                    it->second->fetch_add(n, std::memory_order_relaxed);
+                    return;
+                }
+            }
+            boost::unique_lock<boost::shared_mutex> lock(mtx);
+            auto& counter = counters[Key(key)];
+            if( !counter ) counter = std::make_unique<std::atomic<uint64_t>>(0);
+            counter->fetch_add(n, std::memory_order_relaxed);
+        }
+
+        template<typename Function>
+        void for_each( Function f ) const {
+            boost::shared_lock<boost::shared_mutex> lock(mtx);
+            for(const auto& c : counters){
+                f( c.first, c.second->load(std::memory_order_relaxed) );
+            }
+        }
+
+    private:
+        mutable boost::shared_mutex mtx;
+        std::map<Key, std::unique_ptr<std::atomic<uint64_t>>, Compare> counters;
+};
+
+// where the ingest time goes, in microseconds
+enum class ingest_stage {
+    unpack,
+    abi_resolve,
+    decode,
+    sql_execute,
+    block,
+    pool_wait,
+    commit,
+    stage_count
+};
+
+const char* to_string( ingest_stage s );
+
+class sql_db_metrics {
+    public:
+        latency_histogram& stage( ingest_stage s ){ return stages[static_cast<int>(s)]; }
+
+        // the contracts other than these share one counter, so every label is bounded.
+        // set before ingest starts
+        void set_action_contracts( const std::set<chain::name>& contracts ){ action_contracts = contracts; }
+
+        void count_action( const chain::name& account, const chain::name& action ){
+            if( action_contracts.count(account) ) actions.increment( std::make_pair(account.value, action.value) );
+            else actions.increment( std::make_pair(uint64_t(0), uint64_t(0)) );
+        }
+
+        void count_table( const char* table, uint64_t rows = 1 ){
+            tables.increment( table, rows );
+        }
+
+        std::atomic<int64_t> queue_depth{0};
+        std::atomic<int64_t> queue_bytes{0};
+        std::atomic<uint32_t> head_block{0};
+        std::atomic<uint32_t> indexed_block{0};
+        std::atomic<uint32_t> irreversible_block{0};
+        std::atomic<uint64_t> blocks{0};
+        std::atomic<uint64_t> pool_waits{0};
+
+        fc::variant_object status() const;
+        std::string prometheus() const;
+
+    private:
+        latency_histogram stages[static_cast<int>(ingest_stage::stage_count)];
+        std::set<chain::name> action_contracts;
+        // (0, 0) counts the actions of the other contracts
+        counter_map<std::pair<uint64_t,uint64_t>> actions;
+        // transparent compare, counting a table does not build a string
+        counter_map<std::string, std::less<>> tables;
+};
+
+// process wide instance shared by the ingest threads and the status api
+sql_db_metrics& metrics();
+
+// records the time spent in a scope into a histogram
+class scoped_timer {
+    public:
+        scoped_timer( latency_histogram& h ):h(h),start(std::chrono::steady_clock::now()){}
+        ~scoped_timer(){
+            h.record( std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() );
+        }
+
+    private:
+        latency_histogram& h;
+        std::chrono::steady_clock::time_point start;
+};
+
+} // namespace
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <eosio/chain/asset.hpp>
+#include <eosio/chain/name.hpp>
+
+namespace eosio {
+
+// formatting of names and assets into caller buffers, without the per character
+// branches and the temporary strings of name::to_string and asset::to_string.
+// the output is the same as theirs.
+
+const size_t max_name_chars = 13;
+// "-922337203685477.5807 ABCDEFG", sign, 19 digits, point, space, 7 symbol chars
+const size_t max_asset_chars = 32;
+
+// writes the name without its trailing dots, returns the length, 0 for the empty name
+size_t format_name( uint64_t value, char* out );
+
+// the value of a name string, false when it is not a valid name
+bool parse_name( const char* s, size_t size, uint64_t& value );
+
+// the decimal amount with the given number of decimals, "-12.3400"
+size_t format_asset_amount( int64_t amount, uint8_t decimals, char* out );
+
+// the amount and the symbol, "12.3400 EOS" like asset::to_string
+size_t format_asset( const chain::asset& a, char* out );
+
+inline std::string name_string( chain::name n ) {
+    char buf[max_name_chars];
+    return std::string(buf, format_name(n.value, buf));
+}
+
+inline std::string asset_string( const chain::asset& a ) {
+    char buf[max_asset_chars];
+    return std::string(buf, format_asset(a, buf));
+}
+
+// the string of a contract or action name, formatted once per process. the string lives
+// as long as the process, so only intern names from a small set like the contract and
+// action names, not the accounts found in action data.
+const std::string& interned_name( chain::name n );
+
+} // namespace
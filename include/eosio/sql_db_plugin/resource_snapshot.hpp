@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+
+#include <eosio/chain/controller.hpp>
+#include <eosio/chain/asset.hpp>
+#include <eosio/chain/types.hpp>
+
+namespace eosio {
+
+// values of one row of the stakes table
+struct stake_row {
+    chain::account_name account;
+    int64_t liquid = 0;
+    int64_t staked = 0;
+    int64_t unstaking = 0;
+    int64_t total = 0;
+    int64_t total_stake = 0;
+    int64_t totalasset = 0;
+    int64_t cpu_total = 0;
+    int64_t cpu_staked = 0;
+    int64_t cpu_delegated = 0;
+    int64_t cpu_used = 0;
+    int64_t cpu_available = 0;
+    int64_t cpu_limit = 0;
+    int64_t net_total = 0;
+    int64_t net_staked = 0;
+    int64_t net_delegated = 0;
+    int64_t net_used = 0;
+    int64_t net_available = 0;
+    int64_t net_limit = 0;
+    int64_t ram_quota = 0;
+    int64_t ram_usage = 0;
+};
+
+// a token listed in the assets table
+struct token_asset {
+    chain::name      contract;
+    std::string      symbol;
+    uint64_t         symbol_code = 0;
+};
+
+// values of one row of the tokens table
+struct token_row {
+    chain::account_name account;
+    chain::name         contract;
+    std::string         symbol;
+    std::string         balance;
+    int                 precision = 0;
+};
+
+// amount of an asset as a decimal string without the symbol, "-12.3400"
+std::string format_asset_amount( const chain::asset& a );
+
+// binary layout of the system contract rows, only the leading fields we read
+namespace system_rows {
+
+struct user_resources {
+    chain::account_name owner;
+    chain::asset        net_weight;
+    chain::asset        cpu_weight;
+    int64_t             ram_bytes = 0;
+};
+
+struct delegated_bandwidth {
+    chain::account_name from;
+    chain::account_name to;
+    chain::asset        net_weight;
+    chain::asset        cpu_weight;
+};
+
+struct refund_request {
+    chain::account_name owner;
+    fc::time_point_sec  request_time;
+    chain::asset        net_amount;
+    chain::asset        cpu_amount;
+};
+
+struct voter_info {
+    chain::account_name              owner;
+    chain::account_name              proxy;
+    std::vector<chain::account_name> producers;
+    int64_t                          staked = 0;
+};
+
+} // namespace system_rows
+
+// reads stake and resource figures straight out of chainbase, without going through
+// the chain_plugin json apis. chainbase is not thread safe, call it from the main
+// thread (or while the main thread is blocked).
+class resource_snapshot {
+    public:
+        resource_snapshot(const chain::controller& chain):chain(chain){}
+
+        stake_row take( const chain::account_name& account ) const;
+        std::vector<stake_row> take( const std::vector<chain::account_name>& accounts ) const;
+
+        // balances of every account in every asset, accounts without a row are skipped
+        std::vector<token_row> tokens( const std::vector<chain::account_name>& accounts, const std::vector<token_asset>& assets ) const;
+
+    private:
+        template<typename Row>
+        bool find_row( const chain::name& code, const chain::name& scope, const chain::name& table, uint64_t primary, Row& row ) const;
+
+        const chain::controller& chain;
+};
+
+} // namespace
+
+FC_REFLECT( eosio::system_rows::user_resources, (owner)(net_weight)(cpu_weight)(ram_bytes) )
+FC_REFLECT( eosio::system_rows::delegated_bandwidth, (from)(to)(net_weight)(cpu_weight) )
+FC_REFLECT( eosio::system_rows::refund_request, (owner)(request_time)(net_amount)(cpu_amount) )
+FC_REFLECT( eosio::system_rows::voter_info, (owner)(proxy)(producers)(staked) )
@@ -1,22 +1,23 @@
 #pragma once
 #include <soci/soci.h>
-#include <soci/mysql/soci-mysql.h>
 #include <soci/connection-pool.h>
-//#include <mysql.h>
-//#include "/usr/local/mysql-8.0.11-macos10.13-x86_64/include/mysql.h"
-//#include "/usr/local/mysql-5.7.23-macos10.13-x86_64/include/mysql.h"
-#include "/usr/include/mysql/mysql.h"
+
+#include <chrono>
+#include <eosio/sql_db_plugin/metrics.hpp>
+#include <eosio/sql_db_plugin/sql_sink.hpp>
 namespace eosio{
 
     class soci_session_pool {
         public:
             std::shared_ptr<soci::connection_pool> c_pool_ptr;
+            std::shared_ptr<sql_sink> m_sink;
             
-            soci_session_pool(size_t pool_size,const std::string& uri){
+            soci_session_pool(size_t pool_size,const std::string& uri,std::shared_ptr<sql_sink> sink):m_sink(sink){
                 c_pool_ptr = std::make_shared<soci::connection_pool>(pool_size); 
                 for(size_t i=0 ; i < pool_size; i++){
                     soci::session& sql = c_pool_ptr->at(i);
                     sql.open(uri);
+                    m_sink->open(sql);
                 }
             }
 
@@ -25,8 +26,10 @@ namespace eosio{
                     sql << "select 1;";
                 } catch (std::exception& e) {
                     sql.reconnect();
+                    m_sink->open(sql);
                 } catch(...) {
                     sql.reconnect();
+                    m_sink->open(sql);
                 }
             }
 
@@ -42,15 +45,19 @@ namespace eosio{
             }
 
             void reconnect(std::shared_ptr<soci::session> sql_ptr){
-                soci::mysql_session_backend * mysqlBackEnd = static_cast<soci::mysql_session_backend *>(sql_ptr->get_backend());
-                int i = mysql_ping(mysqlBackEnd->conn_);
-                if(i==1){
+                if( !m_sink->ping(*sql_ptr) ){
                     sql_ptr->reconnect();
+                    m_sink->open(*sql_ptr);
                 }
             }
 
             std::shared_ptr<soci::session> get_session(){
+                auto start = std::chrono::steady_clock::now();
                 auto sql_ptr = std::make_shared<soci::session>(*c_pool_ptr);
+                auto waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+                metrics().stage(ingest_stage::pool_wait).record(waited);
+                if( waited >= 1000 ) metrics().pool_waits++;
+
                 try{// ubuntu os  try catch will lose, so direct reconnect
 
                     reconnect(sql_ptr);
@@ -8,6 +8,7 @@
 #include <eosio/chain_plugin/chain_plugin.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
 #include <eosio/sql_db_plugin/database.hpp>
+#include <eosio/sql_db_plugin/worker_pool.hpp>
 #include <appbase/application.hpp>
 #include <boost/signals2/connection.hpp>
 #include <memory>
@@ -30,9 +31,10 @@ class read_only{
         const controller& db;
         const fc::microseconds abi_serializer_max_time;
         const std::shared_ptr<sql_database> sql_db;
+        const std::shared_ptr<worker_pool> api_pool;
 
-        read_only(const controller& db, const fc::microseconds& abi_serializer_max_time, const std::shared_ptr<sql_database> sql_db)
-            : db(db), abi_serializer_max_time(abi_serializer_max_time),sql_db(sql_db) {
+        read_only(const controller& db, const fc::microseconds& abi_serializer_max_time, const std::shared_ptr<sql_database> sql_db, const std::shared_ptr<worker_pool> api_pool = nullptr)
+            : db(db), abi_serializer_max_time(abi_serializer_max_time),sql_db(sql_db),api_pool(api_pool) {
                 int a = 0;
                 a = a + 1;
             }
@@ -148,16 +150,22 @@ class read_only{
         template<typename Function, typename Function2>
         void walk_key_value_table(const name& code, const name& scope, const name& table, Function f, Function2 f2) const;
 
-        string asset_amount_to_string(asset cursor) const{
-            string sign = cursor.get_amount() < 0 ? "-" : "";
-            int64_t abs_amount = std::abs(cursor.get_amount());
-            string result = fc::to_string( static_cast<int64_t>(abs_amount) / cursor.precision());
-            if( cursor.decimals() )
-            {
-                auto fract = static_cast<int64_t>(abs_amount) % cursor.precision();
-                result += "." + fc::to_string(cursor.precision() + fract).erase(0,1);
+        // look up one token balance of account, fills tk and returns true when a row was produced
+        bool find_token( const account_name& account, token& tk, uint8_t default_precision, bool default_if_missing ) const;
+
+        // chainbase is only written by the main thread which is blocked while an api call runs,
+        // so the workers all read the same view of the state
+        template<typename Function>
+        void for_each_index( size_t count, Function&& f ) const {
+            if( api_pool ) {
+                api_pool->parallel_for( count, std::forward<Function>(f) );
+            } else {
+                for(size_t i = 0; i < count; i++) f(i);
             }
-            return sign + result;
+        }
+
+        string asset_amount_to_string(asset cursor) const{
+            return format_asset_amount(cursor);
         }
 
 };
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
+#include <boost/thread/mutex.hpp>
+
+#include <soci/soci.h>
+#include <fc/variant.hpp>
+
+namespace eosio {
+
+// replaces string and number literals by ? and folds repeated VALUES groups,
+// statements built with different values end up under one template
+std::string normalize_statement( const std::string& sql );
+
+// count, latency, rows affected and errors per statement template
+class sql_profiler {
+    public:
+        struct statement_stats {
+            uint64_t count = 0;
+            uint64_t total_us = 0;
+            uint64_t max_us = 0;
+            uint64_t rows = 0;
+            uint64_t errors = 0;
+        };
+
+        // the template of a statement text is computed once, a text seen again is looked up by its
+        // hash and compared with the cached text, a colliding text replaces the cached one
+        void record( const char* sql, uint64_t elapsed_us, uint64_t rows, bool error );
+        // for statements built with literal values, whose texts are never the same twice
+        void record_template( const std::string& statement, uint64_t elapsed_us, uint64_t rows, bool error );
+
+        // statements slower than this are logged, 0 disables the log
+        void set_slow_threshold_ms( uint32_t ms ){ slow_us = uint64_t(ms) * 1000; }
+
+        // the limit slowest templates by total time
+        fc::variants dump( size_t limit ) const;
+        void reset();
+
+    private:
+        static const size_t template_cache_size = 10000;
+
+        std::atomic<uint64_t> slow_us{0};
+
+        mutable boost::mutex mtx;
+        std::unordered_map<std::string, statement_stats> statements;
+        struct cached_template {
+            std::string text;
+            std::string key;
+        };
+        // hash of a statement text -> the text and its template
+        std::unordered_map<size_t, cached_template> templates;
+};
+
+// process wide instance shared by all sessions
+sql_profiler& profiler();
+
+// times one statement, recorded as failed unless done() is reached. the text is not
+// copied, it has to outlive the timer
+//
+//   statement_timer timer(*session, "SELECT ...");
+//   *session << timer.sql(), soci::into(x), soci::use(y);
+//   timer.done();
+//
+// a statement built with literal values passes its template, the text is then never scanned
+class statement_timer {
+    public:
+        statement_timer( soci::session& session, const std::string& sql, const char* statement = nullptr ):
+            session(session),sql_text(sql.c_str()),statement(statement),start(std::chrono::steady_clock::now()){}
+        statement_timer( soci::session& session, const char* sql ):
+            session(session),sql_text(sql),start(std::chrono::steady_clock::now()){}
+        statement_timer( soci::session&, std::string&&, const char* = nullptr ) = delete;
+        ~statement_timer(){ if( !finished ) finish(true); }
+
+        const char* sql() const { return sql_text; }
+        void done(){ finish(false); }
+
+    private:
+        void finish( bool error );
+
+        soci::session& session;
+        const char* sql_text;
+        const char* statement = nullptr;
+        std::chrono::steady_clock::time_point start;
+        bool finished = false;
+};
+
+} // namespace
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <soci/soci.h>
+
+#include <eosio/chain/name.hpp>
+#include <eosio/sql_db_plugin/name_format.hpp>
+
+#include <boost/thread/mutex.hpp>
+
+namespace eosio {
+
+// the append only tables of the event rows
+const char* const event_tables[] = { "votes", "buyram", "sellram", "delegatebw", "undelegatebw", "regproducer", "transfer" };
+
+// one row of an append only event table (votes, transfer, ...). every field keeps its
+// native value next to its text so each sink can bind the representation it stores.
+class event_row {
+    public:
+        enum class kind { name, text, integer, checksum, time };
+
+        struct field {
+            const char* column;
+            kind        type;
+            int64_t     integer;
+            std::string text;
+        };
+
+        explicit event_row( const char* table ):table(table){}
+
+        event_row& name( const char* column, chain::name v ) { fields.push_back({column, kind::name, int64_t(v.value), name_string(v)}); return *this; }
+        event_row& text( const char* column, std::string v ) { fields.push_back({column, kind::text, 0, std::move(v)}); return *this; }
+        event_row& integer( const char* column, int64_t v ) { fields.push_back({column, kind::integer, v, std::string()}); return *this; }
+        // hex string of a transaction or block id
+        event_row& checksum( const char* column, std::string hex ) { fields.push_back({column, kind::checksum, 0, std::move(hex)}); return *this; }
+        // seconds since epoch
+        event_row& time( const char* column, int64_t seconds ) { fields.push_back({column, kind::time, seconds, std::string()}); return *this; }
+        // the action the row comes from, unique in the table. a replayed block writes the
+        // same rows again and the block that wins a fork replaces the rows of the orphaned
+        // one at the same positions. rows without an ordinal have no key and are always appended
+        event_row& key( uint32_t block, uint64_t action_ordinal ) { block_num = block; ordinal = action_ordinal; return *this; }
+
+        const char* table;
+        std::vector<field> fields;
+        uint32_t block_num = 0;
+        uint64_t ordinal = 0;
+};
+
+// where the indexed rows end up. sql_database and the tables write plain SQL through
+// soci, the sink owns what differs between the backends: opening and pinging a
+// connection, creating the schema, the upsert syntax and how blocks are batched.
+class sql_sink {
+    public:
+        virtual ~sql_sink(){}
+
+        // picks the sink from the uri scheme, mysql://, sqlite3:// or postgresql://
+        static std::shared_ptr<sql_sink> create( const std::string& uri );
+
+        virtual const char* name() const = 0;
+
+        // connections the sink can use for the requested pool size
+        virtual size_t pool_size( size_t requested ) const { return requested; }
+
+        // called on every new or reconnected session of the pool
+        virtual void open( soci::session& ) {}
+        // true when the session is still usable
+        virtual bool ping( soci::session& ) { return true; }
+
+        // creates the tables when the backend does not use eos.sql
+        virtual void create_schema( soci::session& ) {}
+
+        // "ON DUPLICATE KEY UPDATE ..." or "ON CONFLICT(...) DO UPDATE SET ...", columns
+        // are updated from the inserted row, "col=expr" entries are taken as they are
+        virtual std::string upsert( const std::string& keys, const std::vector<std::string>& columns ) const = 0;
+        // the clause keeping the existing row when the keys are already there
+        virtual std::string ignore_duplicate( const std::string& keys ) const = 0;
+
+        // appends an event row, an INSERT unless the sink buffers the rows until commit().
+        // a row whose key is already in the table is skipped
+        virtual void write_event( soci::session&, const event_row& row );
+        // removes the rows of the block from from_ordinal on, those of a fork block with
+        // more actions than the one written after it at the same height
+        virtual void remove_events( soci::session&, const char* table, uint32_t block_num, uint64_t from_ordinal );
+
+        // blocks per transaction, 0 leaves every statement in autocommit
+        virtual uint32_t batch_blocks() const { return 0; }
+        virtual void set_batch_blocks( uint32_t ) {}
+        virtual void begin( soci::session& ) {}
+        // throws when rows of the batch could not be written
+        virtual void commit( soci::session& ) {}
+        virtual void rollback( soci::session& ) {}
+};
+
+class mysql_sink : public sql_sink {
+    public:
+        const char* name() const override { return "mysql"; }
+        bool ping( soci::session& ) override;
+        std::string upsert( const std::string& keys, const std::vector<std::string>& columns ) const override;
+        std::string ignore_duplicate( const std::string& keys ) const override;
+};
+
+// embedded database for single node setups and tests: one writer connection in WAL
+// mode so the API pool can keep reading, and one transaction per batch of blocks
+class sqlite_sink : public sql_sink {
+    public:
+        explicit sqlite_sink( uint32_t batch_blocks = 100 ):m_batch_blocks(batch_blocks){}
+
+        const char* name() const override { return "sqlite3"; }
+        size_t pool_size( size_t ) const override { return 1; }
+        void open( soci::session& ) override;
+        void create_schema( soci::session& ) override;
+        std::string upsert( const std::string& keys, const std::vector<std::string>& columns ) const override;
+        std::string ignore_duplicate( const std::string& keys ) const override;
+
+        uint32_t batch_blocks() const override { return m_batch_blocks; }
+        void set_batch_blocks( uint32_t blocks ) override { m_batch_blocks = blocks; }
+        void begin( soci::session& ) override;
+        void commit( soci::session& ) override;
+        void rollback( soci::session& ) override;
+
+    private:
+        uint32_t m_batch_blocks;
+};
+
+// streams the event rows with binary COPY FROM STDIN, ids are bytea in the event tables. begin() and commit() bound the rows sent by one COPY per table, every
+// other statement still runs in autocommit on any connection of the pool.
+class postgresql_sink : public sql_sink {
+    public:
+        explicit postgresql_sink( uint32_t batch_blocks = 100 ):m_batch_blocks(batch_blocks){}
+
+        const char* name() const override { return "postgresql"; }
+        bool ping( soci::session& ) override;
+        void create_schema( soci::session& ) override;
+        std::string upsert( const std::string& keys, const std::vector<std::string>& columns ) const override;
+        std::string ignore_duplicate( const std::string& keys ) const override;
+        void write_event( soci::session&, const event_row& row ) override;
+        void remove_events( soci::session&, const char* table, uint32_t block_num, uint64_t from_ordinal ) override;
+
+        uint32_t batch_blocks() const override { return m_batch_blocks; }
+        void set_batch_blocks( uint32_t blocks ) override { m_batch_blocks = blocks; }
+        void commit( soci::session& ) override;
+        void rollback( soci::session& ) override;
+
+    private:
+        struct copy_buffer {
+            std::string columns;
+            // the columns of the row fields, replaced when the key is already there
+            std::vector<std::string> fields;
+            std::string data;
+            size_t rows = 0;
+            // where each row starts in data and its key, to stage the rows one by one
+            // when the COPY of the batch fails
+            std::vector<size_t> offsets;
+            std::vector<std::pair<uint32_t, uint64_t>> keys;
+        };
+
+        uint32_t m_batch_blocks;
+
+        struct removal {
+            const char* table;
+            uint32_t    block_num;
+            uint64_t    from_ordinal;
+        };
+
+        boost::mutex m_mtx;
+        std::map<std::string, copy_buffer> m_buffers;
+        // run by commit() after the rows they may remove are written
+        std::vector<removal> m_removals;
+};
+
+} // namespace
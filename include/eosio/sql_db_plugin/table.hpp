@@ -7,11 +7,18 @@
 #include <fc/variant.hpp>
 #include <fc/time.hpp>
 
+#include <eosio/sql_db_plugin/sql_sink.hpp>
+#include <eosio/sql_db_plugin/column_codec.hpp>
+
 namespace eosio{
 
 class mysql_table{
     public:
         fc::microseconds max_serialization_time = fc::microseconds(150*1000);
+        // backend specific SQL, mysql unless sql_database sets another one
+        std::shared_ptr<sql_sink> m_sink = std::make_shared<mysql_sink>();
+        // compression of the abi and producers columns, off unless sql_database enables it
+        std::shared_ptr<const column_codec> m_codec = std::make_shared<column_codec>();
 
 };
 
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <eosio/sql_db_plugin/session_pool.hpp>
+
+namespace eosio {
+
+// writer strands: the writes of independent tables run on their own thread and
+// connection, so one slow table does not hold back the others. the writes of a table
+// keep the order they were posted in. end_block() closes a block on every strand and
+// checkpoint() is the last block all the strands have written.
+class table_strands {
+    public:
+        using task = std::function<void(soci::session&)>;
+
+        // strands connections of their own to the uri. max_pending bounds the tasks
+        // queued on one strand, post() waits while the strand is full
+        table_strands( const std::string& uri, const std::shared_ptr<sql_sink>& sink, size_t strands, size_t max_pending = 10000 );
+        ~table_strands();
+
+        size_t size() const { return m_strands.size(); }
+
+        // queues f on the strand of the table. the tables are spread over the strands in
+        // the order they are first seen, a table always stays on its strand
+        void post( const std::string& table, task f );
+        // every task posted before belongs to the block
+        void end_block( uint32_t block_num );
+        // the last block whose writes are done on every strand, 0 before the first one.
+        // a strand with a failed write stays below that block until it is written again
+        uint32_t checkpoint();
+        // returns once every task posted to the strand of the table is done
+        void wait( const std::string& table );
+        void wait_all();
+
+    private:
+        struct strand;
+
+        strand& strand_of( const std::string& table );
+
+        std::shared_ptr<soci_session_pool> m_pool;
+        size_t m_max_pending;
+        std::vector<std::unique_ptr<strand>> m_strands;
+
+        boost::mutex m_mtx;
+        std::map<std::string, size_t> m_tables;
+};
+
+} // namespace
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <eosio/sql_db_plugin/table.hpp>
-#include <eosio/chain/transaction_metadata.hpp>
+#include <eosio/sql_db_plugin/block_record.hpp>
+
+#include <string>
+#include <vector>
 
 namespace eosio {
 
@@ -9,10 +12,22 @@ class transactions_table : public mysql_table {
     public:
         transactions_table(){};
 
-        void add( std::shared_ptr<soci::session>, chain::transaction  );
-        void irreversible_set( std::shared_ptr<soci::session>, std::string , bool , std::string  );
+        // buffers a row per transaction of the block until the batch is taken
+        void add( const block_record& );
+        size_t pending() const { return m_rows.size(); }
+        // the buffered rows, the table is left empty
+        std::vector<std::string> take();
+        // the rows with a few multi row INSERTs
+        void write( soci::session&, const std::vector<std::string>& rows ) const;
+        // flags the transactions of the blocks numbered first to last, false when the update
+        // failed. only for a range without forks, a transaction of a fork block has its number too
+        bool irreversible_set( std::shared_ptr<soci::session>, uint32_t first, uint32_t last );
+        // flags the transactions of the ids
+        bool irreversible_set( std::shared_ptr<soci::session>, const std::vector<std::string>& tx_ids );
         bool find_transaction( std::shared_ptr<soci::session>, std::string );
 
+    private:
+        std::vector<std::string> m_rows;
     };
 
 } // namespace
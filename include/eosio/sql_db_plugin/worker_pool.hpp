@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace eosio {
+
+// fixed size pool used to fan read requests out over several cores.
+class worker_pool {
+    public:
+        worker_pool(size_t threads):
+            work(std::make_unique<boost::asio::io_service::work>(ios)),
+            size(threads)
+        {
+            for(size_t i = 0; i < size; i++){
+                workers.create_thread([this]{ ios.run(); });
+            }
+        }
+
+        ~worker_pool(){
+            work.reset();
+            ios.stop();
+            workers.join_all();
+        }
+
+        size_t threads() const { return size; }
+
+        // calls f(i) for every i in [0,count) and returns when all calls are done.
+        // the calling thread takes part in the work, f must not throw.
+        template<typename Function>
+        void parallel_for( size_t count, Function&& f ){
+            if( size == 0 || count < 2 ){
+                for(size_t i = 0; i < count; i++) f(i);
+                return;
+            }
+
+            std::atomic<size_t> next{0};
+            auto run = [&]{
+                for(size_t i = next++; i < count; i = next++) f(i);
+            };
+
+            size_t helpers = std::min(count - 1, size);
+            size_t pending = helpers;
+            boost::mutex mtx;
+            boost::condition_variable done;
+
+            for(size_t i = 0; i < helpers; i++){
+                ios.post([&]{
+                    run();
+                    boost::mutex::scoped_lock lock(mtx);
+                    if( --pending == 0 ) done.notify_one();
+                });
+            }
+
+            run();
+
+            boost::mutex::scoped_lock lock(mtx);
+            while( pending > 0 ) done.wait(lock);
+        }
+
+    private:
+        boost::asio::io_service ios;
+        std::unique_ptr<boost::asio::io_service::work> work;
+        boost::thread_group workers;
+        size_t size;
+};
+
+}
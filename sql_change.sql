@@ -9,7 +9,10 @@ CREATE TABLE `buyram` (
   `tran_id` varchar(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL DEFAULT '',  
   `quant` varchar(30) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL DEFAULT '',
   `block_time` datetime NOT NULL DEFAULT CURRENT_TIMESTAMP COMMENT '时间',
-  PRIMARY KEY (`id`)
+  `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  PRIMARY KEY (`id`),
+  UNIQUE KEY `idx_buyram_action` (`block_num`,`action_ordinal`)
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci;
 
 DROP TABLE IF EXISTS `sellram`;
@@ -21,7 +24,10 @@ CREATE TABLE `sellram` (
   `account` varchar(16) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL,
   `bytes` bigint(20) NOT NULL DEFAULT '0' COMMENT '',
   `block_time` datetime NOT NULL DEFAULT CURRENT_TIMESTAMP COMMENT '时间',
-  PRIMARY KEY (`id`)
+  `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  PRIMARY KEY (`id`),
+  UNIQUE KEY `idx_sellram_action` (`block_num`,`action_ordinal`)
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci;
 
 DROP TABLE IF EXISTS `delegatebw`;
@@ -35,7 +41,10 @@ CREATE TABLE `delegatebw` (
   `stake_net_quantity` varchar(30) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL DEFAULT '',
   `stake_cpu_quantity` varchar(30) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL DEFAULT '',
   `block_time` datetime NOT NULL DEFAULT CURRENT_TIMESTAMP COMMENT '时间',
-  PRIMARY KEY (`id`)
+  `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  PRIMARY KEY (`id`),
+  UNIQUE KEY `idx_delegatebw_action` (`block_num`,`action_ordinal`)
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci;
 
 DROP TABLE IF EXISTS `undelegatebw`;
@@ -49,7 +58,10 @@ CREATE TABLE `undelegatebw` (
   `unstake_cpu_quantity` varchar(30) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL DEFAULT '',
   `tran_id` varchar(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL DEFAULT '',
   `block_time` datetime NOT NULL DEFAULT CURRENT_TIMESTAMP COMMENT '时间',
-  PRIMARY KEY (`id`)
+  `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  PRIMARY KEY (`id`),
+  UNIQUE KEY `idx_undelegatebw_action` (`block_num`,`action_ordinal`)
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci;
 
 DROP TABLE IF EXISTS `regproducer`;
@@ -62,7 +74,10 @@ CREATE TABLE `regproducer` (
   `url` varchar(100) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL DEFAULT '',
   `tran_id` varchar(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL DEFAULT '',
   `block_time` datetime NOT NULL DEFAULT CURRENT_TIMESTAMP COMMENT '时间',
-  PRIMARY KEY (`id`)
+  `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  PRIMARY KEY (`id`),
+  UNIQUE KEY `idx_regproducer_action` (`block_num`,`action_ordinal`)
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci;
 
 
@@ -77,7 +92,10 @@ CREATE TABLE `transfer` (
   `memo` varchar(2000) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL DEFAULT '',
   `tran_id` varchar(64) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL DEFAULT '',
   `block_time` datetime NOT NULL DEFAULT CURRENT_TIMESTAMP COMMENT '时间',
-  PRIMARY KEY (`id`)
+  `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  PRIMARY KEY (`id`),
+  UNIQUE KEY `idx_transfer_action` (`block_num`,`action_ordinal`)
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci;
 
 
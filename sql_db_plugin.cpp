@@ -7,25 +7,75 @@
 // #include "database.hpp"
 #include "consumer.hpp"
 
+#include <eosio/http_plugin/http_plugin.hpp>
+#include <eosio/sql_db_plugin/metrics.hpp>
+#include <eosio/sql_db_plugin/sql_profiler.hpp>
+
+#include <fc/io/fstream.hpp>
 #include <fc/io/json.hpp>
 #include <fc/utf8.hpp>
 #include <fc/variant.hpp>
+#include <fc/variant_object.hpp>
 
 #include <boost/algorithm/string.hpp>
 
+#include <fstream>
+#include <set>
+
 namespace {
 const char* BLOCK_START_OPTION = "sql_db-block-start";
 const char* BUFFER_SIZE_OPTION = "sql_db-queue-size";
+const char* BUFFER_BYTES_OPTION = "sql_db-queue-mb";
 const char* SQL_DB_URI_OPTION = "sql_db-uri";
 const char* SQL_DB_ACTION_FILTER_ON = "sql_db-action-filter-on";
 const char* SQL_DB_CONTRACT_FILTER_OUT = "sql_db-contract-filter-out";
 const char* TRACE_START_OPTION = "sql_db-trace-start";
+const char* API_THREADS_OPTION = "sql_db-api-threads";
+const char* MONITOR_THREADS_OPTION = "sql_db-monitor-threads";
+const char* MONITOR_RATE_OPTION = "sql_db-monitor-rate";
+const char* MONITOR_BATCH_OPTION = "sql_db-monitor-batch";
+const char* MONITOR_SWEEP_OPTION = "sql_db-monitor-sweep-ms";
+const char* SLOW_STATEMENT_OPTION = "sql_db-slow-statement-ms";
+const char* SINK_BATCH_OPTION = "sql_db-batch-blocks";
+const char* HISTORY_DIR_OPTION = "sql_db-history-dir";
+const char* HISTORY_SIZE_OPTION = "sql_db-history-size-mb";
+const char* RAW_ACTIONS_OPTION = "sql_db-raw-actions";
+const char* HOT_CONTRACTS_OPTION = "sql_db-hot-contracts";
+const char* ACTION_LOG_DIR_OPTION = "sql_db-action-log-dir";
+const char* ACTION_LOG_SEGMENT_OPTION = "sql_db-action-log-segment-mb";
+const char* CDC_SOCKET_OPTION = "sql_db-cdc-socket";
+const char* CDC_DIR_OPTION = "sql_db-cdc-dir";
+const char* CDC_FILE_SIZE_OPTION = "sql_db-cdc-file-mb";
+const char* CDC_FILE_COUNT_OPTION = "sql_db-cdc-files";
+const char* CDC_FORMAT_OPTION = "sql_db-cdc-format";
+const char* CDC_BUFFER_OPTION = "sql_db-cdc-subscriber-buffer-mb";
+const char* COMPRESS_COLUMNS_OPTION = "sql_db-compress-columns";
+const char* COMPRESS_LEVEL_OPTION = "sql_db-compress-level";
+const char* COMPRESS_MIN_BYTES_OPTION = "sql_db-compress-min-bytes";
+const char* COMPRESS_DICTIONARY_OPTION = "sql_db-compress-dictionary";
+const char* WRITER_STRANDS_OPTION = "sql_db-writer-strands";
+const char* METRICS_CONTRACTS_OPTION = "sql_db-metrics-contracts";
 }
 
 namespace fc { class variant; }
 
 namespace eosio {
 
+    namespace {
+        // the records with the data of their actions decoded under "data", null when
+        // the history has no abi for it
+        fc::variants history_json( action_history& history, const std::vector<action_history_record>& records, bool decode ) {
+            fc::variants result;
+            result.reserve(records.size());
+            for(const auto& record : records){
+                fc::mutable_variant_object obj( fc::variant(record) );
+                if( decode ) obj("data", history.decode(record));
+                result.emplace_back( std::move(obj) );
+            }
+            return result;
+        }
+    }
+
     static appbase::abstract_plugin& _sql_db_plugin = app().register_plugin<sql_db_plugin>();
 
     class sql_db_plugin_impl  {
@@ -36,6 +86,8 @@ namespace eosio {
             bool start_parse_trace = false;
             chain_plugin* chain_plug = nullptr;
             std::shared_ptr<sql_database> sql_db;
+            std::shared_ptr<worker_pool> api_pool;
+            std::shared_ptr<action_history> history;
 
             std::unique_ptr<consumer> handler;
             std::vector<std::string> contract_filter_out;
@@ -60,6 +112,7 @@ namespace eosio {
     };
 
     void sql_db_plugin_impl::accepted_block( const chain::block_state_ptr& bs ) {
+        metrics().head_block = bs->block_num;
         handler->push_block_state(bs);
     }
 
@@ -76,7 +129,7 @@ namespace eosio {
 
     sql_db_apis::read_only  sql_db_plugin::get_read_only_api()const { 
 
-        return sql_db_apis::read_only(my->chain_plug->chain(),my->chain_plug->get_abi_serializer_max_time(),my->sql_db); 
+        return sql_db_apis::read_only(my->chain_plug->chain(),my->chain_plug->get_abi_serializer_max_time(),my->sql_db,my->api_pool); 
     }
 
     void sql_db_plugin::set_program_options(options_description& cli, options_description& cfg) {
@@ -85,17 +138,71 @@ namespace eosio {
         cfg.add_options()
                 (BUFFER_SIZE_OPTION, bpo::value<uint>()->default_value(5000),
                 "The queue size between nodeos and SQL DB plugin thread.")
+                (BUFFER_BYTES_OPTION, bpo::value<uint32_t>()->default_value(1024),
+                "MiB of queued blocks between nodeos and SQL DB plugin thread, 0 for no limit but sql_db-queue-size.")
                 (BLOCK_START_OPTION, bpo::value<uint32_t>()->default_value(0),
                 "The block to start sync.")
                 (SQL_DB_URI_OPTION, bpo::value<std::string>(),
                 "Sql DB URI connection string"
-                " If not specified then plugin is disabled. Default database 'EOS' is used if not specified in URI.")
+                " If not specified then plugin is disabled. Default database 'EOS' is used if not specified in URI."
+                " sqlite3://db=<file> indexes into an embedded SQLite database, postgresql://dbname=<db> into PostgreSQL.")
                 (SQL_DB_ACTION_FILTER_ON,bpo::value<std::string>(),
                 "saved action with filter on")
                 (SQL_DB_CONTRACT_FILTER_OUT,bpo::value<std::string>(),
                 "saved action without filter out")
                 (TRACE_START_OPTION,bpo::value<std::string>()->default_value(""),
                 "The trace to start sync.")
+                (API_THREADS_OPTION, bpo::value<uint32_t>()->default_value(4),
+                "Number of threads used by read apis that look up many token contracts, 0 to run them serially.")
+                (MONITOR_THREADS_OPTION, bpo::value<uint32_t>()->default_value(2),
+                "Number of threads refreshing the tokens and stakes tables, 0 to disable.")
+                (MONITOR_RATE_OPTION, bpo::value<uint32_t>()->default_value(500),
+                "Maximum number of accounts refreshed per second, bounds the chainbase reads done on the main thread. 0 for no limit.")
+                (MONITOR_BATCH_OPTION, bpo::value<uint32_t>()->default_value(100),
+                "Number of accounts read from chainbase in one pass and written with one statement per table.")
+                (MONITOR_SWEEP_OPTION, bpo::value<uint32_t>()->default_value(100),
+                "Milliseconds between two batches of the background tokens/stakes sweep, 0 to only refresh accounts touched by new actions.")
+                (SLOW_STATEMENT_OPTION, bpo::value<uint32_t>()->default_value(0),
+                "Log statements taking longer than this many milliseconds, 0 to disable.")
+                (SINK_BATCH_OPTION, bpo::value<uint32_t>()->default_value(100),
+                "Blocks written in one transaction to sqlite3, or with one COPY per event table to postgresql. Not used with mysql.")
+                (HISTORY_DIR_OPTION, bpo::value<boost::filesystem::path>(),
+                "Keep the account action history in an embedded database in this directory, relative to the data dir. Disabled if not set.")
+                (HISTORY_SIZE_OPTION, bpo::value<uint64_t>()->default_value(16*1024),
+                "Maximum size in MiB of the action history database.")
+                (RAW_ACTIONS_OPTION, bpo::value<bool>()->default_value(false),
+                "Do not decode the actions that feed no SQL table. The history stores their data as it is and decodes it when read.")
+                (HOT_CONTRACTS_OPTION, bpo::value<std::string>(),
+                "Comma separated contracts whose raw actions the history decodes in the background, also listing them under the accounts of their data.")
+                (ACTION_LOG_DIR_OPTION, bpo::value<boost::filesystem::path>(),
+                "Append the decoded actions of every block to a segmented binary log in this directory, relative to the data dir. Disabled if not set.")
+                (ACTION_LOG_SEGMENT_OPTION, bpo::value<uint64_t>()->default_value(1024),
+                "Size in MiB at which the action log starts a new segment.")
+                (CDC_SOCKET_OPTION, bpo::value<std::string>(),
+                "Publish the indexed rows on this unix socket. A subscriber sends the last sequence it has seen, \"0\" or \"-\" and a newline.")
+                (CDC_DIR_OPTION, bpo::value<boost::filesystem::path>(),
+                "Also write the published rows to rotating files in this directory, relative to the data dir.")
+                (CDC_FILE_SIZE_OPTION, bpo::value<uint64_t>()->default_value(256),
+                "Size in MiB at which the change files rotate.")
+                (CDC_FILE_COUNT_OPTION, bpo::value<uint32_t>()->default_value(8),
+                "Number of change files kept, 0 keeps them all.")
+                (CDC_FORMAT_OPTION, bpo::value<std::string>()->default_value("ndjson"),
+                "Frame format of the change stream: ndjson, or binary for length prefixed fc::raw frames.")
+                (CDC_BUFFER_OPTION, bpo::value<uint32_t>()->default_value(16),
+                "MiB queued per change stream subscriber before it is disconnected.")
+                (COMPRESS_COLUMNS_OPTION, bpo::value<bool>()->default_value(false),
+                "Store the accounts.abi and votes.producers values zstd compressed. The rows written before stay readable.")
+                (COMPRESS_LEVEL_OPTION, bpo::value<int>()->default_value(3),
+                "zstd level of the compressed columns.")
+                (COMPRESS_MIN_BYTES_OPTION, bpo::value<uint32_t>()->default_value(256),
+                "Column values shorter than this many bytes are stored uncompressed.")
+                (COMPRESS_DICTIONARY_OPTION, bpo::value<boost::filesystem::path>()->default_value("sql_db-columns.zdict"),
+                "zstd dictionary of the compressed columns, relative to the data dir. Trained from the stored values and written there when missing,"
+                " it must not change while rows compressed with it are kept.")
+                (WRITER_STRANDS_OPTION, bpo::value<uint32_t>()->default_value(0),
+                "Write the blocks, transactions, event, accounts, assets and proposal tables on this many threads, each with its own connection, mysql only. 0 writes them on the ingest thread.")
+                (METRICS_CONTRACTS_OPTION, bpo::value<std::string>()->default_value("eosio,eosio.token,eosio.msig"),
+                "Comma separated contracts whose actions are counted by name in the metrics, the actions of the other contracts are counted as other.")
                 ;
     }
 
@@ -133,10 +240,63 @@ namespace eosio {
 
         ilog("queue size ${size}",("size",queue_size));
 
+        profiler().set_slow_threshold_ms( options.at(SLOW_STATEMENT_OPTION).as<uint32_t>() );
+
+        {
+            auto counted = options.at(METRICS_CONTRACTS_OPTION).as<std::string>();
+            boost::replace_all(counted," ","");
+            std::vector<std::string> names;
+            boost::split(names, counted, boost::is_any_of( "," ));
+            std::set<chain::name> contracts;
+            for(const auto& n : names){
+                if( !n.empty() ) contracts.insert( chain::name(n) );
+            }
+            metrics().set_action_contracts( contracts );
+        }
+
+        auto api_threads = options.at(API_THREADS_OPTION).as<uint32_t>();
+        if( api_threads > 0 ) {
+            my->api_pool = std::make_shared<worker_pool>(api_threads);
+        }
+
         //for three thread。 TODO: change to thread db pool
         my->sql_db = std::make_shared<sql_database>(uri_str, block_num_start, 1);
         auto db_blocks = std::make_unique<sql_database>(uri_str, block_num_start, 5, action_filter_on,my->contract_filter_out);
 
+        db_blocks->m_sink->set_batch_blocks( std::max<uint32_t>(1, options.at(SINK_BATCH_OPTION).as<uint32_t>()) );
+        ilog("indexing into ${s}", ("s", db_blocks->m_sink->name()));
+
+        if( options.at(COMPRESS_COLUMNS_OPTION).as<bool>() ) {
+            auto path = options.at(COMPRESS_DICTIONARY_OPTION).as<boost::filesystem::path>();
+            if( path.is_relative() ) path = app().data_dir() / path;
+            std::string dictionary;
+            if( boost::filesystem::exists(path) ) {
+                fc::read_file_contents( path, dictionary );
+            } else {
+                dictionary = db_blocks->train_column_dictionary( 64 * 1024 );
+                if( !dictionary.empty() ) {
+                    std::ofstream out( path.string(), std::ios::binary );
+                    out.write( dictionary.data(), dictionary.size() );
+                    FC_ASSERT( out.good(), "unable to write ${p}", ("p", path.string()) );
+                }
+            }
+            ilog("compressing columns, ${n} bytes dictionary", ("n", dictionary.size()));
+            auto codec = std::make_shared<const column_codec>( options.at(COMPRESS_LEVEL_OPTION).as<int>(),
+                                                                options.at(COMPRESS_MIN_BYTES_OPTION).as<uint32_t>(), dictionary );
+            db_blocks->set_column_codec( codec );
+            my->sql_db->set_column_codec( codec );
+        }
+
+        if( auto strands = options.at(WRITER_STRANDS_OPTION).as<uint32_t>() ) {
+            // the other sinks batch their writes on one connection
+            if( std::string(db_blocks->m_sink->name()) == "mysql" ) {
+                db_blocks->enable_writer_strands( uri_str, strands );
+                ilog("writing the tables on ${n} strands", ("n", strands));
+            } else {
+                wlog("${o} is ignored with ${s}", ("o", WRITER_STRANDS_OPTION)("s", db_blocks->m_sink->name()));
+            }
+        }
+
         if (!db_blocks->is_started()) {
             if (block_num_start == 0) {
                 ilog("Resync requested: wiping database");
@@ -144,7 +304,59 @@ namespace eosio {
             }
         }
 
-        my->handler = std::make_unique<consumer>(std::move(db_blocks),queue_size);
+        if( options.count(HISTORY_DIR_OPTION) ) {
+            auto dir = options.at(HISTORY_DIR_OPTION).as<boost::filesystem::path>();
+            if( dir.is_relative() ) dir = app().data_dir() / dir;
+            db_blocks->enable_history( dir, options.at(HISTORY_SIZE_OPTION).as<uint64_t>() );
+            my->history = db_blocks->m_history;
+
+            if( options.count(HOT_CONTRACTS_OPTION) ) {
+                auto hot = options.at(HOT_CONTRACTS_OPTION).as<std::string>();
+                boost::replace_all(hot," ","");
+                std::vector<std::string> names;
+                boost::split(names, hot, boost::is_any_of( "," ));
+                std::set<chain::name> contracts;
+                for(const auto& n : names){
+                    if( !n.empty() ) contracts.insert( chain::name(n) );
+                }
+                my->history->set_hot_contracts( contracts );
+            }
+        }
+
+        if( options.at(RAW_ACTIONS_OPTION).as<bool>() ) {
+            db_blocks->enable_raw_actions();
+        }
+
+        if( options.count(ACTION_LOG_DIR_OPTION) ) {
+            auto dir = options.at(ACTION_LOG_DIR_OPTION).as<boost::filesystem::path>();
+            if( dir.is_relative() ) dir = app().data_dir() / dir;
+            db_blocks->enable_action_log( dir, std::max<uint64_t>(1, options.at(ACTION_LOG_SEGMENT_OPTION).as<uint64_t>()) );
+        }
+
+        if( options.count(CDC_SOCKET_OPTION) || options.count(CDC_DIR_OPTION) ) {
+            change_stream_options cdc;
+            if( options.count(CDC_SOCKET_OPTION) ) cdc.socket_path = options.at(CDC_SOCKET_OPTION).as<std::string>();
+            if( options.count(CDC_DIR_OPTION) ) {
+                cdc.file_dir = options.at(CDC_DIR_OPTION).as<boost::filesystem::path>();
+                if( cdc.file_dir.is_relative() ) cdc.file_dir = app().data_dir() / cdc.file_dir;
+            }
+            cdc.file_bytes              = std::max<uint64_t>(1, options.at(CDC_FILE_SIZE_OPTION).as<uint64_t>()) * 1024 * 1024;
+            cdc.file_count              = options.at(CDC_FILE_COUNT_OPTION).as<uint32_t>();
+            cdc.subscriber_buffer_bytes = size_t(std::max<uint32_t>(1, options.at(CDC_BUFFER_OPTION).as<uint32_t>())) * 1024 * 1024;
+            const auto format = options.at(CDC_FORMAT_OPTION).as<std::string>();
+            FC_ASSERT( format == "ndjson" || format == "binary", "unknown ${o} ${f}", ("o", CDC_FORMAT_OPTION)("f", format) );
+            cdc.binary = format == "binary";
+            db_blocks->enable_change_stream( cdc );
+        }
+
+        account_monitor_options monitor_options;
+        monitor_options.threads             = options.at(MONITOR_THREADS_OPTION).as<uint32_t>();
+        monitor_options.accounts_per_second = options.at(MONITOR_RATE_OPTION).as<uint32_t>();
+        monitor_options.batch_size          = std::max<uint32_t>(1, options.at(MONITOR_BATCH_OPTION).as<uint32_t>());
+        monitor_options.sweep_ms            = options.at(MONITOR_SWEEP_OPTION).as<uint32_t>();
+
+        const size_t queue_bytes = size_t(options.at(BUFFER_BYTES_OPTION).as<uint32_t>()) * 1024 * 1024;
+        my->handler = std::make_unique<consumer>(std::move(db_blocks),queue_size,monitor_options,queue_bytes);
         my->chain_plug = app().find_plugin<chain_plugin>();
 
         FC_ASSERT(my->chain_plug);
@@ -186,6 +398,66 @@ namespace eosio {
 
     void sql_db_plugin::plugin_startup() {
         ilog("startup");
+
+        auto http = app().find_plugin<http_plugin>();
+        if( http ) {
+            http->add_api({
+                {std::string("/v1/sql_db/get_status"), []( string, string, url_response_callback cb ){
+                    cb( 200, fc::json::to_string(metrics().status()) );
+                }},
+                {std::string("/v1/sql_db/metrics"), []( string, string, url_response_callback cb ){
+                    cb( 200, metrics().prometheus() );
+                }},
+                // statement templates by total time, body {"limit":n}
+                {std::string("/v1/sql_db/get_statements"), []( string, string body, url_response_callback cb ){
+                    size_t limit = 100;
+                    try{
+                        if( !body.empty() ) {
+                            auto params = fc::json::from_string(body);
+                            if( params.is_object() && params.get_object().contains("limit") ) limit = params["limit"].as_uint64();
+                        }
+                    } catch(...) {
+                        cb( 400, "{\"error\":\"invalid body\"}" );
+                        return;
+                    }
+                    cb( 200, fc::json::to_string(profiler().dump(limit)) );
+                }},
+                // newest actions of an account, body {"account":"name","limit":n,"before":ordinal,"decode":true}
+                {std::string("/v1/sql_db/get_account_history"), [history = my->history]( string, string body, url_response_callback cb ){
+                    if( !history ) {
+                        cb( 404, "{\"error\":\"sql_db-history-dir not set\"}" );
+                        return;
+                    }
+                    try{
+                        auto params = fc::json::from_string(body);
+                        auto account = params["account"].as<chain::name>();
+                        size_t limit = params.get_object().contains("limit") ? params["limit"].as_uint64() : 100;
+                        uint64_t before = params.get_object().contains("before") ? params["before"].as_uint64() : 0;
+                        bool decode = params.get_object().contains("decode") ? params["decode"].as_bool() : true;
+                        cb( 200, fc::json::to_string(history_json(*history, history->account_actions(account, std::min<size_t>(limit, 1000), before), decode)) );
+                    } catch(...) {
+                        cb( 400, "{\"error\":\"invalid body\"}" );
+                    }
+                }},
+                // actions of a block range, body {"first_block":n,"last_block":m,"limit":n,"decode":true}
+                {std::string("/v1/sql_db/get_block_actions"), [history = my->history]( string, string body, url_response_callback cb ){
+                    if( !history ) {
+                        cb( 404, "{\"error\":\"sql_db-history-dir not set\"}" );
+                        return;
+                    }
+                    try{
+                        auto params = fc::json::from_string(body);
+                        auto first = uint32_t(params["first_block"].as_uint64());
+                        auto last = params.get_object().contains("last_block") ? uint32_t(params["last_block"].as_uint64()) : first;
+                        size_t limit = params.get_object().contains("limit") ? params["limit"].as_uint64() : 1000;
+                        bool decode = params.get_object().contains("decode") ? params["decode"].as_bool() : true;
+                        cb( 200, fc::json::to_string(history_json(*history, history->block_actions(first, last, std::min<size_t>(limit, 10000)), decode)) );
+                    } catch(...) {
+                        cb( 400, "{\"error\":\"invalid body\"}" );
+                    }
+                }}
+            });
+        }
     }
 
     void sql_db_plugin::plugin_shutdown() {
@@ -213,15 +485,6 @@ namespace eosio {
             return abi;
         }
 
-        string get_table_type( const abi_def& abi, const name& table_name ) {
-            for( const auto& t : abi.tables ) {
-                if( t.name == table_name ){
-                    return t.index_type;
-                }
-            }
-            EOS_ASSERT( false, chain::contract_table_query_exception, "Table ${table} is not specified in the ABI", ("table",table_name) );
-        }
-
         template<typename Api>
         auto make_resolver( const Api* api, const fc::microseconds& max_serialization_time ){
             return [api, max_serialization_time](const name& account) -> optional<abi_serializer> {  
@@ -231,42 +494,48 @@ namespace eosio {
         }
 
 
-        read_only::get_tokens_result read_only::get_tokens( const get_tokens_params& p )const {
-            get_tokens_result result;
+        bool read_only::find_token( const account_name& account, token& tk, uint8_t default_precision, bool default_if_missing ) const {
+            bool found = false;
+            walk_key_value_table(tk.contract, account, N(accounts), [&](const key_value_object& obj){
+                EOS_ASSERT( obj.value.size() >= sizeof(asset), chain::asset_type_exception, "Invalid data on table");
 
-            for(auto t : p.tokens){
-                try{
-                    const abi_def abi = get_abi( db, t.contract );
-                    auto table_type = get_table_type( abi, "accounts" );
+                asset cursor;
+                fc::datastream<const char *> ds(obj.value.data(), obj.value.size());
+                fc::raw::unpack(ds, cursor);
 
-                    token tk;
-                    tk.contract = t.contract;
-                    tk.symbol = t.symbol;
+                EOS_ASSERT( cursor.get_symbol().valid(), chain::asset_type_exception, "Invalid asset");
 
-                    walk_key_value_table(t.contract, p.account, N(accounts), [&](const key_value_object& obj){
-                        EOS_ASSERT( obj.value.size() >= sizeof(asset), chain::asset_type_exception, "Invalid data on table");
+                if( cursor.symbol_name() == tk.symbol ) {
+                    tk.quantity = asset_amount_to_string(cursor);
+                    tk.precision = cursor.decimals();
+                    found = true;
+                }
 
-                        asset cursor;
-                        fc::datastream<const char *> ds(obj.value.data(), obj.value.size());
-                        fc::raw::unpack(ds, cursor);
+                // return false if we are looking for one and found it, true otherwise
+                return !found;
+            },[&](){
+                if( !default_if_missing || default_precision > 18 ) return ;
+                asset cursor = asset(0, chain::symbol(chain::string_to_symbol(default_precision,tk.symbol.c_str())));
+                tk.quantity = asset_amount_to_string( cursor );
+                tk.precision = default_precision;
+                found = true;
+            });
+            return found;
+        }
 
-                        EOS_ASSERT( cursor.get_symbol().valid(), chain::asset_type_exception, "Invalid asset");
+        read_only::get_tokens_result read_only::get_tokens( const get_tokens_params& p )const {
+            get_tokens_result result;
 
-                        if( cursor.symbol_name() == t.symbol ) {
-                            tk.quantity = asset_amount_to_string(cursor);
-                            tk.precision = cursor.decimals();
-                            result.tokens.emplace_back(tk);
-                        }
+            // one slot per requested token keeps the output in request order
+            vector<optional<token>> found(p.tokens.size());
 
-                        // return false if we are looking for one and found it, true otherwise
-                        return !(cursor.symbol_name() == t.symbol);
-                    },[&](){
-                        if( t.precision > 18 ) return ;
-                        asset cursor = asset(0, chain::symbol(chain::string_to_symbol(t.precision,t.symbol.c_str())));
-                        tk.quantity = asset_amount_to_string( cursor );
-                        tk.precision = t.precision;
-                        result.tokens.emplace_back(tk);
-                    });
+            for_each_index(p.tokens.size(), [&](size_t i){
+                const auto& t = p.tokens[i];
+                try{
+                    token tk;
+                    tk.contract = t.contract;
+                    tk.symbol = t.symbol;
+                    if( find_token(p.account, tk, t.precision, true) ) found[i] = tk;
                 } catch(fc::exception& e) {
                     wlog("${e}",("e",e.what()));
                 } catch(std::exception& e) {
@@ -274,6 +543,10 @@ namespace eosio {
                 } catch (...) {
                     wlog("unknown");
                 }
+            });
+
+            for(auto& tk : found){
+                if( tk ) result.tokens.emplace_back(std::move(*tk));
             }
             return result;
         }
@@ -283,41 +556,23 @@ namespace eosio {
 
             if(p.startNum<0 || p.pageSize<0) return result;
 
-            auto assets = sql_db->m_actions_table->get_assets(sql_db->m_session_pool->get_session(), p.startNum, p.pageSize);
-
-            for(auto it = assets.begin() ; it != assets.end(); it++){
-                try{
-                    token t;
-                    t.contract = it->get<string>(0);
-                    t.symbol = it->get<string>(3);
-
-                    const abi_def abi = get_abi( db, t.contract );
-                    auto table_type = get_table_type( abi, "accounts" );
-
-                    walk_key_value_table(t.contract, p.account, N(accounts), [&](const key_value_object& obj){
-                        EOS_ASSERT( obj.value.size() >= sizeof(asset), chain::asset_type_exception, "Invalid data on table");
-
-                        asset cursor;
-                        fc::datastream<const char *> ds(obj.value.data(), obj.value.size());
-                        fc::raw::unpack(ds, cursor);
-
-                        EOS_ASSERT( cursor.get_symbol().valid(), chain::asset_type_exception, "Invalid asset");
-
-                        if( cursor.symbol_name() == t.symbol ) {
-                            t.quantity = asset_amount_to_string(cursor);
-                            t.precision = cursor.decimals();
-                            result.tokens.emplace_back(t);
-                        }
+            vector<token> assets;
+            vector<int> precisions;
+            auto rows = sql_db->m_actions_table->get_assets(sql_db->m_session_pool->get_session(), p.startNum, p.pageSize);
+            for(auto it = rows.begin() ; it != rows.end(); it++){
+                token t;
+                t.contract = it->get<string>(0);
+                t.symbol = it->get<string>(3);
+                assets.emplace_back(t);
+                precisions.emplace_back(it->get<int>(2));
+            }
 
-                        // return false if we are looking for one and found it, true otherwise
-                        return !(cursor.symbol_name() == t.symbol);
+            vector<optional<token>> found(assets.size());
 
-                    }, [&](){
-                        asset cursor = asset(0, chain::symbol(chain::string_to_symbol(it->get<int>(2),t.symbol.c_str())));
-                        t.quantity = asset_amount_to_string( cursor );
-                        t.precision = it->get<int>(2);
-                        result.tokens.emplace_back(t);
-                    });
+            for_each_index(assets.size(), [&](size_t i){
+                try{
+                    token t = assets[i];
+                    if( find_token(p.account, t, precisions[i], true) ) found[i] = t;
                 } catch(fc::exception& e) {
                     wlog("${e}",("e",e.what()));
                 } catch(std::exception& e) {
@@ -325,72 +580,45 @@ namespace eosio {
                 } catch (...) {
                     wlog("unknown");
                 }
+            });
+
+            for(auto& t : found){
+                if( t ) result.tokens.emplace_back(std::move(*t));
             }
-            
-            
             return result;
         }
 
         read_only::get_hold_tokens_result read_only::get_hold_tokens( const get_hold_tokens_params& p )const {
             get_hold_tokens_result result;
 
+            // the rowset is bound to a single session, read it out before fanning out
+            vector<token> assets;
+            auto rows = sql_db->m_actions_table->get_assets(sql_db->m_session_pool->get_session());
+            for(auto it = rows.begin() ; it != rows.end(); it++){
+                token t;
+                t.contract = it->get<string>(0);
+                t.symbol = it->get<string>(3);
+                assets.emplace_back(t);
+            }
 
-            auto assets = sql_db->m_actions_table->get_assets(sql_db->m_session_pool->get_session());
-            auto contract = std::string("");
-            auto symbol   = std::string("");
+            vector<optional<token>> found(assets.size());
 
-            for(auto it = assets.begin() ; it != assets.end(); it++){
+            for_each_index(assets.size(), [&](size_t i){
                 try{
-                    token t;
-                    t.contract = it->get<string>(0);
-                    t.symbol = it->get<string>(3);
-                    
-
-                    contract = it->get<string>(0);
-                    symbol   = it->get<string>(3);
-                    
-                    const abi_def abi = get_abi( db, t.contract );
-                    auto table_type = get_table_type( abi, "accounts" );
-
-                    walk_key_value_table(t.contract, p.account, N(accounts), [&](const key_value_object& obj){
-                        EOS_ASSERT( obj.value.size() >= sizeof(asset), chain::asset_type_exception, "Invalid data on table");
-
-                        asset cursor;
-                        fc::datastream<const char *> ds(obj.value.data(), obj.value.size());
-                        fc::raw::unpack(ds, cursor);
-
-                        EOS_ASSERT( cursor.get_symbol().valid(), chain::asset_type_exception, "Invalid asset");
-
-                        if( cursor.symbol_name() == t.symbol ) {
-                            t.quantity = asset_amount_to_string(cursor);
-                            t.precision = cursor.decimals();
-                            result.tokens.emplace_back(t);
-                        }
-
-                        // return false if we are looking for one and found it, true otherwise
-                        return !(cursor.symbol_name() == t.symbol);
-
-                    }, [&](){
-                        
-                    });
+                    token t = assets[i];
+                    if( find_token(p.account, t, 0, false) ) found[i] = t;
                 } catch(fc::exception& e) {
-                    ilog("get token start");
-                    ilog(contract);
-                    ilog(symbol);
-                    ilog("get token end");
-                    wlog("${e}",("e",e.what()));
+                    wlog("get token failed ${c} ${s}: ${e}",("c",assets[i].contract)("s",assets[i].symbol)("e",e.what()));
                 } catch(std::exception& e) {
-                    ilog("get token start");
-                    ilog(contract);
-                    ilog(symbol);
-                    ilog("get token end");                    
-                    wlog("${e}",("e",e.what()));
+                    wlog("get token failed ${c} ${s}: ${e}",("c",assets[i].contract)("s",assets[i].symbol)("e",e.what()));
                 } catch (...) {
                     wlog("unknown");
                 }
+            });
+
+            for(auto& t : found){
+                if( t ) result.tokens.emplace_back(std::move(*t));
             }
-            
-            
             return result;
         }
 
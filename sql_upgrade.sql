@@ -0,0 +1,49 @@
+-- upgrades a database created with an earlier eos.sql and sql_change.sql, a new one has
+-- all of this already
+
+ALTER TABLE `transactions`
+  ADD COLUMN `cpu_usage_us` int(10) unsigned NOT NULL DEFAULT '0' COMMENT 'cpu 使用量(微秒)',
+  ADD COLUMN `net_usage_words` int(10) unsigned NOT NULL DEFAULT '0' COMMENT 'net 使用量(8字节)';
+
+ALTER TABLE `blocks` ADD KEY `idx_blocks_number` (`block_number`);
+
+ALTER TABLE `votes`
+  ADD COLUMN `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  ADD COLUMN `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  ADD UNIQUE KEY `idx_votes_action` (`block_num`,`action_ordinal`);
+
+ALTER TABLE `buyram`
+  ADD COLUMN `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  ADD COLUMN `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  ADD UNIQUE KEY `idx_buyram_action` (`block_num`,`action_ordinal`);
+
+ALTER TABLE `sellram`
+  ADD COLUMN `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  ADD COLUMN `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  ADD UNIQUE KEY `idx_sellram_action` (`block_num`,`action_ordinal`);
+
+ALTER TABLE `delegatebw`
+  ADD COLUMN `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  ADD COLUMN `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  ADD UNIQUE KEY `idx_delegatebw_action` (`block_num`,`action_ordinal`);
+
+ALTER TABLE `undelegatebw`
+  ADD COLUMN `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  ADD COLUMN `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  ADD UNIQUE KEY `idx_undelegatebw_action` (`block_num`,`action_ordinal`);
+
+ALTER TABLE `regproducer`
+  ADD COLUMN `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  ADD COLUMN `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  ADD UNIQUE KEY `idx_regproducer_action` (`block_num`,`action_ordinal`);
+
+ALTER TABLE `transfer`
+  ADD COLUMN `block_num` int(10) unsigned DEFAULT NULL COMMENT '区块号',
+  ADD COLUMN `action_ordinal` bigint(20) unsigned DEFAULT NULL COMMENT '区块号,区块内 action 序号',
+  ADD UNIQUE KEY `idx_transfer_action` (`block_num`,`action_ordinal`);
+
+-- the keys written twice by a replayed newaccount
+DELETE k1 FROM `accounts_keys` k1 JOIN `accounts_keys` k2
+  ON k1.`account` = k2.`account` AND k1.`permission` = k2.`permission` AND k1.`public_key` = k2.`public_key` AND k1.`id` > k2.`id`;
+
+ALTER TABLE `accounts_keys` ADD UNIQUE KEY `idx_accounts_keys_key` (`account`,`permission`,`public_key`);